@@ -9,19 +9,33 @@
 #include <chrono>
 #include <filesystem>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include "index/query_scorer.hpp"
 #include "index/types.hpp"
+#include "index/impact.hpp"
+#include "index/metadata.hpp"
 #include "index_worker.hpp"
 #include "normalizer/WordNormalizer.hpp"
 #include "indexBuilder/IndexBuilder.hpp"
+#include "indexBuilder/reorder.hpp"
+#include "indexBuilder/sigma_lexicon.hpp"
+#include "indexBuilder/merge_policy.hpp"
+#include "indexBuilder/chunks.hpp"
 #include "util/thread_pool.hpp"
+#include "util/builder_options.hpp"
+#include "util/trace.hpp"
 #include "codes/diskmap/diskmap.hpp"
 
 typedef std::pair<sindex::docno_t, std::string> doc_tuple_t;
 
 // Chunks' sizes
 constexpr size_t MAX_CHUNK_SPACE = 700'000'000;
-constexpr size_t SKIP_BLOCK_SIZE = 15'000;
+
+// Posting lists' sizes of the merges of the incremental builds: below the minimum all the chunks are in the first
+// tier, and merged chunks are built in memory so they never get bigger than the maximum
+constexpr size_t MIN_MERGE_SPACE = 1'000'000;
+constexpr size_t MAX_MERGED_SPACE = 100'000'000;
 
 std::atomic<sindex::doclen_t> global_doc_len_sum = 0;
 std::vector<std::filesystem::path> index_folders_paths;
@@ -30,6 +44,83 @@ std::vector<std::filesystem::path> index_folders_paths;
 // it is also used to access the global vector with the lexicons' paths
 std::mutex disk_writer_mutex;
 
+// Static quality of the documents, by docno. Only loaded for the QUALITY reordering
+std::unordered_map<sindex::docno_t, double> documents_quality;
+
+/**
+ * Reorders the documents of a chunk, so that the docids are assigned in the new order
+ * @param chunk the chunk's documents
+ * @param reorder the strategy
+ */
+static void reorder_chunk(std::vector<doc_tuple_t>& chunk, builder_options::reorder_t reorder)
+{
+	switch (reorder)
+	{
+	case builder_options::NONE:
+		return;
+	case builder_options::DOCNO:
+		std::stable_sort(chunk.begin(), chunk.end(), [](const doc_tuple_t& a, const doc_tuple_t& b) {
+			return a.first < b.first;
+		});
+		return;
+	case builder_options::QUALITY:
+	{
+		// Best documents first, the ones without a score go last
+		const auto quality = [](const doc_tuple_t& d) {
+			auto it = documents_quality.find(d.first);
+			return it == documents_quality.end() ? -HUGE_VAL : it->second;
+		};
+		std::stable_sort(chunk.begin(), chunk.end(), [&](const doc_tuple_t& a, const doc_tuple_t& b) {
+			return quality(a) > quality(b);
+		});
+		return;
+	}
+	case builder_options::BP:
+		break;
+	}
+
+	// Forward index of the distinct terms of each document
+	normalizer::WordNormalizer wn;
+	std::unordered_map<std::string, uint32_t> term_ids;
+	std::vector<std::vector<uint32_t>> docs(chunk.size());
+	std::vector<uint32_t> df;
+
+	for(size_t i = 0; i < chunk.size(); ++i)
+	{
+		auto terms = wn.normalize(chunk[i].second);
+		while (true)
+		{
+			const auto &term = terms.next();
+			if (term.empty())
+				break;
+
+			auto [it, inserted] = term_ids.try_emplace(term, term_ids.size());
+			if(inserted)
+				df.push_back(0);
+
+			docs[i].push_back(it->second);
+		}
+
+		std::sort(docs[i].begin(), docs[i].end());
+		docs[i].erase(std::unique(docs[i].begin(), docs[i].end()), docs[i].end());
+		for(auto term : docs[i])
+			df[term] += 1;
+	}
+
+	// Terms in just one document don't care about the order
+	for(auto& doc : docs)
+		std::erase_if(doc, [&df](uint32_t term) {return df[term] < 2;});
+
+	const auto order = sindex::bp_order(docs, term_ids.size());
+
+	std::vector<doc_tuple_t> reordered;
+	reordered.reserve(chunk.size());
+	for(auto i : order)
+		reordered.push_back(std::move(chunk[i]));
+
+	chunk = std::move(reordered);
+}
+
 /*
  * The uncompressed file contains one document per line.
  * Each line has the following format:
@@ -37,32 +128,40 @@ std::mutex disk_writer_mutex;
  * where <pid> is the docno and <text> is the document content
  */
 
-static void process_chunk(std::shared_ptr<std::vector<doc_tuple_t>> chunk, sindex::docid_t base_id, size_t chunk_n, const std::filesystem::path& out_dir)
+static void process_chunk(std::shared_ptr<std::vector<doc_tuple_t>> chunk, sindex::docid_t base_id, size_t chunk_n, const std::filesystem::path& out_dir, const builder_options& options)
 {
 	using namespace std::chrono_literals;
+	TRACE_SPAN("process chunk", "build");
 
 	normalizer::WordNormalizer wn;
 	sindex::IndexBuilder indexBuilder(chunk->size(), base_id);
 	sindex::docid_t docid = base_id;
 	sindex::doclen_t doc_len_sum = 0;
+	const bool positions = options.positions;
 
 	const auto start_time = std::chrono::steady_clock::now();
 
+	// Docids are assigned in the chunk's order, the document index follows it too
+	reorder_chunk(*chunk, options.reorder);
+
 	// Process all docs (lines) in a chunk
     for (const auto &line : *chunk)
 	{
 
-		// Extract all tokens and their freqs
+		// Extract all tokens and their freqs, and their positions if requested
 		std::unordered_map<std::string, sindex::freq_t> term_freqs;
+		std::unordered_map<std::string, std::vector<sindex::position_t>> term_positions;
 		auto terms = wn.normalize(line.second);
 
-		while (true)
+		for(sindex::position_t position = 0;; ++position)
 		{
 			const auto &term = terms.next();
 			if (term.empty())
 				break;
 
 			term_freqs[term]++;
+			if(positions)
+				term_positions[term].push_back(position);
 		}
 
 		// Compute doc_len
@@ -79,8 +178,12 @@ static void process_chunk(std::shared_ptr<std::vector<doc_tuple_t>> chunk, sinde
 
 		doc_len_sum += doc_len;
 
-		for (const auto &[term, freq]: term_freqs)
-			indexBuilder.add_to_post(term, docid, freq);
+		if(positions)
+			for (const auto &[term, term_pos]: term_positions)
+				indexBuilder.add_to_post(term, docid, term_pos);
+		else
+			for (const auto &[term, freq]: term_freqs)
+				indexBuilder.add_to_post(term, docid, freq);
 
 		// Increment docid
 		docid += 1;
@@ -95,20 +198,9 @@ static void process_chunk(std::shared_ptr<std::vector<doc_tuple_t>> chunk, sinde
 	const auto stop_time_proc = std::chrono::steady_clock::now();
 
 	// Write stuff to disk
-	std::string base_name = "db_" + std::to_string(chunk_n);
-	if(not std::filesystem::exists(out_dir/base_name))
-		std::filesystem::create_directory(out_dir/base_name);
-
-	// Specify the output files on which we'll write
-	auto pl_docids = std::ofstream(out_dir/base_name/"posting_lists_docids", std::ios_base::binary);
-	auto pl_freqs = std::ofstream(out_dir/base_name/"posting_lists_freqs", std::ios_base::binary);
-	// lexicon_temp because we have to calculate the sigmas
-	auto lexicon = std::ofstream(out_dir/base_name/"lexicon_temp", std::ios_base::binary);
-	auto doc_index = std::ofstream(out_dir/base_name/"document_index", std::ios_base::binary);
-
-	index_folders_paths.push_back(out_dir/base_name);
-
-	indexBuilder.write_to_disk(pl_docids, pl_freqs, lexicon, doc_index);
+	const auto chunk_dir = out_dir/("db_" + std::to_string(chunk_n));
+	index_folders_paths.push_back(chunk_dir);
+	write_chunk(indexBuilder, chunk_dir, positions);
 
 	// Print some stats
 	const auto stop_time = std::chrono::steady_clock::now();
@@ -120,169 +212,110 @@ static void process_chunk(std::shared_ptr<std::vector<doc_tuple_t>> chunk, sinde
 		<< " ( " << (stop_time - start_time)/1s << "s elapsed)" << std::endl;
 }
 
-/**
- * This function merges all the local lexica into a global one
- * @param out_dir the directory where the index is stored
- */
-void write_global_lexicon_to_disk_map(const std::filesystem::path& out_dir) {
-	std::ofstream lexicon_teletype(out_dir / "global_lexicon", std::ios::binary);
-
-	// Open up all files and maps from the local lexicon
-	struct lexicon_temp
-	{
-		memory_mmap file; codes::disk_map<sindex::LexiconValue> lexicon;
-		// This is constructor is necessary for older version of Apple's clang :(((
-		lexicon_temp(memory_mmap&& file, codes::disk_map<sindex::LexiconValue>&& lexicon) :
-			file(std::move(file)), lexicon(std::move(lexicon)) {}
-	};
-	std::vector<std::unique_ptr<lexicon_temp>> lexica;
-	lexica.reserve(index_folders_paths.size());
-
-	// Map all lexica
-	for(const auto& db_path : index_folders_paths)
-	{
-		memory_mmap lexicon_mmap(db_path/"lexicon_temp");
-
-		lexica.push_back(
-				std::make_unique<lexicon_temp>(
-						std::move(lexicon_mmap), codes::disk_map<sindex::LexiconValue>(lexicon_mmap)));
-	}
-
-	// Preparing merge
-	using iterator = codes::disk_map<sindex::LexiconValue>::iterator;
-	std::vector<std::pair<iterator, iterator>> ranges;
-	ranges.reserve(lexica.size());
-
-	// Fill ranges
-	for(const auto& lexicon : lexica)
-		ranges.emplace_back(lexicon->lexicon.begin(), lexicon->lexicon.end());
-
-	// Extract the n_docs field from a LexiconValue object
-	const auto filter_f = [](const sindex::LexiconValue& v) -> sindex::freq_t {return v.n_docs;};
-	// Sum all the freqs
-	const auto merge_f = []([[maybe_unused]] const std::string& key, const std::vector<sindex::freq_t>& values) {
-		return std::accumulate(values.begin(), values.end(), (sindex::freq_t)0);
-	};
-
-	// Merge
-	codes::merge<sindex::freq_t, iterator, codes::BLOCK_SIZE, sindex::LexiconValue>(lexicon_teletype, ranges, merge_f, filter_f);
-	lexicon_teletype.flush();
-}
+// Documents dropped by the merges, they leave the collection's statistics
+std::atomic<size_t> merged_away_docs = 0;
 
 /**
- * This function writes the metadata file
- * @param out_dir the directory where the index is stored
- * @param ndocs the number of documents in the collection
+ * Merges adjacent chunks into a new one, see merge_chunks in chunks.hpp. The dropped documents leave the collection's
+ * statistics
  */
-void write_metadata(const std::filesystem::path& out_dir, const size_t ndocs) {
-	std::ofstream metadata(out_dir / "metadata", std::ios::binary);
-	metadata.write((char*)&global_doc_len_sum, sizeof(sindex::doclen_t));
-	metadata.write((char*)&ndocs, sizeof(size_t));
-}
+static void merge_and_account(const std::filesystem::path& out_dir, const std::vector<chunk_info_t>& chunks, size_t chunk_n)
+{
+	const auto dropped = merge_chunks(out_dir, chunks, chunk_n, disk_writer_mutex);
+	global_doc_len_sum -= dropped.second;
+	merged_away_docs += dropped.first;
 
-std::atomic<size_t> sum_skip_list_len = 0;
-std::atomic<size_t> n_skip_lists = 0;
+	std::cout << "Merged " << chunks.size() << " chunks into chunk " << chunk_n << ", dropped " << dropped.first
+			  << " deleted documents" << std::endl;
+}
 
-/**
- * This function computes the sigma for each term in the local lexicon and writes it to disk
- * It also computes the skipping list.
- * @param dir the directory where the index is stored
- * @return the maximum length of the skipping list
- */
-std::pair<size_t, std::string> write_sigma_lexicon(const std::filesystem::path& dir) {
-	// Statistical stuff
-	std::pair<size_t, std::string> max_skip_list_len = {};
+int main(int argc, char** argv)
+{
+	using namespace std::chrono_literals;
 
-	// Load all db stuff
-	memory_mmap metadata_mem(dir/".."/"metadata");
-	memory_mmap global_lexicon_mem(dir/".."/"global_lexicon");
-	sindex::Index<sindex::LexiconValue>::global_lexicon_t global_lexicon(global_lexicon_mem);
-	sindex::QueryTFIDFScorer tfidf_scorer;
-	sindex::QueryBM25Scorer bm25_scorer;
+	size_t space_count = 0;
 
-	index_worker_t<sindex::LexiconValue> index_worker(dir, metadata_mem, global_lexicon, tfidf_scorer);
+	std::string pid_str, doc;
+    size_t line_count = 1;
+	sindex::docid_t docid_start = 1;
+	size_t chunk_n = 0;
 
-	std::ofstream sigma_lexicon(dir/"lexicon", std::ios::binary);
+	// Parse command line options
+	const builder_options options(argc, argv);
 
-	codes::disk_map_writer<sindex::SigmaLexiconValue> sigma_lexicon_writer(sigma_lexicon);
+	if(not options.trace_file.empty() and not trace::start(options.trace_file))
+		std::cerr << "Tracing is not compiled in, rebuild with -DUSE_TRACING=ON" << std::endl;
 
-	// For each term in the local lexicon
-	for(const auto& [term, lv] : index_worker.index.get_local_lexicon())
+	if(options.reorder == builder_options::QUALITY)
 	{
-		sindex::SigmaLexiconValue slv = lv;
-		sindex::SigmaLexiconValue::skip_pointer_t current_skip;
-		size_t i = 1;
-
-		auto pl = index_worker.index.get_posting_list(term, lv);
-		auto pl_it = pl.begin();
-		auto pl_curr_block_off = pl.get_offset(pl_it);
-
-		// Build a skip pointer
-		auto build_skip = [&](const auto& docid) {
-			current_skip.last_docid = docid;
-			current_skip.docid_offset = pl_curr_block_off.docid_off;
-			current_skip.freq_offset = pl_curr_block_off.freq_off;
-			slv.skip_pointers.push_back(current_skip);
-
-			current_skip = {};
-			pl_curr_block_off = pl.get_offset(pl_it + 1);
-		};
-
-		// For each posting we score it and update the sigma, if necessary
-		for(; pl_it != pl.end(); ++pl_it, ++i)
+		std::ifstream quality_file(options.quality_file);
+		if(not quality_file)
 		{
-			const auto& [docid, freq] = *pl_it;
+			std::cerr << "Reordering by quality needs the documents' scores, pass them with --quality" << std::endl;
+			return -1;
+		}
 
-			auto tfidf_score = pl.score(pl_it, tfidf_scorer);
-			auto bm25_score = pl.score(pl_it, bm25_scorer);
+		std::string docno;
+		double quality;
+		while(quality_file >> docno >> quality)
+			documents_quality[docno] = quality;
+	}
 
+	// This is where we'll store the output stuff
+	const std::filesystem::path& out_dir = options.out_dir;
 
-			slv.tfidf_sigma = std::max(slv.tfidf_sigma, tfidf_score);
-			current_skip.tfidf_ub = std::max(current_skip.tfidf_ub, tfidf_score);
+	// Incremental builds add new chunks after the ones of the index, the others start from scratch
+	const bool append = options.append and std::filesystem::exists(out_dir/"metadata");
+	size_t n_old_docs = 0;
+	if(append)
+	{
+		memory_mmap metadata_mem(out_dir/"metadata");
+		const auto metadata = sindex::CollectionMetadata::read(metadata_mem);
+		const auto chunks = list_chunks(out_dir);
 
-			slv.bm25_sigma = std::max(slv.bm25_sigma, bm25_score);
-			current_skip.bm25_ub = std::max(current_skip.bm25_ub, bm25_score);
-			
-			// If we reached the end of the block
-			if (i % SKIP_BLOCK_SIZE == 0)
-				build_skip(docid);
+		if(metadata.quantized != options.quantized or
+		   (not chunks.empty() and std::filesystem::exists(chunks.front().path/"lexicon_positions") != options.positions))
+		{
+			std::cerr << "Appending to " << out_dir << " needs the options it was built with, "
+					  << "`--quantized` and `--positions` must match" << std::endl;
+			return -1;
 		}
 
-		// If we have a partial block
-		if (i % SKIP_BLOCK_SIZE != 0)
-			build_skip(pl_it->first);
+		if(not options.delete_file.empty())
+		{
+			std::ifstream delete_file(options.delete_file);
+			std::unordered_set<sindex::docno_t> docnos;
+			for(std::string docno; std::getline(delete_file, docno);)
+				docnos.insert(docno);
 
-		// Write the new value
-		sigma_lexicon_writer.add(term, slv);
+			std::cout << "Deleted " << delete_documents(out_dir, chunks, docnos) << " documents" << std::endl;
+		}
 
-		// Update statistics
-		max_skip_list_len = std::max(max_skip_list_len, {slv.skip_pointers.size(), term});
-		sum_skip_list_len += slv.skip_pointers.size();
-		n_skip_lists += 1;
+		global_doc_len_sum = metadata.doc_len_sum;
+		n_old_docs = metadata.n_docs;
+		for(const auto& old_chunk : chunks)
+		{
+			index_folders_paths.push_back(old_chunk.path);
+			chunk_n = std::max(chunk_n, old_chunk.chunk_n + 1);
+			docid_start = std::max<sindex::docid_t>(docid_start, old_chunk.base_docid + old_chunk.n_docs);
+		}
 	}
+	else
+	{
+		if(not options.delete_file.empty())
+		{
+			std::cerr << "Deleting documents needs an existing index and `--append`" << std::endl;
+			return -1;
+		}
 
-	// Write the final informations on the disk
-	sigma_lexicon_writer.finalize();
-
-	return max_skip_list_len;
-}
-
-int main(int argc, char** argv)
-{
-	using namespace std::chrono_literals;
-
-	size_t space_count = 0;
-
-	std::string pid_str, doc;
-    size_t line_count = 1;
-	sindex::docid_t docid_start = 1;
+		if(std::filesystem::exists(out_dir))
+			std::filesystem::remove_all(out_dir);
 
-	// This is where we'll store the output stuff
-	const std::filesystem::path out_dir = argc > 1 ? argv[1] : "data";
-	if(std::filesystem::exists(out_dir))
-		std::filesystem::remove_all(out_dir);
+		std::filesystem::create_directory(out_dir);
+	}
 
-	std::filesystem::create_directory(out_dir);
+	// The docids of the new documents follow the ones of the index
+	const sindex::docid_t first_docid = docid_start;
 
 	// Disable synchronization with C I/O
 	std::ios_base::sync_with_stdio(false);
@@ -292,7 +325,6 @@ int main(int argc, char** argv)
 	// We store them in an array of <docno, doc> that will be deleted by
 	// process_chunk
 	auto chunk = std::make_shared<std::vector<doc_tuple_t>>();
-	size_t chunk_n = 0;
 
 	// bench stuff
 	const auto start_time = std::chrono::steady_clock::now();
@@ -310,11 +342,11 @@ int main(int argc, char** argv)
 		// Send the chunk only if overcomes the space's threshold
 		if (space_count >= MAX_CHUNK_SPACE)
 		{
-			pool.add_job([chunk = std::move(chunk), docid_start, chunk_n, out_dir] {
-				process_chunk(chunk, docid_start, chunk_n, out_dir);
+			pool.add_job([chunk = std::move(chunk), docid_start, chunk_n, out_dir, &options] {
+				process_chunk(chunk, docid_start, chunk_n, out_dir, options);
 			});
 			chunk_n += 1;
-			docid_start = line_count + 1;
+			docid_start = first_docid + line_count;
 
 			// Allocate new chunk for next round
 			chunk = std::make_shared<std::vector<doc_tuple_t>>();
@@ -332,8 +364,8 @@ int main(int argc, char** argv)
     // Process the remaining lines which are less than CHUNK_SIZE
 	if (not chunk->empty())
 	{
-		pool.add_job([chunk = std::move(chunk), docid_start, chunk_n, out_dir]() {
-			process_chunk(chunk, docid_start, chunk_n, out_dir);
+		pool.add_job([chunk = std::move(chunk), docid_start, chunk_n, out_dir, &options]() {
+			process_chunk(chunk, docid_start, chunk_n, out_dir, options);
 		});
 		chunk_n += 1;
 	}
@@ -344,8 +376,46 @@ int main(int argc, char** argv)
 	std::cout << "Indices built in " << (stop_time_1 - start_time) / 1.0s << "s" << std::endl;
 
 	// Write global_lexicon using disk_map_writer
-	write_global_lexicon_to_disk_map(out_dir);
-	write_metadata(out_dir, line_count - 1);
+	write_global_lexicon(out_dir, index_folders_paths);
+	write_metadata(out_dir, n_old_docs + line_count - 1, global_doc_len_sum, options.quantized);
+
+	// Incremental builds then merge the small chunks, until the policy is happy. Merges drop the deleted documents,
+	// so the global lexicon and the metadata are rewritten after each round
+	if(append)
+	{
+		const sindex::merge_policy_t policy = {
+			.factor = options.merge_factor, .min_size = MIN_MERGE_SPACE, .max_size = MAX_MERGED_SPACE
+		};
+
+		while(true)
+		{
+			const auto chunks = list_chunks(out_dir);
+			std::vector<size_t> sizes;
+			for(const auto& old_chunk : chunks)
+				sizes.push_back(old_chunk.size);
+
+			const auto merges = policy.plan(sizes);
+			if(merges.empty())
+				break;
+
+			for(const auto& [first, last] : merges)
+			{
+				pool.wait_for_free_worker();
+				pool.add_job([to_merge = std::vector(chunks.begin() + first, chunks.begin() + last), chunk_n, &out_dir] {
+					merge_and_account(out_dir, to_merge, chunk_n);
+				});
+				chunk_n += 1;
+			}
+			pool.wait_all_jobs();
+
+			index_folders_paths.clear();
+			for(const auto& merged_chunk : list_chunks(out_dir))
+				index_folders_paths.push_back(merged_chunk.path);
+
+			write_global_lexicon(out_dir, index_folders_paths);
+			write_metadata(out_dir, n_old_docs + line_count - 1 - merged_away_docs, global_doc_len_sum, options.quantized);
+		}
+	}
 
 	const auto stop_time_2 = std::chrono::steady_clock::now();
 	std::cout << "Built global lexicon from local lexica in " << (stop_time_2 - stop_time_1) / 1.0ms << "ms" << std::endl;
@@ -354,8 +424,8 @@ int main(int argc, char** argv)
 	for(const auto& path : index_folders_paths)
 	{
 		pool.wait_for_free_worker();
-		pool.add_job([path]() {
-			auto s = write_sigma_lexicon(path);
+		pool.add_job([path, &options]() {
+			auto s = write_sigma_lexicon(path, options.impact_ordered, options.quantized);
 			std::cout << "(thread " << std::hex << std::this_thread::get_id() << std::dec << " )\t"
 					  << "Built skipping list and sigmas for " << path
 					  << " (max len = " << s.first << ") " << std::endl;//" for term " << s.second << ")" << std::endl;
@@ -368,7 +438,8 @@ int main(int argc, char** argv)
 				<< "\taverage len = " << (double)sum_skip_list_len / (double)n_skip_lists << std::endl;
 
 	std::cout << "Processed " << (line_count - 1) << " documents in " << (stop_time - start_time) / 1.0s << "s"
-		<< " " << (chunk_n) << " indices generated\n";
+		<< " " << index_folders_paths.size() << " indices in " << out_dir << "\n";
 
+	trace::stop();
     return 0;
 }
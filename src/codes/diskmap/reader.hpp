@@ -239,6 +239,10 @@ public:
 		if(block_headers_it != index_string.end() and block_headers_it->first == q)
 			return iterator(*this, block_number * B, block_headers_it->second, block_number);
 
+		// Smaller than the first key, there's no block to the left
+		if(block_headers_it == index_string.begin())
+			return end();
+
 		// Not valid result, move to the left
 		if (block_headers_it == index_string.end() or block_headers_it->first != q)
 		{
@@ -136,6 +136,16 @@ public:
 		const EncondedDataIterator& get_raw_iterator() const {return current_encoded_it;} // Access raw iterator
 		unsigned get_bit_offset() const {return std::countr_zero(current_datum_start_bit_mask);} // Get bit offset
 
+		/**
+		 * The raw iterator points to the byte where the current datum ends, a datum longer than the rest of its first
+		 * byte starts some bytes earlier. The datum's value is its length in bits.
+		 * @return the byte where the current datum starts, to be paired with get_bit_offset()
+		 */
+		EncondedDataIterator get_datum_raw_iterator() const
+		{
+			return current_encoded_it - (get_bit_offset() + current_datum_decoded - 1) / 8;
+		}
+
 		bool operator==(const iterator& b) const
 		{
 			return bit_mask == b.bit_mask and current_encoded_it == b.current_encoded_it; // Comparison operator
@@ -273,7 +283,7 @@ public:
 		 * Moves the iterator to the next position in the raw data sequence.
 		 *
 		 * The function performs the following operations:
-		 * - Checks if the iterator has reached the end of the sequence.
+		 * - Checks if the iterator has reached the end of the sequence and the last value has been streamed whole.
 		 *   - If true, sets the 'eos' flag to true indicating the end of the sequence.
 		 * - Calls 'build_out_buffer()' to construct the output buffer for the next position.
 		 * - Increments the iterator to the next position in the raw data sequence.
@@ -282,7 +292,8 @@ public:
 		 */
 		iterator& operator++()
 		{
-			if(current_raw_it == end_raw_it)
+			// The last value may not fit in the last byte, its remaining bits are still in the buffer
+			if(current_raw_it == end_raw_it and buffer == 0)
 				eos = true; // Set 'eos' flag to true if the iterator reaches the end of the sequence
 
 			build_out_buffer(); // Construct the output buffer for the next position
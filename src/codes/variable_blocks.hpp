@@ -284,7 +284,7 @@ struct VariableBytes
 	 *    - Checks the most significant bit to determine if there are more bytes to read ('more' flag).
 	 *  @Returns a pair containing the reconstructed 'number' and the count of bytes read (i).
 	 */
-	static inline std::pair<uint64_t, unsigned> parse(uint8_t *bytes)
+	static inline std::pair<uint64_t, unsigned> parse(const uint8_t *bytes)
 	{
 		bool more = true;
 		unsigned i;
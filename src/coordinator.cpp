@@ -0,0 +1,109 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <csignal>
+#include "util/coordinator_options.hpp"
+#include "util/server.hpp"
+#include "util/shard_client.hpp"
+
+/*
+ * Scatter-gather over processes: every shard of a collection is served by its own engine, started with
+ * `--shard I/N --serve ADDRESS` on the same data dir, so that each one maps only its chunks. The coordinator sends
+ * the queries to all of them and merges their top-k, a crashed or stuck engine only costs the results of its chunks.
+ */
+
+// The server running in server mode, stopped by SIGINT and SIGTERM
+static query_server *running_server = nullptr;
+
+extern "C" void stop_server(int)
+{
+	if(running_server)
+		running_server->stop();
+}
+
+int main(int argc, char** argv)
+{
+	using namespace std::chrono_literals;
+
+	// Parse command line options
+	const coordinator_options options(argc, argv);
+
+	if(options.shards.empty())
+	{
+		std::cerr << "No shards given, start an engine per shard with `engine --shard I/N --serve ADDRESS` "
+				  << "and pass their addresses" << std::endl;
+		return -1;
+	}
+
+	// Disable sync with stdio, we don't need it
+	std::ios_base::sync_with_stdio(false);
+
+	// Server mode: a coordinator answers as an engine does, so it can be a shard of another coordinator
+	if(not options.serve_address.empty())
+	{
+		query_server server;
+		if(not server.listen(options.serve_address))
+			return -1;
+
+		running_server = &server;
+		std::signal(SIGINT, stop_server);
+		std::signal(SIGTERM, stop_server);
+
+		std::clog << "Serving queries on " << options.serve_address << " over " << options.shards.size() << " shards" << std::endl;
+
+		server.serve([&](const std::string& request) {
+			// Each connection has its own thread, and its own connections to the shards
+			thread_local shard_client client(options.shards, options.probes, options.timeout);
+
+			std::string query;
+			sindex::score_t threshold;
+			if(not parse_query_request(request, query, threshold))
+				return error_response("malformed threshold line");
+
+			bool partial, approximate;
+			const auto results = client.search(query, options.k, &partial, threshold, &approximate);
+			return query_response(results, approximate, partial);
+		});
+
+		running_server = nullptr;
+		std::clog << "Served " << server.requests_served() << " queries over " << server.connections_served()
+				  << " connections" << std::endl;
+		return 0;
+	}
+
+	shard_client client(options.shards, options.probes, options.timeout);
+
+	std::string query;
+	unsigned long q_id = 0;
+
+	// Read lines from stdin until EOF
+	auto read_interactive = [&]() -> bool {
+		std::cout << ++q_id << ") Waiting for input: ";
+		return (bool)std::getline(std::cin, query);
+	};
+	auto read_batch = [&]() -> bool { return std::cin >> q_id and std::getline(std::cin, query); };
+	while (options.batch_mode ? read_batch() : read_interactive())
+	{
+		if(query.empty())
+			continue;
+
+		const auto start_time = std::chrono::steady_clock::now();
+		bool partial, approximate;
+		const auto results = client.search(query, options.k, &partial, 0, &approximate);
+		const auto stop_time = std::chrono::steady_clock::now();
+
+		auto& out_tty = options.batch_mode ? std::clog : std::cout;
+		out_tty << "Solved query " << q_id << " in " << (stop_time - start_time) / 1.0ms << "ms"
+				<< (partial ? " (partial)" : "") << (approximate ? " (approximate)" : "") << std::endl;
+
+		for (size_t i = 0; i < results.size(); ++i)
+			std::cout << q_id << " Q0 " << results[i].docno
+				<< " " << (i+1) << " " << results[i].score << " " << options.run_name << std::endl;
+	}
+
+	if(client.failures())
+		std::clog << "Shards: " << client.failures() << " times a shard's results were missing" << std::endl;
+
+	return 0;
+}
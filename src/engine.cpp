@@ -2,15 +2,613 @@
 #include <vector>
 #include <iostream>
 #include <set>
+#include <optional>
 #include <filesystem>
+#include <map>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <csignal>
+#include <sstream>
+#include <algorithm>
 #include "normalizer/WordNormalizer.hpp"
 #include "index/types.hpp"
 #include "index/Index.hpp"
 #include "index/query_scorer.hpp"
+#include "index/metadata.hpp"
+#include "index/top_k_merge.hpp"
+#include "index/tier0.hpp"
 #include "util/memory.hpp"
 #include "util/thread_pool.hpp"
+#include "util/affinity.hpp"
 #include "index_worker.hpp"
 #include "util/engine_options.hpp"
+#include "util/result_cache.hpp"
+#include "util/readahead.hpp"
+#include "util/server.hpp"
+#include "util/metrics.hpp"
+#include "util/trace.hpp"
+#include "codes/diskmap/diskmap.hpp"
+
+using shard_index_t = sindex::Index<sindex::SigmaLexiconValue>;
+
+/**
+ * A query's normalized terms and its phrase ("a b") and proximity ("a b"~N) operators
+ */
+struct parsed_query_t
+{
+	std::set<std::string> tokens;
+	std::vector<sindex::phrase_t> phrases;
+};
+
+static parsed_query_t parse_query(const std::string& query, normalizer::WordNormalizer& wn)
+{
+	parsed_query_t parsed;
+
+	const auto tokenize = [&](const std::string& text, std::vector<std::string> *terms) {
+		TRACE_SPAN("tokenize", "query");
+		auto token_stream = wn.normalize(text);
+		while(true)
+		{
+			const auto& term = token_stream.next();
+			if(term.empty())
+				break;
+
+			parsed.tokens.insert(term);
+			if(terms)
+				terms->push_back(term);
+		}
+	};
+
+	for(size_t pos = 0; pos < query.size();)
+	{
+		const size_t open = query.find('"', pos);
+		const size_t close = open == std::string::npos ? std::string::npos : query.find('"', open + 1);
+
+		// No more operators
+		if(close == std::string::npos)
+		{
+			tokenize(query.substr(pos), nullptr);
+			break;
+		}
+
+		tokenize(query.substr(pos, open - pos), nullptr);
+
+		sindex::phrase_t phrase;
+		tokenize(query.substr(open + 1, close - open - 1), &phrase.terms);
+		pos = close + 1;
+
+		// Proximity operator
+		if(pos < query.size() and query[pos] == '~')
+		{
+			size_t digits = 0;
+			while(pos + 1 + digits < query.size() and std::isdigit((unsigned char)query[pos + 1 + digits]))
+				++digits;
+
+			phrase.proximity = true;
+			phrase.slop = digits ? std::stoul(query.substr(pos + 1, digits)) : 0;
+			pos += 1 + digits;
+		}
+
+		// Only stopwords
+		if(not phrase.terms.empty())
+			parsed.phrases.push_back(std::move(phrase));
+	}
+
+	return parsed;
+}
+
+/**
+ * Solves a query on one index chunk with the algorithm chosen in the options. It is instantiated once per scorer so
+ * that the query processing loops are specialized for it. The work done is counted in stats and capped by budget,
+ * if they're not null
+ * @param k how many results to return, the tier 0 asks for one more than the options' one
+ */
+template<class Scorer>
+static std::vector<sindex::docid_result_t> solve(shard_index_t& index, const parsed_query_t& query,
+										   const engine_options& options, size_t k, sindex::SharedThreshold& threshold,
+										   sindex::QueryStats *stats, sindex::QueryBudget *budget)
+{
+	const auto& tokens = query.tokens;
+
+	// Operators are only supported by the DAAT, in conjunctive mode if the chosen algorithm is
+	if(not query.phrases.empty())
+	{
+		const bool conj = options.algorithm == engine_options::DAAT_CONJUNCTIVE or options.algorithm == engine_options::BMAND;
+		return index.query_phrase<Scorer>(tokens, query.phrases, conj, k, &threshold, stats, budget);
+	}
+
+	switch (options.algorithm)
+	{
+	case engine_options::DAAT_DISJUNCTIVE:
+		return index.query<Scorer>(tokens, false, k, &threshold, stats, budget);
+	case engine_options::DAAT_CONJUNCTIVE:
+		return index.query<Scorer>(tokens, true, k, &threshold, stats, budget);
+	case engine_options::BMM:
+		return index.query_bmm<Scorer>(tokens, k, &threshold, stats, budget);
+	case engine_options::SAAT:
+		return index.query_saat(tokens, k, budget, stats);
+	case engine_options::BMAND:
+		return index.query_bmand<Scorer>(tokens, k, &threshold, stats, budget);
+	}
+
+	return {};
+}
+
+/**
+ * The result cache's key: the normalized tokens, the operators and everything in the options that changes the results
+ */
+static std::string cache_key(const parsed_query_t& query, const engine_options& options)
+{
+	std::string key = std::to_string(options.algorithm) + ':' + std::to_string(options.score) + ':' +
+			std::to_string(options.k) + ':' + std::to_string(options.postings_budget);
+
+	// Tokens never contain spaces
+	for(const auto& token : query.tokens)
+		key += ' ' + token;
+
+	for(const auto& phrase : query.phrases)
+	{
+		key += " \"";
+		for(const auto& term : phrase.terms)
+			key += ' ' + term;
+		key += phrase.proximity ? "\"~" + std::to_string(phrase.slop) : "\"";
+	}
+
+	return key;
+}
+
+// Dispatch table, indexed by engine_options::score_t
+using solver_t = std::vector<sindex::docid_result_t> (*)(shard_index_t&, const parsed_query_t&,
+		const engine_options&, size_t, sindex::SharedThreshold&, sindex::QueryStats*, sindex::QueryBudget*);
+static constexpr solver_t solvers[] = {
+		solve<sindex::QueryBM25Scorer>, // engine_options::BM25
+		solve<sindex::QueryTFIDFScorer> // engine_options::TFIDF
+};
+static_assert(engine_options::BM25 == 0 and engine_options::TFIDF == 1);
+
+// Names of the algorithms in the metrics, indexed by engine_options::algorithm_t
+static constexpr const char *algorithm_names[] = {"daat", "daat-c", "bmm", "saat", "bmand"};
+static_assert(engine_options::DAAT_DISJUNCTIVE == 0 and engine_options::BMAND == 4);
+
+/**
+ * A whole index on disk: the collection's statistics and its doc-partitioned chunks. A pruned index also has the
+ * bounds of the scores of its dropped postings.
+ */
+struct collection_t
+{
+	std::filesystem::path data_dir;
+	// The chunks' directories, in the order of indices
+	std::vector<std::filesystem::path> chunks;
+	memory_mmap metadata_mem;
+	memory_mmap global_lexicon_mem;
+	sindex::Index<>::global_lexicon_t global_lexicon;
+
+	std::list<index_worker_t<sindex::SigmaLexiconValue>> indices;
+	// The chunks' indices by position, the merged results are resolved by the chunk they come from
+	std::vector<const shard_index_t *> chunk_indices;
+
+	std::optional<memory_mmap> pruned_bounds_mem;
+	std::optional<codes::disk_map<uint64_t>> pruned_bounds;
+
+	/**
+	 * @param block_cache_bytes if not 0 the posting lists are read through block caches of this many bytes in total,
+	 * split evenly among the chunks
+	 * @param policy how the mapped files are kept in memory, by class
+	 * @param shard,n_shards only the chunks at positions shard modulo n_shards are loaded, in the order of their names
+	 */
+	explicit collection_t(const std::filesystem::path& data_dir, size_t block_cache_bytes = 0, const index_mmap_policy& policy = {},
+						  unsigned shard = 0, unsigned n_shards = 1):
+			data_dir(data_dir),
+			metadata_mem(data_dir/"metadata"),
+			global_lexicon_mem(data_dir/"global_lexicon", policy.lexicon),
+			global_lexicon(global_lexicon_mem)
+	{
+		// Find all folders in the folder, each folder is a doc-partitioned db
+		for (auto const& dir_entry : std::filesystem::directory_iterator(data_dir))
+			if(dir_entry.is_directory())
+				chunks.push_back(dir_entry.path());
+
+		// The engines of the other shards must agree on who owns what
+		if(n_shards > 1)
+		{
+			std::sort(chunks.begin(), chunks.end());
+
+			std::vector<std::filesystem::path> owned;
+			for(size_t pos = shard; pos < chunks.size(); pos += n_shards)
+				owned.push_back(chunks[pos]);
+			chunks = std::move(owned);
+		}
+
+		for(const auto& chunk : chunks)
+		{
+			std::clog << "Loading index chunk from " << chunk << std::endl;
+			indices.emplace_back(chunk, metadata_mem, global_lexicon, "lexicon", block_cache_bytes / chunks.size(), policy);
+			chunk_indices.push_back(&indices.back().index);
+		}
+
+		// Only written by the pruner
+		if(std::filesystem::exists(data_dir/"pruned_bounds"))
+		{
+			pruned_bounds_mem.emplace(data_dir/"pruned_bounds", policy.lexicon);
+			pruned_bounds.emplace(*pruned_bounds_mem);
+		}
+	}
+
+	/** The highest score that the dropped postings of the query's terms can add up to */
+	sindex::score_t pruned_bound(const std::set<std::string>& tokens)
+	{
+		uint64_t bound = 0;
+		for(const auto& token : tokens)
+		{
+			auto it = pruned_bounds->find(token);
+			if(it != pruned_bounds->end())
+				bound += it->second;
+		}
+
+		return (sindex::score_t)bound / sindex::SigmaLexiconValue::fixed_point_factor;
+	}
+
+	/** The loaded chunk holding a docid, nullptr if none does */
+	shard_index_t *chunk_of(sindex::docid_t docid)
+	{
+		for(auto& worker : indices)
+			if(docid >= worker.index.get_base_docid() and docid < worker.index.get_base_docid() + worker.index.get_n_local_docs())
+				return &worker.index;
+
+		return nullptr;
+	}
+};
+
+/**
+ * A query in flight. Its (query × chunk) tasks run on the thread pool and the last one to finish merges their results
+ */
+struct query_job_t
+{
+	unsigned long q_id;
+	parsed_query_t query;
+	std::string cache_key;
+	// Set by a coordinator: only the documents scoring more than this can enter the top-k it's merging
+	sindex::score_t min_score = 0;
+	std::chrono::steady_clock::time_point start_time, stop_time;
+	// What solved the query, see query_metrics
+	size_t metrics_path = 0;
+
+	// One cell per chunk of the collection being queried
+	std::vector<std::vector<sindex::docid_result_t>> chunk_results;
+	std::atomic<size_t> pending_chunks = 0;
+	// All the chunks of the collection being queried share the top-k threshold
+	std::optional<sindex::SharedThreshold> threshold;
+	// In explain mode, the work done by each chunk and their sum. A tier 0's fallback adds to the tier 0's work
+	std::vector<sindex::QueryStats> chunk_stats;
+	sindex::QueryStats stats;
+	// With a deadline or a postings budget, each chunk's share of it
+	std::vector<sindex::QueryBudget> chunk_budgets;
+
+	std::vector<sindex::result_t> results;
+	// A chunk ran out of budget or some terms were dropped, the results may not be the exact top-k
+	bool approximate = false;
+
+	std::mutex done_mutex;
+	std::condition_variable done_cv;
+	bool done = false;
+
+	void finish()
+	{
+		std::lock_guard guard(done_mutex);
+		done = true;
+		done_cv.notify_all();
+	}
+
+	void wait()
+	{
+		std::unique_lock lock(done_mutex);
+		done_cv.wait(lock, [this] {return done;});
+	}
+};
+
+/**
+ * Solves the submitted queries concurrently: each query is split in one task per index chunk, so that many queries
+ * can be in flight at once and the workers don't idle while a query waits for its slowest chunk.
+ */
+class query_pipeline_t
+{
+	collection_t& collection;
+	std::optional<collection_t>& tier0;
+	const engine_options& options;
+	thread_pool& tp;
+	std::optional<result_cache>& cache;
+	query_metrics& metrics;
+
+	// The metrics' paths and the first shard of each collection
+	size_t algorithm_path, phrase_path, cache_path, tier0_path, fallback_path;
+	size_t collection_shards, tier0_shards = 0;
+
+	/** Registers the chunks of a collection in the metrics, labelled with their directories. Returns the first one */
+	size_t add_shards(const collection_t& target)
+	{
+		size_t first = 0;
+		for(size_t i = 0; i < target.chunks.size(); ++i)
+		{
+			const auto shard = metrics.add_shard(target.chunks[i].string());
+			if(i == 0)
+				first = shard;
+		}
+
+		return first;
+	}
+
+	// Queries submitted and not completed yet, see shed_terms
+	std::atomic<size_t> in_flight = 0;
+
+	/** Records the query's latency and wakes up its waiter, the job may be gone right after */
+	void complete(query_job_t& job)
+	{
+		job.stop_time = std::chrono::steady_clock::now();
+		metrics.record_query(job.metrics_path, job.stop_time - job.start_time);
+		if(job.approximate)
+			approximate_queries += 1;
+
+		in_flight -= 1;
+		job.finish();
+	}
+
+	/**
+	 * Under load, drops the query's terms with the lowest idf, that is the ones with the longest posting lists: only
+	 * the half with the highest idf is kept. The terms of the phrase operators are always kept
+	 */
+	void shed_terms(query_job_t& job)
+	{
+		auto& tokens = job.query.tokens;
+		std::vector<std::pair<sindex::freq_t, std::string>> by_df;
+		for(const auto& token : tokens)
+		{
+			const auto required = std::any_of(job.query.phrases.begin(), job.query.phrases.end(), [&](const sindex::phrase_t& phrase) {
+				return std::find(phrase.terms.begin(), phrase.terms.end(), token) != phrase.terms.end();
+			});
+
+			auto df_it = collection.global_lexicon.find(token);
+			if(not required and df_it != collection.global_lexicon.end())
+				by_df.emplace_back(df_it->second, token);
+		}
+
+		// Most common first
+		std::sort(by_df.begin(), by_df.end(), std::greater<>());
+
+		const size_t keep = (tokens.size() + 1) / 2;
+		for(size_t i = 0; i < by_df.size() and tokens.size() > keep; ++i)
+		{
+			tokens.erase(by_df[i].second);
+			job.approximate = true;
+		}
+
+		if(job.approximate)
+			shed_queries += 1;
+	}
+
+	void run_on(collection_t& target, query_job_t& job)
+	{
+		auto& indices = target.indices;
+		job.chunk_results.assign(indices.size(), {});
+		job.pending_chunks = indices.size();
+		job.threshold.emplace(job.min_score);
+		if(options.explain)
+			job.chunk_stats.assign(indices.size(), {});
+
+		// The deadline is the query's, it includes the time spent waiting for the workers
+		if(options.deadline.count() or options.postings_budget)
+		{
+			const auto deadline = options.deadline.count() ? job.start_time + options.deadline : sindex::QueryBudget::clock::time_point::max();
+			job.chunk_budgets.assign(indices.size(), sindex::QueryBudget(deadline, options.postings_budget));
+		}
+
+		if(indices.empty())
+		{
+			chunk_done(target, job);
+			return;
+		}
+
+		const size_t shards = &target == &collection ? collection_shards : tier0_shards;
+		// The tier 0 also needs the best document after the top-k, see chunk_done
+		const size_t k = &target == &collection ? options.k : options.k + 1;
+		for(size_t pos = 0; auto& index : indices)
+		{
+			auto task = [this, &target, &job, &index, pos, k, shard = shards + pos] {
+				const auto task_start = std::chrono::steady_clock::now();
+				job.chunk_results[pos] = solvers[options.score](index.index, job.query, options, k, *job.threshold,
+																options.explain ? &job.chunk_stats[pos] : nullptr,
+																job.chunk_budgets.empty() ? nullptr : &job.chunk_budgets[pos]);
+				metrics.record_shard(shard, std::chrono::steady_clock::now() - task_start);
+
+				if(--job.pending_chunks == 0)
+					chunk_done(target, job);
+			};
+
+			// In pinned mode a chunk's tasks always run on its home worker
+			if(options.pinned)
+				tp.add_job(pos % tp.size(), std::move(task));
+			else
+				tp.add_job(std::move(task));
+
+			pos += 1;
+		}
+	}
+
+	/**
+	 * Replaces the tier 0 scores of the results, the ones of their kept postings, with the ones of the full index and
+	 * sorts them again. False if a result is not in the loaded chunks of the full index, or is another document there
+	 */
+	bool rescore_on_collection(const query_job_t& job, std::vector<sindex::shard_result_t>& results)
+	{
+		TRACE_SPAN("rescore", "query");
+
+		// Positions of the results in each chunk, the documents of a chunk are scored together
+		std::map<shard_index_t *, std::vector<size_t>> chunk_positions;
+		for(size_t i = 0; i < results.size(); ++i)
+		{
+			const auto docid = results[i].docid;
+			auto *chunk = collection.chunk_of(docid);
+			if(chunk == nullptr or chunk->get_docno(docid) != tier0->chunk_indices[results[i].shard]->get_docno(docid))
+				return false;
+
+			chunk_positions[chunk].push_back(i);
+		}
+
+		for(auto& [chunk, positions] : chunk_positions)
+		{
+			std::sort(positions.begin(), positions.end(), [&](size_t a, size_t b) {return results[a].docid < results[b].docid;});
+
+			std::vector<sindex::docid_t> docids;
+			for(const auto pos : positions)
+				docids.push_back(results[pos].docid);
+
+			// The tier 0 only backs BM25
+			const auto scores = chunk->score_documents<sindex::QueryBM25Scorer>(job.query.tokens, docids);
+			for(size_t i = 0; i < positions.size(); ++i)
+				results[positions[i]].score = scores[i];
+		}
+
+		std::stable_sort(results.begin(), results.end(), [](const auto& a, const auto& b) {return a.score > b.score;});
+		return true;
+	}
+
+	/** Called by the last chunk's task of a query */
+	void chunk_done(collection_t& target, query_job_t& job)
+	{
+		TRACE_SPAN("merge", "query");
+
+		// Merge the chunks' top-k results, they're already sorted. The tier 0's have one more
+		const bool on_tier0 = tier0 and &target == &*tier0;
+		auto merged_results = sindex::merge_top_k(job.chunk_results, on_tier0 ? options.k + 1 : options.k);
+
+		for(const auto& chunk_stats : job.chunk_stats)
+			job.stats += chunk_stats;
+
+		for(const auto& budget : job.chunk_budgets)
+			job.approximate |= budget.is_exhausted();
+
+		if(on_tier0)
+		{
+			// Rescoring the top-k on the full index is only worth it if no document out of it can beat them there
+			const bool exact = sindex::tier0_top_k_is_exact(merged_results, options.k, tier0->pruned_bound(job.query.tokens),
+															job.min_score);
+			merged_results.resize(std::min<size_t>(merged_results.size(), options.k));
+			const bool solved = exact and rescore_on_collection(job, merged_results);
+
+			if(not solved)
+			{
+				tier0_fallbacks += 1;
+				job.metrics_path = fallback_path;
+				run_on(collection, job);
+				return;
+			}
+
+			tier0_served += 1;
+			job.metrics_path = tier0_path;
+		}
+
+		// Only the final results' docnos are resolved
+		job.results.clear();
+		job.results.reserve(merged_results.size());
+		for(const auto& result : merged_results)
+			job.results.push_back({
+					.docno = std::string(target.chunk_indices[result.shard]->get_docno(result.docid)),
+					.score = result.score
+			});
+
+		// Only the exact results are worth reusing, the ones under a coordinator's threshold are missing
+		if(cache and not job.approximate and job.min_score == 0)
+			cache->put(job.cache_key, job.results);
+
+		complete(job);
+	}
+
+public:
+	std::atomic<size_t> tier0_served = 0;
+	std::atomic<size_t> tier0_fallbacks = 0;
+	std::atomic<size_t> approximate_queries = 0;
+	std::atomic<size_t> shed_queries = 0;
+
+	query_pipeline_t(collection_t& collection, std::optional<collection_t>& tier0, const engine_options& options,
+					 thread_pool& tp, std::optional<result_cache>& cache, query_metrics& metrics):
+			collection(collection), tier0(tier0), options(options), tp(tp), cache(cache), metrics(metrics)
+	{
+		algorithm_path = metrics.add_path(algorithm_names[options.algorithm]);
+		phrase_path = metrics.add_path("phrase");
+		cache_path = metrics.add_path("cache");
+		tier0_path = metrics.add_path("tier0");
+		fallback_path = metrics.add_path("tier0-fallback");
+
+		collection_shards = add_shards(collection);
+		if(tier0)
+			tier0_shards = add_shards(*tier0);
+	}
+
+	/** Schedules a parsed query, it returns immediately. The job must live until it's done */
+	void submit(query_job_t& job)
+	{
+		in_flight += 1;
+
+		// Head queries repeat a lot, look them up before bothering the index chunks
+		if(cache)
+		{
+			job.cache_key = cache_key(job.query, options);
+			auto cached_results = cache->get(job.cache_key);
+			if(cached_results)
+			{
+				job.results = std::move(*cached_results);
+				job.metrics_path = cache_path;
+				complete(job);
+				return;
+			}
+		}
+
+		job.metrics_path = job.query.phrases.empty() ? algorithm_path : phrase_path;
+
+		if(options.shed_load and in_flight > options.shed_load)
+			shed_terms(job);
+
+		// The tier 0 serves the query only if no document out of its top-k can beat its k-th result, on the full index;
+		// then the top-k is rescored on the full index. Its bounds are BM25's, so it only backs the disjunctive BM25
+		// algorithms
+		const bool try_tier0 = tier0 and options.score == engine_options::BM25 and job.query.phrases.empty() and
+				(options.algorithm == engine_options::DAAT_DISJUNCTIVE or options.algorithm == engine_options::BMM);
+
+		run_on(try_tier0 ? *tier0 : collection, job);
+	}
+};
+
+/** Prints what a query cost to the index chunks, see sindex::QueryStats */
+static void print_explain(std::ostream& out, const query_job_t& job)
+{
+	const auto& stats = job.stats;
+	out << "Explain query " << job.q_id << ": " << stats.lexicon_probes << " lexicon probes, "
+		<< stats.postings_scored << " postings scored, " << stats.heap_pushes << " heap pushes, "
+		<< stats.heap_evictions << " heap evictions, " << stats.pivot_moves << " pivot moves" << std::endl;
+
+	for(const auto& [term, term_stats] : stats.terms)
+		out << "\t" << term << ": " << term_stats.postings_decoded << " postings decoded, "
+			<< term_stats.blocks_skipped << " blocks skipped" << std::endl;
+}
+
+// The server running in server mode, stopped by SIGINT and SIGTERM
+static query_server *running_server = nullptr;
+
+extern "C" void stop_server(int)
+{
+	if(running_server)
+		running_server->stop();
+}
+
+// Dumps the metrics on SIGUSR1
+static metrics_reporter *running_reporter = nullptr;
+
+extern "C" void dump_metrics(int)
+{
+	if(running_reporter)
+		running_reporter->request_dump();
+}
 
 int main(int argc, char** argv)
 {
@@ -27,114 +625,258 @@ int main(int argc, char** argv)
 	}
 
 	// Load all db stuff
-	memory_mmap metadata_mem(options.data_dir/"metadata");
-	memory_mmap global_lexicon_mem(options.data_dir/"global_lexicon");
-	sindex::Index<>::global_lexicon_t global_lexicon(global_lexicon_mem);
-
-	std::list<index_worker_t<sindex::SigmaLexiconValue>> indices;
+	collection_t collection(options.data_dir, options.block_cache_size, options.mmap_policies, options.shard, options.n_shards);
+	auto& indices = collection.indices;
 
 	// Disable sync with stdio, we don't need it
 	std::ios_base::sync_with_stdio(false);
 
-	// Select the scorer
-	std::unique_ptr<sindex::QueryScorer> scorer = nullptr;
-	switch (options.score)
+	// Score-at-a-time needs the impact-ordered posting lists
+	const bool has_impacts = std::all_of(indices.begin(), indices.end(), [](const auto& index) {
+		return index.index.has_impacts();
+	});
+	if(options.algorithm == engine_options::SAAT and not has_impacts)
 	{
-	case engine_options::BM25:
-		scorer = std::make_unique<sindex::QueryBM25Scorer>();
-		break;
-	case engine_options::TFIDF:
-		scorer = std::make_unique<sindex::QueryTFIDFScorer>();
-		break;
+		std::cerr << "The index has no impact-ordered posting lists, "
+				  << "rebuild the index with `builder --impact-ordered`" << std::endl;
+		return -1;
 	}
 
-	// Find all folders in the folder, each folder is a doc-partitioned db
-	for (auto const& dir_entry : std::filesystem::directory_iterator(options.data_dir))
+	// The pruned first-stage index, if any
+	std::optional<collection_t> tier0;
+	if(not options.tier0_dir.empty())
 	{
-		if(not dir_entry.is_directory())
-			continue;
+		if(not std::filesystem::exists(options.tier0_dir/"pruned_bounds"))
+		{
+			std::cerr << "Tier 0 dir " << options.tier0_dir << " does not contain an index written by the pruner" << std::endl;
+			return -1;
+		}
+
+		tier0.emplace(options.tier0_dir, options.block_cache_size, options.mmap_policies, options.shard, options.n_shards);
+	}
+
+	const bool has_positions = std::all_of(indices.begin(), indices.end(), [](const auto& index) {
+		return index.index.has_positions();
+	});
+
+	if(options.pair_cache_size)
+		for(auto& index : indices)
+			index.index.enable_pair_cache(options.pair_cache_size / indices.size());
+
+	// The posting lists of a query are read ahead by a background thread as soon as its terms are looked up
+	std::optional<readahead_queue> readahead;
+	if(options.readahead_size)
+	{
+		readahead.emplace();
+		for(auto& index : indices)
+			index.index.enable_readahead(*readahead, options.readahead_size);
 
-		std::clog << "Loading index chunk from " << dir_entry.path() << std::endl;
-		indices.emplace_back(dir_entry, metadata_mem, global_lexicon, *scorer, "lexicon");
+		if(tier0)
+			for(auto& index : tier0->indices)
+				index.index.enable_readahead(*readahead, options.readahead_size);
+	}
+
+	// Impacts are precomputed BM25 scores
+	if(options.algorithm == engine_options::SAAT and options.score != engine_options::BM25)
+	{
+		std::cerr << "Score-at-a-time query processing only supports BM25" << std::endl;
+		return -1;
+	}
+
+	if(sindex::CollectionMetadata::read(collection.metadata_mem).quantized and options.score != engine_options::BM25)
+	{
+		std::cerr << "The index stores quantized BM25 impacts in place of the term frequencies, "
+				  << "it only supports BM25" << std::endl;
+		return -1;
 	}
 
 	std::string query;
 	unsigned long q_id = 0;
 	normalizer::WordNormalizer wn;
 
-	// Where I store the results, one array's cell per worker, then I'll merge them
-	std::unique_ptr<std::vector<sindex::result_t>[]> results(new std::vector<sindex::result_t>[indices.size()]);
-	std::vector<sindex::result_t> merged_results;
-	merged_results.reserve(options.k * indices.size() + 1);
-
 	// Workers
 	thread_pool tp(options.thread_count);
 
+	std::optional<result_cache> cache;
+	if(options.cache_size)
+		cache.emplace(options.cache_size);
+
+	// Pinned mode: each worker owns a CPU and each chunk has a home worker that runs all its tasks. The home worker
+	// faults in the chunk's files first, so that they're placed on its NUMA node
+	if(options.pinned)
+	{
+		const auto cpus = allowed_cpus();
+		if(not tp.pin_workers(cpus))
+			std::clog << "Could not pin the workers, the chunks' tasks are still routed to their home worker" << std::endl;
+
+		for(auto* target : {&collection, tier0 ? &*tier0 : nullptr})
+		{
+			if(not target)
+				continue;
+
+			for(size_t pos = 0; auto& index : target->indices)
+			{
+				const int cpu = cpus[pos % tp.size() % cpus.size()];
+				std::clog << "Chunk " << pos << " of " << target->data_dir << " is homed on CPU " << cpu
+						  << " (NUMA node " << cpu_numa_node(cpu) << ")" << std::endl;
+
+				tp.add_job(pos++ % tp.size(), [&index] {index.prefault();});
+			}
+		}
+
+		tp.wait_all_jobs();
+	}
+
+	query_metrics metrics;
+	query_pipeline_t pipeline(collection, tier0, options, tp, cache, metrics);
+
+	// The metrics are dumped on SIGUSR1 and every metrics_interval seconds, if set
+	metrics_reporter reporter(metrics, options.metrics_path.empty() ? "-" : options.metrics_path,
+							  options.metrics_format, options.metrics_interval);
+	running_reporter = &reporter;
+	std::signal(SIGUSR1, dump_metrics);
+
+	if(not options.trace_file.empty() and not trace::start(options.trace_file))
+		std::cerr << "Tracing is not compiled in, rebuild with -DUSE_TRACING=ON" << std::endl;
+
+	auto make_job = [&](unsigned long q_id, const std::string& query, normalizer::WordNormalizer& wn) {
+		// bench stuff
+		auto job = std::make_unique<query_job_t>();
+		job->q_id = q_id;
+		job->start_time = std::chrono::steady_clock::now();
+
+		// Tokenize the query
+		job->query = parse_query(query, wn);
+		if(not job->query.phrases.empty() and not has_positions)
+		{
+			std::cerr << "The index has no positions, phrase operators are ignored. "
+					  << "Rebuild the index with `builder --positions`" << std::endl;
+			job->query.phrases.clear();
+		}
+
+		return job;
+	};
+
+	// Server mode: the clients' queries are solved concurrently, each one by the pipeline as in batch mode
+	if(not options.serve_address.empty())
+	{
+		query_server server;
+		if(not server.listen(options.serve_address))
+			return -1;
+
+		running_server = &server;
+		std::signal(SIGINT, stop_server);
+		std::signal(SIGTERM, stop_server);
+
+		std::atomic<unsigned long> server_q_id = 0;
+		std::clog << "Serving queries on " << options.serve_address << std::endl;
+
+		server.serve([&](const std::string& request) {
+			// Each connection has its own thread
+			thread_local normalizer::WordNormalizer server_wn;
+
+			std::string query;
+			sindex::score_t min_score;
+			if(not parse_query_request(request, query, min_score))
+				return error_response("malformed threshold line");
+
+			auto job = make_job(++server_q_id, query, server_wn);
+			job->min_score = min_score;
+			pipeline.submit(*job);
+			job->wait();
+
+			if(options.explain)
+			{
+				// A whole query's report at once, the connections' threads share stderr
+				std::ostringstream explain;
+				print_explain(explain, *job);
+				std::clog << explain.str();
+			}
+
+			// A coordinator merges the scores, they're exact
+			return query_response(job->results, job->approximate);
+		});
+
+		running_server = nullptr;
+		std::clog << "Served " << server.requests_served() << " queries over " << server.connections_served()
+				  << " connections" << std::endl;
+	}
+
+	// Queries are printed in input order, the interactive mode waits for each one
+	std::deque<std::unique_ptr<query_job_t>> in_flight;
+	const size_t window = options.batch_mode ? options.in_flight : 1;
+
+	auto print_front = [&]() {
+		auto& job = *in_flight.front();
+		job.wait();
+
+		auto& out_tty = options.batch_mode ? std::clog : std::cout;
+		out_tty << "Solved query " << job.q_id << " in " << (job.stop_time - job.start_time) / 1.0ms << "ms"
+				<< (job.approximate ? " (approximate)" : "") << std::endl;
+		if(options.explain)
+			print_explain(out_tty, job);
+
+		for (size_t i = 0; i < job.results.size(); ++i)
+			//if(not job.results[i].docno.empty())
+			std::cout << job.q_id << " Q0 " << job.results[i].docno
+				<< " " << (i+1) << " " << job.results[i].score << " " << options.run_name << std::endl;
+
+		in_flight.pop_front();
+	};
+
 	// Read lines from stdin until EOF
 	auto read_interactive = [&]() -> bool {
 		std::cout << ++q_id << ") Waiting for input: ";
 		return (bool)std::getline(std::cin, query);
 	};
 	auto read_batch = [&]() -> bool { return std::cin >> q_id and std::getline(std::cin, query); };
-	while (options.batch_mode ? read_batch() : read_interactive())
+	while (options.serve_address.empty() and (options.batch_mode ? read_batch() : read_interactive()))
 	{
 		if(query.empty())
 			continue;
 
-		// bench stuff
-		const auto start_time = std::chrono::steady_clock::now();
+		auto job = make_job(q_id, query, wn);
+		pipeline.submit(*job);
+		in_flight.push_back(std::move(job));
 
-		// Tokenize the query
-		std::set<std::string> tokens;
-		auto terms = wn.normalize(query);
-		while(true)
-		{
-			const auto& term = terms.next();
-			if(term.empty())
-				break;
-			tokens.insert(term);
-		}
-
-		// Solve the query
-		for(auto i = 0; auto& index : indices)
-		{
-			tp.add_job([&, pos = i++] {
-				switch (options.algorithm)
-				{
-				case engine_options::DAAT_DISJUNCTIVE:
-					results[pos] = index.index.query(tokens, false, options.k);
-					break;
-				case engine_options::DAAT_CONJUNCTIVE:
-					results[pos] = index.index.query(tokens, true, options.k);
-					break;
-				case engine_options::BMM:
-					results[pos] = index.index.query_bmm(tokens, options.k);
-					break;
-				}
-			});
-		}
+		while(in_flight.size() >= window)
+			print_front();
+	}
 
-		tp.wait_all_jobs();
+	while(not in_flight.empty())
+		print_front();
 
-		// Merge them all
-		for(size_t i = 0; i < indices.size(); ++i)
-			merged_results.insert(merged_results.end(), results[i].begin(), results[i].end());
+	trace::stop();
+	std::clog << metrics.summary();
+	if(not options.metrics_path.empty())
+		reporter.dump();
 
-		// Sort them
-		std::sort(merged_results.begin(), merged_results.end(), std::greater<>());
-		if(merged_results.size() > options.k)
-			merged_results.resize(options.k); // top-k results
+	std::signal(SIGUSR1, SIG_DFL);
+	running_reporter = nullptr;
 
-		const auto stop_time = std::chrono::steady_clock::now();
-		auto& out_tty = options.batch_mode ? std::clog : std::cout;
-		out_tty << "Solved query " << q_id << " in " << (stop_time - start_time) / 1.0ms << "ms" << std::endl;
+	if(tier0)
+		std::clog << "Tier 0: " << pipeline.tier0_served << " queries served, " << pipeline.tier0_fallbacks << " fell back to the full index" << std::endl;
 
-		for (size_t i = 0; i < merged_results.size(); ++i)
-			//if(not merged_results[i].docno.empty())
-			std::cout << q_id<< " Q0 " << merged_results[i].docno
-				<< " " << (i+1) << " " << merged_results[i].score << " " << options.run_name << std::endl;
+	if(options.deadline.count() or options.postings_budget or options.shed_load)
+		std::clog << "Budgets: " << pipeline.approximate_queries << " queries returned approximate results, "
+				  << pipeline.shed_queries << " dropped terms under load" << std::endl;
 
-		merged_results.clear();
+	if(cache)
+		std::clog << "Result cache: " << cache->hits() << " hits, " << cache->misses() << " misses" << std::endl;
+
+	if(options.block_cache_size)
+	{
+		size_t hits = 0, misses = 0, evictions = 0;
+		for(const auto& index : indices)
+			for(const auto *block_cache : index.block_caches())
+			{
+				hits += block_cache->hits();
+				misses += block_cache->misses();
+				evictions += block_cache->evictions();
+			}
+
+		std::clog << "Block cache: " << hits << " hits, " << misses << " misses, " << evictions << " evictions" << std::endl;
 	}
+
 	return 0;
 }
@@ -1,49 +1,65 @@
 #include "Index.hpp"
+#include <algorithm>
 #include "types.hpp"
 
 namespace sindex
 {
 
 
-template<>
 /**
 * Function responsible for the BMM algorithm for query processing.
 * @param query The query to be processed.
 * @param top_k The number of top results to be returned.
+* @param shared_threshold If not null, the top-k threshold shared with the other index chunks solving this query.
+* @param stats If not null, the work done by the query is counted in it.
+* @param budget If not null, the query stops when it runs out and returns the top-k found so far.
 * @return A vector of results.
 */
-std::vector<result_t> Index<SigmaLexiconValue>::query_bmm(std::set<std::string> query, size_t top_k)
+template<class LVT>
+template<class Scorer>
+std::vector<docid_result_t> Index<LVT>::query_bmm(std::set<std::string> query, size_t top_k, SharedThreshold *shared_threshold,
+												  QueryStats *stats, QueryBudget *budget)
 {
+	TRACE_SPAN("bmm", "query");
+	const Scorer scorer{};
+
 	// Top-K results. This is a min queue (for that we use std::greater, of course), so that the minimum element can
 	// be popped
 	pending_results_t results;
-	auto [posting_lists_its, min_docid] = build_helpers(query);
+	auto [posting_lists_its, min_docid] = build_helpers(query, false, stats);
 	docid_t curr_docid = min_docid;
 	size_t pivot = 0;
-	score_t θ = 0.0;
+	score_t θ = 0.0; // k-th best score found so far by this chunk
 	std::vector<score_t> upper_bounds;
 
+	if(posting_lists_its.empty())
+		return {};
+
+	// The pruning threshold is the largest between ours and the one of the other chunks
+	const auto threshold = [&] {return shared_threshold ? std::max(θ, shared_threshold->get()) : θ;};
+
 	// Order posting lists by increasing sigma. It is not required by BMM.
-	posting_lists_its.sort([this](const PostingListHelper& a, const PostingListHelper& b)
+	posting_lists_its.sort([&scorer](const PostingListHelper& a, const PostingListHelper& b)
 	{
 		return scorer.get_sigma(a.pl.get_lexicon_value()) < scorer.get_sigma(b.pl.get_lexicon_value());
 	});
 
-	// Initialize the upper bounds vector
-	upper_bounds.push_back(scorer.get_sigma(posting_lists_its.begin()->pl.get_lexicon_value()));
-	for(auto it = posting_lists_its.begin(); it != posting_lists_its.end(); ++it)
-	{
-		if(it == posting_lists_its.begin())
-			continue;
-
-		upper_bounds.push_back(upper_bounds.back() + scorer.get_sigma(it->pl.get_lexicon_value()));
-	}
+	// The upper bounds vector: the i-th element bounds the score of the first i + 1 lists
+	const auto compute_upper_bounds = [&] {
+		upper_bounds.clear();
+		score_t sum = 0.0;
+		for(const auto& posting_helper : posting_lists_its)
+			upper_bounds.push_back(sum += scorer.get_sigma(posting_helper.pl.get_lexicon_value()));
+	};
+	compute_upper_bounds();
 
 	// Iterate all documents 'til we exhaust them or the pruning condition is met
 	while(pivot < posting_lists_its.size() and not posting_lists_its.empty())
 	{
 		score_t score = 0.0;
+		size_t scored = 0;
 		docid_t next = DOCID_MAX;
+		const score_t curr_θ = threshold();
 
 		// Move the iterator to (p + pivot)
 		auto p_it = posting_lists_its.begin();
@@ -57,61 +73,94 @@ std::vector<result_t> Index<SigmaLexiconValue>::query_bmm(std::set<std::string>
 			{
 				score += p_it->pl.score(p_it->it, scorer);
 				++p_it->it;
+				scored += 1;
 			}
 			
 			next = std::min(next, p_it->it->first);
 		}
 
-		if(pivot != 0 and score + upper_bounds[pivot - 1] > θ)
+		if(pivot != 0 and score + upper_bounds[pivot - 1] > curr_θ)
 		{
 			auto p_it = posting_lists_its.begin();
 			std::vector<score_t> bub(pivot);
 
+			// The upper bound of the block that may contain the document, a list whose skip list ends before it can't
+			const auto block_sigma = [&](const PostingListHelper& h) {
+				const auto block = h.it.find_block(curr_docid);
+				return block == h.pl.get_lexicon_value().skip_pointers.end() ? 0.0 : scorer.get_sigma(*block);
+			};
+
 			// Populate the bub's array
-			bub[0] = scorer.get_sigma(p_it->it.get_current_skip_block());
+			bub[0] = block_sigma(*p_it);
 			for(size_t i = 1; i < pivot; ++i)
 			{
 				++p_it;
-				bub[i] = bub[i - 1] + scorer.get_sigma(p_it->it.get_current_skip_block());
+				bub[i] = bub[i - 1] + block_sigma(*p_it);
 			}
 			
-			// Score the non essential list, if the score is less than the bub we skip the block
+			// Score the non essential list, from the last one backwards. If the score plus the bub can't beat the
+			// threshold we skip the document
 			for(size_t j = 0; j < pivot; ++j)
 			{
 				size_t i = pivot - j - 1;
-				if(score + bub[i] <= θ)
+				if(score + bub[i] <= curr_θ)
 					break;
 
 				// Move to next posting
 				p_it->it.nextGEQ(curr_docid);
 				if(p_it->it != p_it->pl.end() and p_it->it->first == curr_docid)
+				{
 					score += p_it->pl.score(p_it->it, scorer);
+					scored += 1;
+				}
+
+				if(i > 0)
+					--p_it;
 			}
 		}
 
-		// Push computed result in the results, only if our score is greater than worst scoring doc in results
-		if(results.size() < top_k or score > results.top().score)
-		{
-			results.push({curr_docid, score});
+		if(stats)
+			stats->postings_scored += scored;
 
+		// Push computed result in the results, only if our score is greater than worst scoring doc in results and
+		// than the other chunks' threshold
+		if((results.size() < top_k or score > results.top().score) and
+			(shared_threshold == nullptr or score > shared_threshold->get()))
+		{
 			// If necessary pop-out the worst scoring element
-			if (results.size() > top_k)
-				results.pop();
+			push_result(results, top_k, {curr_docid, score}, stats);
 
-			θ = results.top().score;
+			// The threshold is meaningful only once we have k results
+			if(results.size() == top_k)
+			{
+				θ = results.top().score;
+				if(shared_threshold)
+					shared_threshold->raise(θ);
+			}
+		}
+
+		// Out of budget, the top-k found so far is returned
+		if(budget and budget->charge(scored))
+			break;
 
-			while (pivot < posting_lists_its.size() and upper_bounds[pivot] <= θ)
-				++pivot;
+		// Our threshold, or the other chunks' one, may have grown
+		for(const score_t new_θ = threshold(); pivot < posting_lists_its.size() and upper_bounds[pivot] <= new_θ;)
+		{
+			++pivot;
+			if(stats)
+				stats->pivot_moves += 1;
 		}
 
 		// Removed the exhausted posting lists
 		size_t j = 0;
+		bool removed = false;
 		for(auto p_it = posting_lists_its.begin(); p_it != posting_lists_its.end();)
 		{
 			// We exhausted this posting list, let's remove it
 			if(p_it->it == p_it->pl.end())
 			{
 				p_it = posting_lists_its.erase(p_it);
+				removed = true;
 
 				// Shift the pivot if necessary, that is when 
 				// we removed a posting list before the pivot
@@ -126,41 +175,192 @@ std::vector<result_t> Index<SigmaLexiconValue>::query_bmm(std::set<std::string>
 			++j;
 		}
 
+		// The bounds are prefix sums, the ones after a removed list must lose its sigma
+		if(removed)
+			compute_upper_bounds();
+
 		curr_docid = next;
 	}
 
 	return convert_results(results, top_k);
 }
 
+// BMM needs the skip lists' upper bounds, thus it's only instantiated for the sigma lexicon
+template std::vector<docid_result_t> Index<SigmaLexiconValue>::query_bmm<QueryBM25Scorer>(std::set<std::string>, size_t, SharedThreshold*, QueryStats*, QueryBudget*);
+template std::vector<docid_result_t> Index<SigmaLexiconValue>::query_bmm<QueryTFIDFScorer>(std::set<std::string>, size_t, SharedThreshold*, QueryStats*, QueryBudget*);
+
+/**
+* Function responsible for the block-max conjunctive (BM-AND) query processing. The candidates are proposed by the
+* shortest posting list, as in the conjunctive DAAT. Before aligning the lists, the blocks that may contain the
+* candidate are located on the skip lists, without decoding them: if the sum of their upper bounds can't beat the
+* threshold, no document up to the first block boundary can, and all of them are skipped at once.
+* @param query The query to be processed.
+* @param top_k The number of top results to be returned.
+* @param shared_threshold If not null, the top-k threshold shared with the other index chunks solving this query.
+* @param stats If not null, the work done by the query is counted in it.
+* @param budget If not null, the query stops when it runs out and returns the top-k found so far.
+* @return A vector of results.
+*/
+template<class LVT>
+template<class Scorer>
+std::vector<docid_result_t> Index<LVT>::query_bmand(std::set<std::string> query, size_t top_k, SharedThreshold *shared_threshold,
+													QueryStats *stats, QueryBudget *budget)
+{
+	TRACE_SPAN("bmand", "query");
+	const Scorer scorer{};
+	pending_results_t results;
+	score_t θ = 0.0; // k-th best score found so far by this chunk
+
+	auto [posting_lists_its, min_docid] = build_helpers(query, true, stats);
+	if(posting_lists_its.empty())
+		return {};
+
+	const auto threshold = [&] {return shared_threshold ? std::max(θ, shared_threshold->get()) : θ;};
+
+	// Shortest list first
+	posting_lists_its.sort([](const PostingListHelper& a, const PostingListHelper& b) {
+		return a.pl.get_lexicon_value().n_docs < b.pl.get_lexicon_value().n_docs;
+	});
+
+	auto& lead = posting_lists_its.front();
+	docid_t candidate = lead.it->first;
+
+	while(true)
+	{
+		// Sum the upper bounds of the blocks that may contain the candidate. A list whose skip list ends before the
+		// candidate contributes its sigma
+		score_t block_ub = 0.0;
+		docid_t boundary = DOCID_MAX;
+		for(const auto& posting_helper : posting_lists_its)
+		{
+			const auto block = posting_helper.it.find_block(candidate);
+			if(block == posting_helper.pl.get_lexicon_value().skip_pointers.end())
+			{
+				block_ub += scorer.get_sigma(posting_helper.pl.get_lexicon_value());
+				continue;
+			}
+
+			block_ub += scorer.get_sigma(*block);
+			boundary = std::min(boundary, block->last_docid);
+		}
+
+		bool match = false;
+		if(block_ub > threshold())
+		{
+			// Align the other lists to the candidate, stop at the first one that doesn't contain it
+			match = true;
+			for(auto p_it = std::next(posting_lists_its.begin()); p_it != posting_lists_its.end(); ++p_it)
+			{
+				p_it->it.nextGEQ(candidate);
+
+				// A list is exhausted, there are no more documents in the intersection
+				if(p_it->it == p_it->pl.end())
+					return convert_results(results, top_k);
+
+				if(p_it->it->first != candidate)
+				{
+					candidate = p_it->it->first;
+					match = false;
+					break;
+				}
+			}
+		}
+		// The bounds hold 'til the nearest block boundary, if there isn't one no document can beat the threshold
+		else if(boundary == DOCID_MAX)
+			break;
+		else
+			candidate = boundary + 1;
+
+		if(match)
+		{
+			score_t score = 0.0;
+			for(auto& posting_helper : posting_lists_its)
+				score += posting_helper.pl.score(posting_helper.it, scorer);
+			if(stats)
+				stats->postings_scored += posting_lists_its.size();
+
+			if((results.size() < top_k or score > results.top().score) and
+			   (shared_threshold == nullptr or score > shared_threshold->get()))
+			{
+				push_result(results, top_k, {candidate, score}, stats);
+
+				if(results.size() == top_k)
+				{
+					θ = results.top().score;
+					if(shared_threshold)
+						shared_threshold->raise(θ);
+				}
+			}
+
+			++lead.it;
+		}
+		else
+			lead.it.nextGEQ(candidate);
+
+		// Out of budget, the top-k found so far is returned. Skipped candidates are charged too
+		if(budget and budget->charge(match ? posting_lists_its.size() : 0))
+			break;
+
+		if(lead.it == lead.pl.end())
+			break;
+
+		candidate = lead.it->first;
+	}
+
+	return convert_results(results, top_k);
+}
+
+template std::vector<docid_result_t> Index<SigmaLexiconValue>::query_bmand<QueryBM25Scorer>(std::set<std::string>, size_t, SharedThreshold*, QueryStats*, QueryBudget*);
+template std::vector<docid_result_t> Index<SigmaLexiconValue>::query_bmand<QueryTFIDFScorer>(std::set<std::string>, size_t, SharedThreshold*, QueryStats*, QueryBudget*);
+
 template<>
 Index<SigmaLexiconValue>::PostingList::iterator Index<SigmaLexiconValue>::PostingList::begin() const
 {
-	auto it = iterator{this, lv.skip_pointers.begin(), docid_dec.begin(), freq_dec.begin()};
-	it.current = {*it.docid_curr, *it.freq_curr};
+	auto it = iterator{this, lv.skip_pointers.begin(), docid_dec.begin(), freq_begin(), impacts};
+	it.parse();
 	return it;
 }
 
 template<>
 Index<SigmaLexiconValue>::PostingList::iterator Index<SigmaLexiconValue>::PostingList::end() const
 {
-	return {this, lv.skip_pointers.end(), docid_dec.end(), freq_dec.end()};
+	return {this, lv.skip_pointers.end(), docid_dec.end(), freq_dec.end(), impacts + lv.n_docs};
+}
+
+/**
+* Prefetches the first cache lines of a block's docids and freqs, so that they're likely in cache when the traversal
+* gets there. Prefetches never fault, pages that are not mapped yet are left to the readahead.
+*/
+template<>
+void Index<SigmaLexiconValue>::PostingList::iterator::prefetch_block(SigmaLexiconValue::skip_list_t::const_iterator block) const
+{
+	if(block == parent->lv.skip_pointers.end())
+		return;
+
+	const auto& lv = parent->lv;
+	const auto* index = parent->index;
+	__builtin_prefetch(index->inverted_indices + lv.start_pos_docid + block->docid_offset);
+	__builtin_prefetch(index->inverted_indices_freqs + lv.start_pos_freq + codes::deserialize_bit_offset(block->freq_offset).first);
 }
 
 template<>
 Index<SigmaLexiconValue>::PostingList::iterator& Index<SigmaLexiconValue>::PostingList::iterator::operator++()
 {
 	++docid_curr;
-	++freq_curr;
+	next_freq();
 
 	// Parse
 	if(*this != parent->end())
 	{
-		current.first = *docid_curr;
-		current.second = *freq_curr;
+		parse();
 
 		// Specialization: if we reached end of a block, we move to the next one
 		if(current_block_it != parent->lv.skip_pointers.end() and current.first > current_block_it->last_docid)
+		{
 			++current_block_it;
+			if(current_block_it != parent->lv.skip_pointers.end())
+				prefetch_block(current_block_it + 1);
+		}
 	}
 	return *this;
 }
@@ -180,23 +380,68 @@ void Index<SigmaLexiconValue>::PostingList::iterator::nextG(sindex::docid_t doci
 template<>
 void Index<SigmaLexiconValue>::PostingList::iterator::nextGEQ(sindex::docid_t docid)
 {
-	// Move to the next block until we find one that contains the docid
-	while(current_block_it != parent->lv.skip_pointers.end() and current_block_it->last_docid < docid)
-		skip_block();
+	const auto& skip_pointers = parent->lv.skip_pointers;
+
+	if(current_block_it != skip_pointers.end() and current_block_it->last_docid < docid)
+	{
+		auto target = find_block(docid);
+
+		// No block ends after the docid, we scan the last one 'til the end
+		if(target == skip_pointers.end())
+			--target;
+
+		if(target != current_block_it)
+			seek_block(target);
+	}
 
 	// Found block, now iterate until we required docid
 	while(*this != parent->end() and current.first < docid)
 		++*this;
 }
 
+/**
+* Gallops over the skip list to find the first block that may contain the docid: probes blocks at exponentially
+* growing distances, then binary searches the last interval. Long jumps cost O(log(distance)) instead of O(distance).
+*/
+template<>
+SigmaLexiconValue::skip_list_t::const_iterator Index<SigmaLexiconValue>::PostingList::iterator::find_block(docid_t docid) const
+{
+	const auto& skip_pointers = parent->lv.skip_pointers;
+	if(current_block_it == skip_pointers.end() or current_block_it->last_docid >= docid)
+		return current_block_it;
+
+	auto lo = current_block_it + 1, hi = lo;
+	for(ptrdiff_t step = 1; hi != skip_pointers.end() and hi->last_docid < docid; step *= 2)
+	{
+		lo = hi + 1;
+		hi = lo + std::min(step, skip_pointers.end() - lo);
+	}
+
+	return std::lower_bound(lo, hi, docid, [](const SigmaLexiconValue::skip_pointer_t& block, docid_t d) {
+		return block.last_docid < d;
+	});
+}
+
 /**
 * Skip block implementation for sigma lexicon.
 */
 template<>
 void Index<SigmaLexiconValue>::PostingList::iterator::skip_block()
 {
-	// Move to the next block
-	++current_block_it;
+	seek_block(current_block_it + 1);
+}
+
+/**
+* Moves the iterator to the first posting of the given block, without decoding the ones in between.
+*/
+template<>
+void Index<SigmaLexiconValue>::PostingList::iterator::seek_block(SigmaLexiconValue::skip_list_t::const_iterator block)
+{
+	if(parent->stats)
+		parent->stats->blocks_skipped += block - current_block_it;
+
+	// Move to the block
+	current_block_it = block;
 
 	// We reached the end!
 	if(current_block_it == parent->lv.skip_pointers.end())
@@ -205,14 +450,18 @@ void Index<SigmaLexiconValue>::PostingList::iterator::skip_block()
 	// Update docid and freq iterators only if we haven't reached the end
 	docid_curr = parent->docid_dec.at(current_block_it->docid_offset);
 	auto freq_off = codes::deserialize_bit_offset(current_block_it->freq_offset);
-	freq_curr = parent->freq_dec.at(freq_off.first, freq_off.second);
+	if(parent->index->quantized)
+		impact_curr = parent->impacts + freq_off.first;
+	else
+		freq_curr = parent->freq_dec.at(freq_off.first, freq_off.second);
 
-	current.first = *docid_curr;
-	current.second = *freq_curr;
+	parse();
+	prefetch_block(current_block_it + 1);
 
 	assert(current.first - parent->index->base_docid < parent->index->n_docs);
 }
 
+
 template<>
 const SigmaLexiconValue::skip_pointer_t& Index<SigmaLexiconValue>::PostingList::iterator::get_current_skip_block() const
 {
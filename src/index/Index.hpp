@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <queue>
 #include <set>
 #include <unordered_map>
@@ -13,6 +14,16 @@
 #include "types.hpp"
 #include "../util/memory.hpp"
 #include "query_scorer.hpp"
+#include "impact.hpp"
+#include "metadata.hpp"
+#include "shared_threshold.hpp"
+#include "query_stats.hpp"
+#include "query_budget.hpp"
+#include "pair_cache.hpp"
+#include "positions.hpp"
+#include "../util/readahead.hpp"
+#include "../util/block_cache.hpp"
+#include "../util/trace.hpp"
 
 namespace sindex
 {
@@ -33,6 +44,8 @@ class Index{
 public:
 	using local_lexicon_t = codes::disk_map<LVT>;
 	using global_lexicon_t = codes::disk_map<freq_t>;
+	using impact_lexicon_t = codes::disk_map<ImpactLexiconValue>;
+	using positions_lexicon_t = codes::disk_map<PositionsLexiconValue>;
 
 private:
 	docid_t base_docid; // The base docid, used to compute the docno offset
@@ -55,51 +68,108 @@ private:
 	// A series of docno strs, the offsets are written in document_index's elements
 	const char* base_docno;
 
-	QueryScorer& scorer;
+	// BM25's length normalization of each document, precomputed at load time with doc_norms_scorer's parameters
+	std::vector<float> doc_norms;
+	QueryBM25Scorer doc_norms_scorer;
 
-	struct pending_result_t {
-		docid_t docid;
-		score_t score;
+	// If true the freqs stream holds one quantized BM25 impact per posting instead of the unary-encoded tfs
+	bool quantized = false;
 
-		bool operator>(const pending_result_t& b) const {return score > b.score;}
-	};
+	// Optional impact-ordered copy of the posting lists, used by score-at-a-time query processing
+	ImpactQuantizer quantizer;
+	std::optional<impact_lexicon_t> impact_lexicon;
+	const uint8_t *impact_postings = nullptr;
+	size_t impact_postings_length = 0;
+
+	// Optional positions of the postings, they're only read by the phrase queries
+	std::optional<positions_lexicon_t> positions_lexicon;
+	const uint8_t *positions = nullptr;
+
+	// Optional bitmap of the deleted documents, one bit per document of the chunk. They're kept out of the results
+	const uint8_t *deleted = nullptr;
+
+	// Optional cache of the intersections of frequent term pairs, used by the conjunctive queries
+	std::unique_ptr<PairCache> pair_cache;
+
+	// Optional readahead of the posting lists of a query, issued as soon as its terms are looked up
+	readahead_queue *readahead = nullptr;
+	size_t readahead_bytes = 0;
+
+	/** Enqueues the readahead of the first bytes of a posting list, the docids' and the freqs' ones */
+	void read_ahead(const LVT& lv) const;
+
+	// Optional block caches the posting lists are read through, in place of mapped files
+	memory_block_cache *docids_cache = nullptr;
+	memory_block_cache *freqs_cache = nullptr;
+
+	using pending_result_t = docid_result_t;
 
 	struct PostingListHelper;
 
 	/**
 	 * Build the posting lists' iterators for the given query. If in conj mode it returns an empty list if one of the
-	 * terms is not in the lexicon.
+	 * terms is not in the lexicon. If stats is not null, the posting lists count their work in it.
 	 */
-	std::pair<std::list<PostingListHelper>, docid_t> build_helpers(std::set<std::string> &query, bool conj = false);
+	std::pair<std::list<PostingListHelper>, docid_t> build_helpers(std::set<std::string> &query, bool conj = false,
+																	QueryStats *stats = nullptr);
+
+	/** DAAT in conjunctive mode, the intersection is driven by the shortest posting list */
+	template<class Scorer>
+	std::vector<docid_result_t> query_conjunctive(std::set<std::string> query, size_t top_k, SharedThreshold *shared_threshold,
+											QueryStats *stats, QueryBudget *budget);
+
+	/**
+	 * Looks for a cached intersection of two of the query terms, or materializes the one of the two shortest lists
+	 * if the pair is frequent enough. The lists must be sorted by length, the ones of the pair are removed.
+	 * Materializing the intersection is charged to the query's budget and counted in its stats.
+	 */
+	template<class Scorer>
+	std::shared_ptr<const PairPostings> take_pair(std::list<PostingListHelper>& posting_lists_its, const Scorer& scorer,
+												  QueryStats *stats, QueryBudget *budget);
 
 	// Top-K results. This is a min queue (for that we use std::greater, of course), so that the minimum element can
 	// be popped
 	using pending_results_t = std::priority_queue<pending_result_t, std::vector<pending_result_t>, std::greater<>>;
 
 	/**
-	 * Convert the pending results into a vector of results.
+	 * Pushes a document in the top-k results, the worst one is popped out if they're more than top_k. Deleted
+	 * documents are skipped
+	 */
+	void push_result(pending_results_t& results, size_t top_k, pending_result_t result, QueryStats *stats) const
+	{
+		if(is_deleted(result.docid))
+			return;
+
+		results.push(result);
+		if(stats)
+			stats->heap_pushes += 1;
+
+		if(results.size() > top_k)
+		{
+			results.pop();
+			if(stats)
+				stats->heap_evictions += 1;
+		}
+	}
+
+	/**
+	 * Convert the pending results into a vector of results, best first. The docnos are not resolved, the caller
+	 * does it only for the results that make it into the final top-k.
 	 * @param results The pending results.
 	 * @param top_k The number of top results to be returned.
 	 * @return A vector of results.
 	 */
-	std::vector<result_t> convert_results(pending_results_t& results, size_t top_k)
+	std::vector<docid_result_t> convert_results(pending_results_t& results, [[maybe_unused]] size_t top_k)
 	{
-		// Build results
-		std::vector<result_t> final_results;
-		final_results.reserve(top_k);
+		TRACE_SPAN("convert results", "query");
+		assert(results.size() <= top_k);
 
-		while(not results.empty())
+		// Results are popped in increasing order, we fill the vector from its back, to have descending order
+		std::vector<docid_result_t> final_results(results.size());
+		for(auto res_it = final_results.rbegin(); res_it != final_results.rend(); ++res_it)
 		{
-			auto res = results.top();
+			*res_it = results.top();
 			results.pop();
-
-			result_t res_f = {
-					.docno = std::string(base_docno + document_index[res.docid - base_docid].docno_offset),
-					.score = res.score
-			};
-
-			// Results are read in increasing order, we have to push them in front, to have descending order
-			final_results.insert(final_results.begin(), res_f);
 		}
 
 		return final_results;
@@ -113,15 +183,109 @@ public:
 	 * @param iif inverted indices freqs
 	 * @param di document index
 	 * @param metadata metadata (N, sigma, avgdl, etc...)
-	 * @param qs query_scorer to use
 	 */
 	Index(local_lexicon_t lx, global_lexicon_t& gx, const memory_area& iid, const memory_area& iif,
-		  const memory_area& di, const memory_area& metadata, QueryScorer& qs);
+		  const memory_area& di, const memory_area& metadata);
 	~Index();
 
-	void set_scorer(QueryScorer& qs) {scorer = qs;}
-	std::vector<result_t> query(std::set<std::string> query, bool conj = false, size_t top_k = 10);
-	std::vector<result_t> query_bmm(std::set<std::string> query, size_t top_k = 10);
+	/*
+	 * Query processing algorithms are instantiated once per scorer type, so that scoring a posting doesn't go
+	 * through a virtual call. The scorer is chosen per query, the same index can serve any of them concurrently.
+	 * They score with the scorer's default parameters: the terms' upper bounds, the quantized scores and the BM25
+	 * norms are computed with them.
+	 * If stats is not null, the algorithms count the work they do for the query in it, see QueryStats.
+	 * If budget is not null, they stop when it runs out and return the top-k found so far, see QueryBudget.
+	 */
+	template<class Scorer>
+	std::vector<docid_result_t> query(std::set<std::string> query, bool conj = false, size_t top_k = 10,
+								SharedThreshold *shared_threshold = nullptr, QueryStats *stats = nullptr,
+									QueryBudget *budget = nullptr);
+
+	/** Only available for Index<SigmaLexiconValue>, it is instantiated for QueryBM25Scorer and QueryTFIDFScorer */
+	template<class Scorer>
+	std::vector<docid_result_t> query_bmm(std::set<std::string> query, size_t top_k = 10,
+									SharedThreshold *shared_threshold = nullptr, QueryStats *stats = nullptr,
+									QueryBudget *budget = nullptr);
+
+	/**
+	 * Block-max conjunctive query processing. Only available for Index<SigmaLexiconValue>, it is instantiated for
+	 * QueryBM25Scorer and QueryTFIDFScorer
+	 */
+	template<class Scorer>
+	std::vector<docid_result_t> query_bmand(std::set<std::string> query, size_t top_k = 10,
+									  SharedThreshold *shared_threshold = nullptr, QueryStats *stats = nullptr,
+									QueryBudget *budget = nullptr);
+
+	/**
+	 * Scores some documents of this chunk for the query, as the disjunctive DAAT would. Each posting list is moved
+	 * through the documents once, skipping the blocks in between
+	 * @param docids the documents, in increasing order
+	 * @return their scores, in the same order. 0 for the documents that contain none of the terms
+	 */
+	template<class Scorer>
+	std::vector<score_t> score_documents(std::set<std::string> query, const std::vector<docid_t>& docids);
+
+	/**
+	 * Attaches the impact-ordered posting lists written by the builder to this index
+	 * @param lx the impact lexicon
+	 * @param ip the impact-ordered posting lists
+	 */
+	void load_impacts(impact_lexicon_t lx, const memory_area& ip);
+
+	/**
+	 * Attaches the positions written by the builder to this index
+	 * @param lx the positions' lexicon
+	 * @param pp the positions of the posting lists
+	 */
+	void load_positions(positions_lexicon_t lx, const memory_area& pp);
+	bool has_positions() const {return positions_lexicon.has_value();}
+
+	/** The positions of a term in this chunk, none if the chunk has no positions or the term is not there */
+	std::optional<PositionsCursor> get_positions(const std::string& term);
+
+	/**
+	 * Attaches the bitmap of the deleted documents written by the builder to this index
+	 * @param dd the bitmap, bit i of byte i / 8 is the document base docid + i
+	 */
+	void load_deleted(const memory_area& dd) {deleted = dd.get().first;}
+	bool is_deleted(docid_t docid) const
+	{
+		return deleted and (deleted[(docid - base_docid) / 8] >> ((docid - base_docid) % 8)) & 1;
+	}
+
+	/**
+	 * DAAT with phrase and proximity operators. The terms of the operators are always required, the others only in
+	 * conjunctive mode. Positions are decoded only for the documents that contain all the required terms.
+	 */
+	template<class Scorer>
+	std::vector<docid_result_t> query_phrase(std::set<std::string> query, const std::vector<phrase_t>& phrases,
+									   bool conj = false, size_t top_k = 10, SharedThreshold *shared_threshold = nullptr,
+									   QueryStats *stats = nullptr, QueryBudget *budget = nullptr);
+
+	/**
+	 * Enables the cache of the intersections of frequent term pairs, for conjunctive queries
+	 * @param max_bytes memory limit of the cache
+	 * @param admission number of requests needed by a pair to be cached
+	 */
+	void enable_pair_cache(size_t max_bytes, unsigned admission = 2) {pair_cache = std::make_unique<PairCache>(max_bytes, admission);}
+
+	/**
+	 * Enables the readahead of the queries' posting lists
+	 * @param queue the background thread that issues the readahead, it may be shared among the index chunks
+	 * @param max_bytes how many bytes to read ahead from the start of each posting list's streams
+	 */
+	void enable_readahead(readahead_queue& queue, size_t max_bytes) {readahead = &queue; readahead_bytes = max_bytes;}
+
+	/**
+	 * Reads the posting lists through block caches. They must be the memory areas the index was built with, the
+	 * posting lists of each query are loaded and pinned before they're read. The readahead is not needed anymore
+	 */
+	void enable_block_cache(memory_block_cache& docids, memory_block_cache& freqs) {docids_cache = &docids; freqs_cache = &freqs;}
+	bool has_block_cache() const {return docids_cache != nullptr;}
+	bool has_impacts() const {return impact_lexicon.has_value();}
+	const ImpactQuantizer& get_quantizer() const {return quantizer;}
+	std::vector<docid_result_t> query_saat(std::set<std::string> query, size_t top_k = 10, QueryBudget *budget = nullptr,
+										   QueryStats *stats = nullptr);
 
 	/**
 	 * This class represents a posting list and is used to iterate over it.
@@ -137,6 +301,13 @@ public:
 
 		docid_decoder_t docid_dec;
 		freq_decoder_t freq_dec;
+		const impact_t *impacts;
+
+		// The term's counters, if the query collects them
+		QueryStats::term_t *stats = nullptr;
+
+		/** The unary decoder must not parse the impacts' stream, in such case it stays at its end */
+		freq_decoder_t::iterator freq_begin() const {return index->quantized ? freq_dec.end() : freq_dec.begin();}
 
 	public:
 		struct offset {uint64_t docid_off; uint64_t freq_off;};
@@ -149,20 +320,42 @@ public:
 			SigmaLexiconValue::skip_list_t::const_iterator current_block_it;
 			docid_decoder_t::iterator docid_curr;
 			freq_decoder_t::iterator freq_curr;
+			// Used in place of freq_curr by quantized indices
+			const impact_t *impact_curr;
 
 			std::pair<docid_t, freq_t> current;
 
-			iterator(PostingList const *parent, docid_decoder_t::iterator docid_curr, freq_decoder_t::iterator freq_curr):
-					parent(parent), docid_curr(docid_curr), freq_curr(freq_curr)
+			iterator(PostingList const *parent, docid_decoder_t::iterator docid_curr, freq_decoder_t::iterator freq_curr, const impact_t *impact_curr):
+					parent(parent), docid_curr(docid_curr), freq_curr(freq_curr), impact_curr(impact_curr)
 			{}
 
-			iterator(PostingList const *parent, SigmaLexiconValue::skip_list_t::const_iterator current_block_it, docid_decoder_t::iterator docid_curr, freq_decoder_t::iterator freq_curr):
-					parent(parent), current_block_it(current_block_it), docid_curr(docid_curr), freq_curr(freq_curr)
+			iterator(PostingList const *parent, SigmaLexiconValue::skip_list_t::const_iterator current_block_it, docid_decoder_t::iterator docid_curr, freq_decoder_t::iterator freq_curr, const impact_t *impact_curr):
+					parent(parent), current_block_it(current_block_it), docid_curr(docid_curr), freq_curr(freq_curr), impact_curr(impact_curr)
 			{}
 
-			// Since skip_block is only used in the skip list specialization, we can abort if it is called in the
-			// generic one
+			/** Reads the current posting, from the tfs' or the impacts' stream */
+			void parse()
+			{
+				current.first = *docid_curr;
+				current.second = parent->index->quantized ? *impact_curr : *freq_curr;
+				if(parent->stats)
+					parent->stats->postings_decoded += 1;
+			}
+
+			void next_freq()
+			{
+				if(parent->index->quantized)
+					++impact_curr;
+				else
+					++freq_curr;
+			}
+
+			// Since skip_block and seek_block are only used in the skip list specialization, we can abort if they are
+			// called in the generic one
 			void skip_block() {abort();};
+			void seek_block(SigmaLexiconValue::skip_list_t::const_iterator) {abort();};
+			/** Software prefetch of the first postings of a block, there are no blocks in the generic one */
+			void prefetch_block(SigmaLexiconValue::skip_list_t::const_iterator) const {};
 		public:
 
 		 	const std::pair<docid_t, freq_t>& operator*() const {return current;}
@@ -171,14 +364,12 @@ public:
 			iterator& operator++() 
 			{
 				++docid_curr;
-				++freq_curr;
+				next_freq();
 
 				// Parse
 				if(*this != parent->end())
-				{
-					current.first = *docid_curr;
-					current.second = *freq_curr;
-				}
+					parse();
+
 				return *this;
 			}
 
@@ -196,13 +387,17 @@ public:
 			void nextG(docid_t);
 			void nextGEQ(docid_t);
 			const SigmaLexiconValue::skip_pointer_t& get_current_skip_block() const {abort();};
+			/** The first block, from the current one, whose last docid is >= docid. Nothing is decoded */
+			SigmaLexiconValue::skip_list_t::const_iterator find_block(docid_t) const {abort();};
 
 			friend PostingList;
 		};
 
 
-		PostingList(Index const *index, const std::string& term, const LVT& lv);
-		score_t score(const PostingList::iterator& it, const QueryScorer& scorer) const;
+		/** @param stats if not null, the term's counters are added to it */
+		PostingList(Index const *index, const std::string& term, LVT lv, QueryStats *stats = nullptr);
+		template<class Scorer>
+		score_t score(const PostingList::iterator& it, const Scorer& scorer) const;
 
 		iterator begin() const;
 		iterator end() const;
@@ -215,12 +410,31 @@ public:
 	PostingList get_posting_list(const std::string& term, const LexiconValue& lv) const {return PostingList(this, term, lv);}
 	local_lexicon_t& get_local_lexicon() {return local_lexicon;}
 
+	// Documents of this chunk, their docids go from the base docid up to base docid + number of documents
+	docid_t get_base_docid() const {return base_docid;}
+	size_t get_n_local_docs() const {return document_index_length;}
+	DocumentInfo get_document_info(docid_t docid) const
+	{
+		const auto& doc = document_index[docid - base_docid];
+		return {.docno = std::string(base_docno + doc.docno_offset), .lenght = doc.lenght};
+	}
+
+	/** The docno of one of this chunk's documents, it points into the mapped document index */
+	std::string_view get_docno(docid_t docid) const {return base_docno + document_index[docid - base_docid].docno_offset;}
+
 private:
 	struct PostingListHelper
 	{
+		// Keep the posting list's blocks loaded, if it's read through the block caches. Released after pl
+		memory_block_cache::pin docids_pin, freqs_pin;
 		PostingList pl; typename PostingList::iterator it;
+		// Points to the query's term
+		std::string_view term;
 
-		explicit PostingListHelper(PostingList&& pl): pl(std::move(pl)), it(this->pl.begin()) {}
+		PostingListHelper(PostingList&& pl, std::string_view term): pl(std::move(pl)), it(this->pl.begin()), term(term) {}
+		PostingListHelper(PostingList&& pl, std::string_view term, memory_block_cache::pin&& docids_pin, memory_block_cache::pin&& freqs_pin):
+				docids_pin(std::move(docids_pin)), freqs_pin(std::move(freqs_pin)),
+				pl(std::move(pl)), it(this->pl.begin()), term(term) {}
 	};
 };
 
@@ -244,9 +458,15 @@ void Index<SigmaLexiconValue>::PostingList::iterator::nextGEQ(sindex::docid_t);
 template<>
 void Index<SigmaLexiconValue>::PostingList::iterator::skip_block();
 
+template<>
+void Index<SigmaLexiconValue>::PostingList::iterator::seek_block(SigmaLexiconValue::skip_list_t::const_iterator);
+
 template<>
 const SigmaLexiconValue::skip_pointer_t& Index<SigmaLexiconValue>::PostingList::iterator::get_current_skip_block() const;
 
+template<>
+SigmaLexiconValue::skip_list_t::const_iterator Index<SigmaLexiconValue>::PostingList::iterator::find_block(docid_t) const;
+
 }
 
 #include "Index.template.hpp"
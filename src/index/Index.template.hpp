@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <set>
 #include <list>
+#include <map>
 #include <queue>
 #include <utility>
 #include "Index.hpp"
@@ -15,8 +16,8 @@ namespace sindex
 
 template<class LVT>
 Index<LVT>::Index(local_lexicon_t lx, global_lexicon_t &gx, const memory_area &iid,
-			 const memory_area &iif, const memory_area &di, const memory_area& metadata, QueryScorer& qs):
-	local_lexicon(std::move(lx)), global_lexicon(gx), scorer(qs)
+			 const memory_area &iif, const memory_area &di, const memory_area& metadata):
+	local_lexicon(std::move(lx)), global_lexicon(gx)
 {
 	auto t = iid.get();
 	inverted_indices = t.first;
@@ -32,9 +33,18 @@ Index<LVT>::Index(local_lexicon_t lx, global_lexicon_t &gx, const memory_area &i
 	document_index = (DocumentInfoSerialized*)(t.first + sizeof(docid_t) + sizeof(size_t));
 	base_docno = (const char*)t.first + sizeof(docid_t) + sizeof(size_t) + document_index_length * sizeof(DocumentInfoSerialized);
 
-	t = metadata.get();
-	n_docs = *(size_t*)(t.first + sizeof(doclen_t));
-	avgdl = (double)(*(doclen_t*)t.first) / n_docs;
+	const auto collection_metadata = CollectionMetadata::read(metadata);
+	n_docs = collection_metadata.n_docs;
+	avgdl = (double)collection_metadata.doc_len_sum / n_docs;
+	quantizer = ImpactQuantizer(collection_metadata.impact_upper_bound);
+
+	// Only the sigma lexica point to the impacts, the temporary ones always point to the tfs
+	quantized = std::is_same_v<LVT, SigmaLexiconValue> and collection_metadata.quantized;
+
+	// Precompute BM25's length normalization, with the default parameters: the ones the query algorithms use
+	doc_norms.resize(document_index_length);
+	for(size_t i = 0; i < document_index_length; ++i)
+		doc_norms[i] = doc_norms_scorer.doc_norm(document_index[i].lenght, avgdl);
 }
 
 template<class LVT>
@@ -50,16 +60,23 @@ Index<LVT>::~Index()
  * @return The external representation of the results.
  */
 template<class LVT>
-std::pair<std::list<typename Index<LVT>::PostingListHelper>, docid_t> Index<LVT>::build_helpers(std::set<std::string> &query, bool conj)
+std::pair<std::list<typename Index<LVT>::PostingListHelper>, docid_t> Index<LVT>::build_helpers(std::set<std::string> &query, bool conj, QueryStats *stats)
 {
 	std::list<PostingListHelper> posting_lists_its;
 	// size_t n_docs_to_process = 0; // Never used
 	docid_t docid_base = DOCID_MAX;
 
+	// Look up all the terms first, so that the readahead of the posting lists is issued before any of them is read
+	std::vector<std::pair<std::set<std::string>::iterator, LVT>> lexicon_values;
+	lexicon_values.reserve(query.size());
+
 	// Iterate over all query terms. We remove useless terms and create the iterators of their posting lists
 	for(auto q_term_it = query.begin(); q_term_it != query.end();)
 	{
+		TRACE_SPAN("lexicon lookup", "query");
 		auto posting_info_it = local_lexicon.find(*q_term_it);
+		if(stats)
+			stats->lexicon_probes += 1;
 
 		// Element not in lexicon, we'll not consider it
 		if(posting_info_it == local_lexicon.end())
@@ -72,37 +89,83 @@ std::pair<std::list<typename Index<LVT>::PostingListHelper>, docid_t> Index<LVT>
 			continue;
 		}
 
-		// Create 'n load posting list's info into vector
-		const auto& [term, posting_info] = *posting_info_it;
+		lexicon_values.emplace_back(q_term_it, posting_info_it->second);
+		if(readahead and not docids_cache)
+			read_ahead(lexicon_values.back().second);
+
+		++q_term_it;
+	}
 
-		PostingList pl(this, term, posting_info);
+	// With the block caches all the posting lists of the query are loaded at once, before the first is read
+	std::vector<memory_block_cache::pin> docids_pins, freqs_pins;
+	if(docids_cache)
+	{
+		// The decoders may read a few bytes past the end of a list
+		constexpr size_t PADDING = 16;
+		std::vector<std::pair<size_t, size_t>> docids_ranges, freqs_ranges;
+		for(const auto& [q_term_it, lv] : lexicon_values)
+		{
+			docids_ranges.emplace_back(lv.start_pos_docid, lv.end_pos_docid - lv.start_pos_docid + PADDING);
+			freqs_ranges.emplace_back(lv.start_pos_freq, lv.end_pos_freq - lv.start_pos_freq + PADDING);
+		}
+
+		TRACE_SPAN("block cache acquire", "query");
+		docids_pins = docids_cache->acquire(docids_ranges);
+		freqs_pins = freqs_cache->acquire(freqs_ranges);
+	}
+
+	for(size_t i = 0; i < lexicon_values.size(); ++i)
+	{
+		auto& [q_term_it, posting_info] = lexicon_values[i];
+
+		// Create 'n load posting list's info into vector
+		PostingList pl(this, *q_term_it, std::move(posting_info), stats);
 		// n_docs_to_process = std::max(n_docs_to_process, posting_info.n_docs);
-		posting_lists_its.emplace_back(std::move(pl));
+		if(docids_cache)
+			posting_lists_its.emplace_back(std::move(pl), *q_term_it, std::move(docids_pins[i]), std::move(freqs_pins[i]));
+		else
+			posting_lists_its.emplace_back(std::move(pl), *q_term_it);
 		const auto& it = posting_lists_its.back().it;
 
 		docid_base = std::min(docid_base, it->first);
-
-		++q_term_it;
 	}
 
 	return {std::move(posting_lists_its), docid_base};
 }
 
+template<class LVT>
+void Index<LVT>::read_ahead(const LVT& lv) const
+{
+	readahead->add(inverted_indices + lv.start_pos_docid, std::min(lv.end_pos_docid - lv.start_pos_docid, readahead_bytes));
+	readahead->add(inverted_indices_freqs + lv.start_pos_freq, std::min(lv.end_pos_freq - lv.start_pos_freq, readahead_bytes));
+}
+
 /**
 * Function responsible for the DAAT algorithm for query processing.
 * @param query The query to be processed.
 * @param conj If true, the query is processed in conjunctive mode.
 * @param top_k The number of top results to be returned.
+* @param shared_threshold If not null, the top-k threshold shared with the other index chunks solving this query.
+* @param stats If not null, the work done by the query is counted in it.
+* @param budget If not null, the query stops when it runs out and returns the top-k found so far.
 * @return A vector of results.
 */
 template<class LVT>
-std::vector<result_t> Index<LVT>::query(std::set<std::string> query, bool conj, size_t top_k)
+template<class Scorer>
+std::vector<docid_result_t> Index<LVT>::query(std::set<std::string> query, bool conj, size_t top_k, SharedThreshold *shared_threshold,
+											  QueryStats *stats, QueryBudget *budget)
 {
+	if(conj)
+		return query_conjunctive<Scorer>(std::move(query), top_k, shared_threshold, stats, budget);
+
+	TRACE_SPAN("daat", "query");
+	const Scorer scorer{};
+
 	// Top-K results. This is a min queue (for that we use std::greater, of course), so that the minimum element can
 	// be popped
 	pending_results_t results;
 
-	auto [posting_lists_its, min_docid] = build_helpers(query, conj);
+	auto [posting_lists_its, min_docid] = build_helpers(query, false, stats);
 	docid_t curr_docid = min_docid;
 
 	if(posting_lists_its.empty())
@@ -113,33 +176,38 @@ std::vector<result_t> Index<LVT>::query(std::set<std::string> query, bool conj,
 	while(not posting_lists_its.empty())
 	{
 		score_t score = 0;
-
-		bool contains_all_terms = std::all_of(posting_lists_its.begin(), posting_lists_its.end(),
-				[&curr_docid](const PostingListHelper& pl) {return pl.it->first == curr_docid;});
+		size_t scored = 0;
 
 		// Score current document
-		if(not conj or contains_all_terms)
+		for(auto& posting_helper : posting_lists_its)
 		{
-			for(auto& posting_helper : posting_lists_its)
-			{
-				const auto& [docid, freq] = *posting_helper.it;
-				if(docid != curr_docid)
-					continue;
+			const auto& [docid, freq] = *posting_helper.it;
+			if(docid != curr_docid)
+				continue;
 
-				score += posting_helper.pl.score(posting_helper.it, scorer);
-			}
+			score += posting_helper.pl.score(posting_helper.it, scorer);
+			scored += 1;
+		}
 
-			// Push computed result in the results, only if our score is greater than worst scoring doc in results
-			if(results.size() < top_k or score > results.top().score)
-			{
-				results.push({curr_docid, score});
+		if(stats)
+			stats->postings_scored += scored;
 
-				// If necessary pop-out the worst scoring element
-				if (results.size() > top_k)
-					results.pop();
-			}
+		// Push computed result in the results, only if our score is greater than worst scoring doc in results and
+		// than the other chunks' threshold
+		if((results.size() < top_k or score > results.top().score) and
+			(shared_threshold == nullptr or score > shared_threshold->get()))
+		{
+			// If necessary pop-out the worst scoring element
+			push_result(results, top_k, {curr_docid, score}, stats);
+
+			if(shared_threshold and results.size() == top_k)
+				shared_threshold->raise(results.top().score);
 		}
 
+		// Out of budget, the top-k found so far is returned
+		if(budget and budget->charge(scored))
+			break;
+
 		docid_t next_docid = DOCID_MAX;
 		// Move iterators to current docid or (the next closest one)
 		for(auto posting_helper_it = posting_lists_its.begin(); posting_helper_it != posting_lists_its.end(); )
@@ -165,13 +233,503 @@ std::vector<result_t> Index<LVT>::query(std::set<std::string> query, bool conj,
 }
 
 template<class LVT>
-Index<LVT>::PostingList::PostingList(Index const *index, const std::string& term, const LVT& lv):
-	index(index), lv(lv),
+template<class Scorer>
+std::vector<score_t> Index<LVT>::score_documents(std::set<std::string> query, const std::vector<docid_t>& docids)
+{
+	TRACE_SPAN("score documents", "query");
+	const Scorer scorer{};
+	std::vector<score_t> scores(docids.size(), 0);
+
+	// The terms are added in the same order as the DAAT does, so are the scores
+	auto [posting_lists_its, min_docid] = build_helpers(query, false);
+	for(auto& posting_helper : posting_lists_its)
+		for(size_t i = 0; i < docids.size(); ++i)
+		{
+			posting_helper.it.nextGEQ(docids[i]);
+			if(posting_helper.it == posting_helper.pl.end())
+				break;
+
+			if(posting_helper.it->first == docids[i])
+				scores[i] += posting_helper.pl.score(posting_helper.it, scorer);
+		}
+
+	return scores;
+}
+
+/**
+* Conjunctive DAAT. The posting lists are sorted by length and the shortest one proposes the candidates: every other
+* list is moved to the candidate with nextGEQ and, on the first miss, the candidate becomes the docid that list landed
+* on. Only the documents in the intersection are scored, so the cost depends on the rarest term.
+* If the pair cache is enabled, the intersection of two terms can be read from it; in that case it proposes the
+* candidates in place of the shortest list.
+* @param query The query to be processed.
+* @param top_k The number of top results to be returned.
+* @param shared_threshold If not null, the top-k threshold shared with the other index chunks solving this query.
+* @param stats If not null, the work done by the query is counted in it.
+* @param budget If not null, the query stops when it runs out and returns the top-k found so far.
+* @return A vector of results.
+*/
+template<class LVT>
+template<class Scorer>
+std::vector<docid_result_t> Index<LVT>::query_conjunctive(std::set<std::string> query, size_t top_k, SharedThreshold *shared_threshold,
+												   QueryStats *stats, QueryBudget *budget)
+{
+	TRACE_SPAN("daat-c", "query");
+	const Scorer scorer{};
+	pending_results_t results;
+
+	auto [posting_lists_its, min_docid] = build_helpers(query, true, stats);
+	if(posting_lists_its.empty())
+		return {};
+
+	// Shortest list first
+	posting_lists_its.sort([](const PostingListHelper& a, const PostingListHelper& b) {
+		return a.pl.get_lexicon_value().n_docs < b.pl.get_lexicon_value().n_docs;
+	});
+
+	// The lead proposes the candidates: the cached pair, if any, otherwise the shortest list
+	const auto pair = pair_cache ? take_pair(posting_lists_its, scorer, stats, budget) : nullptr;
+	size_t pair_pos = 0;
+	auto others_begin = pair ? posting_lists_its.begin() : std::next(posting_lists_its.begin());
+
+	const auto lead_end = [&] {return pair ? pair_pos == pair->size() : posting_lists_its.front().it == posting_lists_its.front().pl.end();};
+	const auto lead_docid = [&] {return pair ? pair->docids[pair_pos] : posting_lists_its.front().it->first;};
+	const auto lead_next = [&] {
+		if(pair)
+			++pair_pos;
+		else
+			++posting_lists_its.front().it;
+	};
+	const auto lead_next_geq = [&](docid_t docid) {
+		if(pair)
+			pair_pos = std::lower_bound(pair->docids.begin() + pair_pos, pair->docids.end(), docid) - pair->docids.begin();
+		else
+			posting_lists_its.front().it.nextGEQ(docid);
+	};
+
+	if(lead_end())
+		return {};
+
+	docid_t candidate = lead_docid();
+	while(true)
+	{
+		// Align the other lists to the candidate, stop at the first one that doesn't contain it
+		bool match = true;
+		for(auto p_it = others_begin; p_it != posting_lists_its.end(); ++p_it)
+		{
+			p_it->it.nextGEQ(candidate);
+
+			// A list is exhausted, there are no more documents in the intersection
+			if(p_it->it == p_it->pl.end())
+				return convert_results(results, top_k);
+
+			if(p_it->it->first != candidate)
+			{
+				candidate = p_it->it->first;
+				match = false;
+				break;
+			}
+		}
+
+		if(match)
+		{
+			score_t score = pair ? pair->scores[pair_pos] : 0;
+			for(auto& posting_helper : posting_lists_its)
+				score += posting_helper.pl.score(posting_helper.it, scorer);
+			if(stats)
+				stats->postings_scored += posting_lists_its.size();
+
+			if((results.size() < top_k or score > results.top().score) and
+			   (shared_threshold == nullptr or score > shared_threshold->get()))
+			{
+				push_result(results, top_k, {candidate, score}, stats);
+
+				if(shared_threshold and results.size() == top_k)
+					shared_threshold->raise(results.top().score);
+			}
+
+			lead_next();
+		}
+		else
+			lead_next_geq(candidate);
+
+		// Out of budget, the top-k found so far is returned. Misses are charged too, so that the deadline is checked
+		if(budget and budget->charge(match ? posting_lists_its.size() : 0))
+			break;
+
+		if(lead_end())
+			break;
+
+		candidate = lead_docid();
+	}
+
+	return convert_results(results, top_k);
+}
+
+template<class LVT>
+template<class Scorer>
+std::shared_ptr<const PairPostings> Index<LVT>::take_pair(std::list<PostingListHelper>& posting_lists_its, const Scorer& scorer,
+													   QueryStats *stats, QueryBudget *budget)
+{
+	if(posting_lists_its.size() < 2)
+		return nullptr;
+
+	// Any cached pair of the query will do, we take the smallest intersection
+	std::shared_ptr<const PairPostings> best;
+	auto best_a = posting_lists_its.end(), best_b = posting_lists_its.end();
+	for(auto a = posting_lists_its.begin(); a != posting_lists_its.end(); ++a)
+	{
+		for(auto b = std::next(a); b != posting_lists_its.end(); ++b)
+		{
+			// Only the misses of the two shortest lists' pair are counted, it's the one we'd materialize
+			const auto key = PairCache::make_key(a->term, b->term, Scorer::name);
+			auto postings = pair_cache->get(key, a == posting_lists_its.begin() and b == std::next(a));
+			if(postings and (not best or postings->size() < best->size()))
+				std::tie(best, best_a, best_b) = std::tuple(postings, a, b);
+		}
+	}
+
+	// Materialize the intersection of the two shortest lists, if they're requested often
+	if(not best)
+	{
+		best_a = posting_lists_its.begin();
+		best_b = std::next(best_a);
+		const auto key = PairCache::make_key(best_a->term, best_b->term, Scorer::name);
+		if(not pair_cache->admit(key))
+			return nullptr;
+
+		auto postings = std::make_shared<PairPostings>();
+		auto& a = *best_a;
+		auto& b = *best_b;
+		bool complete = true;
+		while(a.it != a.pl.end())
+		{
+			b.it.nextGEQ(a.it->first);
+			if(b.it == b.pl.end())
+				break;
+
+			const bool match = b.it->first == a.it->first;
+			if(match)
+			{
+				postings->docids.push_back(a.it->first);
+				postings->scores.push_back(a.pl.score(a.it, scorer) + b.pl.score(b.it, scorer));
+				if(stats)
+					stats->postings_scored += 2;
+				++a.it;
+			}
+			else
+				a.it.nextGEQ(b.it->first);
+
+			// Out of budget, the query goes on with the part of the intersection built so far
+			if(budget and budget->charge(match ? 2 : 0))
+			{
+				complete = false;
+				break;
+			}
+		}
+
+		// A partial intersection is only good for this query
+		if(complete)
+			pair_cache->put(key, postings);
+		best = std::move(postings);
+	}
+
+	posting_lists_its.erase(best_a);
+	posting_lists_its.erase(best_b);
+	return best;
+}
+
+template<class LVT>
+void Index<LVT>::load_impacts(impact_lexicon_t lx, const memory_area& ip)
+{
+	impact_lexicon.emplace(std::move(lx));
+
+	auto t = ip.get();
+	impact_postings = t.first;
+	impact_postings_length = t.second;
+}
+
+template<class LVT>
+void Index<LVT>::load_positions(positions_lexicon_t lx, const memory_area& pp)
+{
+	positions_lexicon.emplace(std::move(lx));
+	positions = pp.get().first;
+}
+
+template<class LVT>
+std::optional<PositionsCursor> Index<LVT>::get_positions(const std::string& term)
+{
+	if(not positions_lexicon)
+		return std::nullopt;
+
+	auto positions_it = positions_lexicon->find(term);
+	if(positions_it == positions_lexicon->end())
+		return std::nullopt;
+
+	const auto& plv = positions_it->second;
+	return PositionsCursor(positions + plv.start_pos, positions + plv.end_pos);
+}
+
+/**
+* DAAT with phrase and proximity operators. The required lists, sorted by length, are intersected as in the
+* conjunctive DAAT. Only when a document contains all of them, the positions of the operators' terms are decoded
+* and checked. The optional terms just add their score to the documents that pass.
+* @param query The query's terms, including the ones of the operators.
+* @param phrases The phrase and proximity operators.
+* @param conj If true, all the terms are required.
+* @param top_k The number of top results to be returned.
+* @param shared_threshold If not null, the top-k threshold shared with the other index chunks solving this query.
+* @param stats If not null, the work done by the query is counted in it.
+* @param budget If not null, the query stops when it runs out and returns the top-k found so far.
+* @return A vector of results.
+*/
+template<class LVT>
+template<class Scorer>
+std::vector<docid_result_t> Index<LVT>::query_phrase(std::set<std::string> query, const std::vector<phrase_t>& phrases,
+											   bool conj, size_t top_k, SharedThreshold *shared_threshold,
+											   QueryStats *stats, QueryBudget *budget)
+{
+	if(not positions_lexicon)
+		return {};
+
+	TRACE_SPAN("phrase", "query");
+	const Scorer scorer{};
+	pending_results_t results;
+
+	std::set<std::string_view> required;
+	for(const auto& phrase : phrases)
+		required.insert(phrase.terms.begin(), phrase.terms.end());
+
+	auto [posting_lists_its, min_docid] = build_helpers(query, conj, stats);
+
+	// Every operator's term must be in this chunk
+	const auto n_required = (size_t)std::count_if(posting_lists_its.begin(), posting_lists_its.end(),
+			[&](const PostingListHelper& h) {return conj or required.contains(h.term);});
+	if(n_required == 0 or (not conj and n_required != required.size()))
+		return {};
+
+	// Required lists first, the shortest one leads
+	posting_lists_its.sort([&](const PostingListHelper& a, const PostingListHelper& b) {
+		const bool a_req = conj or required.contains(a.term), b_req = conj or required.contains(b.term);
+		if(a_req != b_req)
+			return a_req;
+		return a.pl.get_lexicon_value().n_docs < b.pl.get_lexicon_value().n_docs;
+	});
+	const auto required_end = std::next(posting_lists_its.begin(), n_required);
+
+	// One positions' cursor for each operator's term
+	std::map<std::string_view, PositionsCursor> cursors;
+	for(const auto& term : required)
+	{
+		auto positions_it = positions_lexicon->find(std::string(term));
+		if(stats)
+			stats->lexicon_probes += 1;
+		if(positions_it == positions_lexicon->end())
+			return {};
+
+		const auto& plv = positions_it->second;
+		cursors.emplace(term, PositionsCursor(positions + plv.start_pos, positions + plv.end_pos));
+	}
+
+	std::vector<const std::vector<position_t>*> phrase_positions;
+	const auto phrases_match = [&](docid_t docid) {
+		return std::all_of(phrases.begin(), phrases.end(), [&](const phrase_t& phrase) {
+			phrase_positions.clear();
+			for(const auto& term : phrase.terms)
+				phrase_positions.push_back(&cursors.at(term).get(docid));
+
+			return phrase_match(phrase, phrase_positions);
+		});
+	};
+
+	auto& lead = posting_lists_its.front();
+	docid_t candidate = lead.it->first;
+
+	while(true)
+	{
+		// Align the other required lists to the candidate, stop at the first one that doesn't contain it
+		bool match = true;
+		for(auto p_it = std::next(posting_lists_its.begin()); p_it != required_end; ++p_it)
+		{
+			p_it->it.nextGEQ(candidate);
+
+			// A list is exhausted, there are no more documents in the intersection
+			if(p_it->it == p_it->pl.end())
+				return convert_results(results, top_k);
+
+			if(p_it->it->first != candidate)
+			{
+				candidate = p_it->it->first;
+				match = false;
+				break;
+			}
+		}
+
+		size_t scored = 0;
+		if(match and phrases_match(candidate))
+		{
+			score_t score = 0;
+			for(auto p_it = posting_lists_its.begin(); p_it != required_end; ++p_it)
+				score += p_it->pl.score(p_it->it, scorer);
+			scored = n_required;
+
+			// Optional terms
+			for(auto p_it = required_end; p_it != posting_lists_its.end(); ++p_it)
+			{
+				p_it->it.nextGEQ(candidate);
+				if(p_it->it != p_it->pl.end() and p_it->it->first == candidate)
+				{
+					score += p_it->pl.score(p_it->it, scorer);
+					scored += 1;
+				}
+			}
+
+			if(stats)
+				stats->postings_scored += scored;
+
+			if((results.size() < top_k or score > results.top().score) and
+			   (shared_threshold == nullptr or score > shared_threshold->get()))
+			{
+				push_result(results, top_k, {candidate, score}, stats);
+
+				if(shared_threshold and results.size() == top_k)
+					shared_threshold->raise(results.top().score);
+			}
+		}
+
+		if(match)
+			++lead.it;
+		else
+			lead.it.nextGEQ(candidate);
+
+		// Out of budget, the top-k found so far is returned
+		if(budget and budget->charge(scored))
+			break;
+
+		if(lead.it == lead.pl.end())
+			break;
+
+		candidate = lead.it->first;
+	}
+
+	return convert_results(results, top_k);
+}
+
+/**
+ * Score-at-a-time query processing over the impact-ordered posting lists. The segments of all query terms are
+ * processed in decreasing impact order, each posting adds its impact to the document's accumulator.
+ * Since the most important postings are processed first, the query can be stopped early once the budget is
+ * exhausted, and the results are still close to the exact ones.
+ * @param query The query to be processed.
+ * @param top_k The number of top results to be returned.
+ * @param budget If not null, the query stops when it runs out. Every posting is charged.
+ * @param stats If not null, the work done by the query is counted in it.
+ * @return A vector of results.
+ */
+template<class LVT>
+std::vector<docid_result_t> Index<LVT>::query_saat(std::set<std::string> query, size_t top_k, QueryBudget *budget,
+												   QueryStats *stats)
+{
+	if(not impact_lexicon)
+		return {};
+
+	TRACE_SPAN("saat", "query");
+
+	struct segment_cursor
+	{
+		impact_t impact;
+		const uint8_t *begin, *end;
+		QueryStats::term_t *stats;
+	};
+
+	// Gather the segments of all the query terms
+	std::vector<segment_cursor> segments;
+	for(const auto& term : query)
+	{
+		auto impact_info_it = impact_lexicon->find(term);
+		if(stats)
+			stats->lexicon_probes += 1;
+		if(impact_info_it == impact_lexicon->end())
+			continue;
+
+		auto *term_stats = stats ? &stats->terms[term] : nullptr;
+
+		const auto& ilv = impact_info_it->second;
+		for(size_t i = 0; i < ilv.segments.size(); ++i)
+		{
+			const size_t seg_end = i + 1 < ilv.segments.size() ? ilv.segments[i + 1].offset : ilv.end_pos - ilv.start_pos;
+			segments.push_back({
+				.impact = ilv.segments[i].impact,
+				.begin = impact_postings + ilv.start_pos + ilv.segments[i].offset,
+				.end = impact_postings + ilv.start_pos + seg_end,
+				.stats = term_stats
+			});
+		}
+	}
+
+	// Highest impacts first
+	std::stable_sort(segments.begin(), segments.end(),
+			[](const segment_cursor& a, const segment_cursor& b) {return a.impact > b.impact;});
+
+	// One table per thread, it is reused by all the queries
+	static thread_local ImpactAccumulators accumulators;
+	accumulators.reset(document_index_length);
+
+	size_t processed = 0;
+	for(const auto& segment : segments)
+	{
+		// Budget exhausted, return what we've got so far
+		if(budget and budget->is_exhausted())
+			break;
+
+		codes::VariableBlocksDecoder<const uint8_t*> docids(segment.begin, segment.end);
+
+		docid_t docid = 0;
+		const size_t segment_start = processed;
+		for(auto it = docids.begin(); it != docids.end(); ++it)
+		{
+			docid += *it;
+			accumulators.add(docid - base_docid, segment.impact);
+			++processed;
+
+			if(budget and budget->charge(1))
+				break;
+		}
+
+		if(segment.stats)
+			segment.stats->postings_decoded += processed - segment_start;
+	}
+
+	// Each posting adds its impact to an accumulator
+	if(stats)
+		stats->postings_scored += processed;
+
+	// Select the top-k accumulators
+	pending_results_t results;
+	accumulators.for_each([&](size_t doc, uint32_t acc) {
+		score_t score = quantizer.dequantize(acc);
+		if(results.size() < top_k or score > results.top().score)
+			push_result(results, top_k, {doc + base_docid, score}, stats);
+	});
+
+	return convert_results(results, top_k);
+}
+
+template<class LVT>
+Index<LVT>::PostingList::PostingList(Index const *index, const std::string& term, LVT lv_, QueryStats *query_stats):
+	index(index), lv(std::move(lv_)),
 	docid_dec(index->inverted_indices + lv.start_pos_docid, index->inverted_indices + lv.end_pos_docid),
-	freq_dec(index->inverted_indices_freqs + lv.start_pos_freq, index->inverted_indices_freqs + lv.end_pos_freq)
+	freq_dec(index->inverted_indices_freqs + lv.start_pos_freq, index->inverted_indices_freqs + lv.end_pos_freq),
+	impacts(index->inverted_indices_freqs + lv.start_pos_freq)
 {
 	// Retrive n_i from global lexicon
+	TRACE_SPAN("global lexicon lookup", "query");
 	auto global_term_info_it = index->global_lexicon.find(term);
+	if(query_stats)
+	{
+		query_stats->lexicon_probes += 1;
+		stats = &query_stats->terms[term];
+	}
 	if (global_term_info_it == index->global_lexicon.end()) // IMPOSSIBLE!
 			abort();
 
@@ -182,27 +740,38 @@ Index<LVT>::PostingList::PostingList(Index const *index, const std::string& term
 template<class LVT>
 typename Index<LVT>::PostingList::iterator Index<LVT>::PostingList::begin() const
 {
-	auto it = iterator{this, docid_dec.begin(), freq_dec.begin()};
-	it.current = {*it.docid_curr, *it.freq_curr};
+	auto it = iterator{this, docid_dec.begin(), freq_begin(), impacts};
+	it.parse();
 	return it;
 }
 
 template<class LVT>
 typename Index<LVT>::PostingList::iterator Index<LVT>::PostingList::end() const
 {
-	return {this, docid_dec.end(), freq_dec.end()};
+	return {this, docid_dec.end(), freq_dec.end(), impacts + lv.n_docs};
 }
 
 /**
  * This function is used to compute the score of a document.
- * The choice of the scorer changes the formula between TF-IDF and BM25.
+ * The choice of the scorer changes the formula between TF-IDF and BM25, the call is resolved at compile time.
+ * BM25 reads the document's precomputed norm if the scorer has the parameters it was computed with, otherwise it
+ * computes the norm from the document's length. Quantized indices store BM25 scores with the default parameters.
  * @param it The iterator of the document to be scored.
  * @param scorer The scorer to be used.
  * @return The score of the document.
  */
 template<class LVT>
-score_t Index<LVT>::PostingList::score(const Index::PostingList::iterator& it, const QueryScorer& scorer) const
+template<class Scorer>
+score_t Index<LVT>::PostingList::score(const Index::PostingList::iterator& it, const Scorer& scorer) const
 {
+	// Precomputed BM25 score, no need to look at the document's length
+	if(index->quantized)
+		return index->quantizer.dequantize(it.current.second);
+
+	if constexpr (Scorer::uses_doc_norm)
+		if(scorer.same_params(index->doc_norms_scorer))
+			return scorer.score(it.current.second, idf, index->doc_norms[it.current.first - index->base_docid]);
+
 	doclen_t dl = scorer.needs_doc_metadata() ? index->document_index[it.current.first - index->base_docid].lenght : 0;
 	return scorer.score(it.current.second, idf, dl, index->avgdl);
 }
@@ -210,10 +779,12 @@ score_t Index<LVT>::PostingList::score(const Index::PostingList::iterator& it, c
 template<class LVT>
 typename Index<LVT>::PostingList::offset Index<LVT>::PostingList::get_offset(const Index::PostingList::iterator& it)
 {
+	// A unary datum may span more bytes, its offset is the one of the byte where it starts. The decoders' begin() has
+	// already parsed the first datum, the tfs' stream starts at the list's start instead
 	return {
 		.docid_off = static_cast<uint64_t>(it.docid_curr.get_raw_iterator() - docid_dec.begin().get_raw_iterator()),
 		.freq_off = codes::serialize_bit_offset(
-				it.freq_curr.get_raw_iterator() - freq_dec.begin().get_raw_iterator(),
+				it.freq_curr.get_datum_raw_iterator() - (index->inverted_indices_freqs + lv.start_pos_freq),
 				it.freq_curr.get_bit_offset())
 	};
 }
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "types.hpp"
+
+namespace sindex
+{
+
+/**
+ * Uniform quantizer that maps a score in [0, upper_bound] to an impact_t.
+ * All shards share the same upper bound (it is stored in the collection's metadata), thus impacts coming from
+ * different shards can be summed and compared.
+ */
+class ImpactQuantizer
+{
+	score_t upper_bound;
+	score_t scale;
+
+public:
+	static constexpr unsigned levels = std::numeric_limits<impact_t>::max();
+
+	explicit ImpactQuantizer(score_t upper_bound = 1.0):
+		upper_bound(upper_bound), scale(upper_bound / levels) {}
+
+	/**
+	 * A positive score is never quantized to 0, otherwise its posting would be lost
+	 * @param score a score in [0, upper_bound]
+	 * @return the impact
+	 */
+	impact_t quantize(score_t score) const
+	{
+		if(score <= 0)
+			return 0;
+
+		auto q = std::lround(score / scale);
+		return static_cast<impact_t>(std::clamp<long>(q, 1, levels));
+	}
+
+	/** Converts a (sum of) impact(s) back to a score */
+	score_t dequantize(uint64_t impact) const {return impact * scale;}
+
+	score_t get_upper_bound() const {return upper_bound;}
+};
+
+/**
+ * Accumulators' table for score-at-a-time query processing, one accumulator per document of the shard.
+ * The table is split in pages, a page is zeroed the first time one of its accumulators is touched, so that we
+ * don't have to clear the whole table between two queries.
+ */
+class ImpactAccumulators
+{
+	static constexpr unsigned PAGE_BITS = 10;
+
+	std::vector<uint32_t> accumulators;
+	std::vector<uint8_t> dirty;
+	std::vector<size_t> dirty_pages;
+
+public:
+	/** Prepares the table for a new query over n_docs documents */
+	void reset(size_t n_docs)
+	{
+		for(auto page : dirty_pages)
+			dirty[page] = 0;
+		dirty_pages.clear();
+
+		if(accumulators.size() < n_docs)
+		{
+			accumulators.resize(n_docs);
+			dirty.resize((n_docs >> PAGE_BITS) + 1, 0);
+		}
+	}
+
+	void add(size_t doc, uint32_t impact)
+	{
+		const size_t page = doc >> PAGE_BITS;
+		if(not dirty[page])
+		{
+			dirty[page] = 1;
+			dirty_pages.push_back(page);
+
+			const size_t page_start = page << PAGE_BITS;
+			const size_t page_len = std::min<size_t>(1ul << PAGE_BITS, accumulators.size() - page_start);
+			std::memset(accumulators.data() + page_start, 0, page_len * sizeof(uint32_t));
+		}
+
+		accumulators[doc] += impact;
+	}
+
+	/** Calls f(doc, accumulator) for each non-zero accumulator */
+	template<class F>
+	void for_each(F f) const
+	{
+		for(auto page : dirty_pages)
+		{
+			const size_t page_start = page << PAGE_BITS;
+			const size_t page_end = std::min<size_t>(page_start + (1ul << PAGE_BITS), accumulators.size());
+			for(size_t doc = page_start; doc < page_end; ++doc)
+				if(accumulators[doc])
+					f(doc, accumulators[doc]);
+		}
+	}
+};
+
+}
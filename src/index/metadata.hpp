@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include "types.hpp"
+#include "query_scorer.hpp"
+#include "../util/memory.hpp"
+
+namespace sindex
+{
+
+/**
+ * Collection-wide statistics shared by all the shards, they're stored in the `metadata` file.
+ * The file is a sequence of raw fields; fields were appended over time, older files simply lack the last ones.
+ */
+struct CollectionMetadata
+{
+	doclen_t doc_len_sum = 0;
+	size_t n_docs = 0;
+	// Upper bound of the impacts' quantizer
+	score_t impact_upper_bound = 0;
+	// If true, the sigma lexica point to quantized BM25 impacts instead of term frequencies
+	bool quantized = false;
+
+	static CollectionMetadata read(const memory_area& metadata)
+	{
+		CollectionMetadata m;
+		auto [buff, size] = metadata.get();
+		size_t off = 0;
+
+		auto read_field = [&](auto& field) {
+			if(off + sizeof(field) > size)
+				return false;
+
+			std::memcpy(&field, buff + off, sizeof(field));
+			off += sizeof(field);
+			return true;
+		};
+
+		read_field(m.doc_len_sum);
+		read_field(m.n_docs);
+
+		// The builder uses this very bound, BM25 scores never exceed the idf of a term that appears in one document
+		if(not read_field(m.impact_upper_bound))
+			m.impact_upper_bound = QueryTFIDFScorer::idf(m.n_docs, 1);
+
+		read_field(m.quantized);
+		return m;
+	}
+
+	void write(std::ostream& out) const
+	{
+		out.write((char*)&doc_len_sum, sizeof(doc_len_sum));
+		out.write((char*)&n_docs, sizeof(n_docs));
+		out.write((char*)&impact_upper_bound, sizeof(impact_upper_bound));
+		out.write((char*)&quantized, sizeof(quantized));
+	}
+};
+
+}
@@ -0,0 +1,85 @@
+#include "pair_cache.hpp"
+
+namespace sindex
+{
+
+PairCache::PairCache(size_t max_bytes, unsigned admission): max_bytes(max_bytes), admission(admission)
+{
+}
+
+std::string PairCache::make_key(std::string_view a, std::string_view b, std::string_view scorer)
+{
+	if(b < a)
+		std::swap(a, b);
+
+	// Terms never contain spaces
+	std::string key(scorer);
+	key.append(" ").append(a).append(" ").append(b);
+	return key;
+}
+
+std::shared_ptr<const PairPostings> PairCache::get(const std::string& key, bool count_miss)
+{
+	std::lock_guard lock(mutex);
+
+	auto entry_it = entries.find(key);
+	if(entry_it == entries.end())
+	{
+		if(not count_miss)
+			return nullptr;
+
+		if(misses.size() >= MAX_TRACKED_PAIRS)
+			misses.clear();
+
+		++misses[key];
+		return nullptr;
+	}
+
+	// Move it in front
+	lru.splice(lru.begin(), lru, entry_it->second);
+	return entry_it->second->postings;
+}
+
+bool PairCache::admit(const std::string& key)
+{
+	std::lock_guard lock(mutex);
+
+	auto miss_it = misses.find(key);
+	return miss_it != misses.end() and miss_it->second >= admission;
+}
+
+void PairCache::put(const std::string& key, std::shared_ptr<const PairPostings> postings)
+{
+	const size_t size = entry_size(key, *postings);
+	if(size > max_bytes)
+		return;
+
+	std::lock_guard lock(mutex);
+
+	// Someone else got here first
+	if(entries.contains(key))
+		return;
+
+	// Make room, evicting from the back
+	while(used_bytes + size > max_bytes)
+	{
+		const auto& old = lru.back();
+		used_bytes -= entry_size(old.key, *old.postings);
+		entries.erase(old.key);
+		lru.pop_back();
+	}
+
+	// The map's key is a view of the string stored in the list
+	lru.push_front({key, std::move(postings)});
+	entries.emplace(lru.front().key, lru.begin());
+	misses.erase(key);
+	used_bytes += size;
+}
+
+size_t PairCache::entry_size(const std::string& key, const PairPostings& postings)
+{
+	return sizeof(entry_t) + sizeof(PairPostings) + 4 * sizeof(void*) + key.size() +
+		postings.size() * (sizeof(docid_t) + sizeof(score_t));
+}
+
+}
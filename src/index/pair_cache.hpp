@@ -0,0 +1,77 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "types.hpp"
+
+namespace sindex
+{
+
+/**
+ * Materialized intersection of two posting lists, with the sum of the two terms' scores of each document
+ */
+struct PairPostings
+{
+	std::vector<docid_t> docids;
+	std::vector<score_t> scores;
+
+	size_t size() const {return docids.size();}
+};
+
+/**
+ * Thread-safe LRU cache of the intersections of frequent term pairs, bounded by memory.
+ * A pair is admitted only after it has been requested `admission` times, so that the intersections of rare pairs,
+ * which are expensive to materialize, don't flush the useful ones.
+ */
+class PairCache
+{
+	struct entry_t
+	{
+		std::string key;
+		std::shared_ptr<const PairPostings> postings;
+	};
+
+	std::mutex mutex;
+	// Most recently used first
+	std::list<entry_t> lru;
+	std::unordered_map<std::string_view, std::list<entry_t>::iterator> entries;
+	size_t max_bytes;
+	size_t used_bytes = 0;
+
+	// How many times the pairs not in cache have been requested. Cleared when it grows too much, thus it only
+	// remembers the recent history
+	std::unordered_map<std::string, unsigned> misses;
+	unsigned admission;
+	static constexpr size_t MAX_TRACKED_PAIRS = 1 << 16;
+
+public:
+	/**
+	 * @param max_bytes memory limit of the cache, an estimate of the intersections' footprint
+	 * @param admission number of requests needed by a pair to be cached
+	 */
+	explicit PairCache(size_t max_bytes, unsigned admission = 2);
+
+	/** The key of the pair (a, b) for the given scorer, it doesn't depend on the order of the terms */
+	static std::string make_key(std::string_view a, std::string_view b, std::string_view scorer);
+
+	/**
+	 * @param key the pair's key
+	 * @param count_miss if true and the pair is not in cache, count it as a request of the pair
+	 * @return the cached intersection, if any
+	 */
+	std::shared_ptr<const PairPostings> get(const std::string& key, bool count_miss = true);
+
+	/** True if the pair has been requested enough times to be materialized */
+	bool admit(const std::string& key);
+
+	void put(const std::string& key, std::shared_ptr<const PairPostings> postings);
+
+	static size_t entry_size(const std::string& key, const PairPostings& postings);
+};
+
+}
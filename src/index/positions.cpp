@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include "positions.hpp"
+#include "../codes/variable_blocks.hpp"
+
+namespace sindex
+{
+
+void PositionsWriter::add(docid_t docid, const std::vector<position_t>& positions)
+{
+	if(n_entries++ % POSITIONS_SAMPLE_INTERVAL == 0)
+		samples.push_back({docid, entries.size()});
+
+	std::vector<uint8_t> gaps;
+	position_t prev = 0;
+	for(auto position : positions)
+	{
+		auto gap = codes::VariableBytes(position - prev);
+		gaps.insert(gaps.end(), gap.bytes, gap.bytes + gap.used_bytes);
+		prev = position;
+	}
+
+	for(auto datum : {codes::VariableBytes(docid), codes::VariableBytes(gaps.size())})
+		entries.insert(entries.end(), datum.bytes, datum.bytes + datum.used_bytes);
+	entries.insert(entries.end(), gaps.begin(), gaps.end());
+}
+
+size_t PositionsWriter::write(std::ostream& teletype) const
+{
+	// Align, so that the samples can be read in place
+	while(teletype.tellp() % sizeof(uint64_t))
+		teletype.put(0);
+
+	const size_t start = teletype.tellp();
+	const uint64_t n_samples = samples.size();
+	teletype.write((const char*)&n_samples, sizeof(n_samples));
+	teletype.write((const char*)samples.data(), samples.size() * sizeof(PositionsSample));
+	teletype.write((const char*)entries.data(), entries.size());
+
+	return start;
+}
+
+PositionsCursor::PositionsCursor(const uint8_t *begin, const uint8_t *end): end(end)
+{
+	n_samples = *(const uint64_t*)begin;
+	samples = (const PositionsSample*)(begin + sizeof(uint64_t));
+	entries = curr = (const uint8_t*)(samples + n_samples);
+}
+
+const std::vector<position_t>& PositionsCursor::get(docid_t docid)
+{
+	if(docid == decoded_docid)
+		return positions;
+
+	positions.clear();
+
+	// Jump to the last sample before the docid, if it's ahead of us
+	auto sample = std::upper_bound(samples, samples + n_samples, docid,
+			[](docid_t d, const PositionsSample& s) {return d < s.docid;});
+	if(sample != samples and entries + (sample - 1)->offset > curr)
+		curr = entries + (sample - 1)->offset;
+
+	// Hop over the entries 'til the docid
+	while(curr < end)
+	{
+		const auto [entry_docid, docid_len] = codes::VariableBytes::parse(curr);
+		const auto [length, length_len] = codes::VariableBytes::parse(curr + docid_len);
+		const uint8_t *gaps = curr + docid_len + length_len;
+
+		if(entry_docid > docid)
+			break;
+
+		if(entry_docid < docid)
+		{
+			curr = gaps + length;
+			continue;
+		}
+
+		// Found, decode it
+		position_t position = 0;
+		codes::VariableBlocksDecoder<const uint8_t*> decoder(gaps, gaps + length);
+		for(auto it = decoder.begin(); it != decoder.end(); ++it)
+			positions.push_back(position += *it);
+
+		decoded_docid = docid;
+		break;
+	}
+
+	return positions;
+}
+
+/**
+ * Size of the smallest window that contains one position of each list, or UINT32_MAX if there's none. A list given
+ * more than once, a repeated term, needs as many distinct positions in the window
+ */
+static position_t min_window(const std::vector<const std::vector<position_t>*>& positions)
+{
+	// The distinct lists, and how many positions of each the window needs
+	std::vector<const std::vector<position_t>*> lists;
+	std::vector<size_t> needed;
+	for(const auto *list : positions)
+	{
+		const auto it = std::find(lists.begin(), lists.end(), list);
+		if(it == lists.end())
+		{
+			lists.push_back(list);
+			needed.push_back(1);
+		}
+		else
+			++needed[it - lists.begin()];
+	}
+
+	// All the positions, in order, with their list
+	std::vector<std::pair<position_t, size_t>> merged;
+	for(size_t i = 0; i < lists.size(); ++i)
+		for(const position_t p : *lists[i])
+			merged.emplace_back(p, i);
+	std::sort(merged.begin(), merged.end());
+
+	// Slide the window: grow it until it has all the positions needed, then shrink it from the left
+	std::vector<size_t> in_window(lists.size(), 0);
+	size_t satisfied = 0;
+	position_t best = UINT32_MAX;
+	for(size_t left = 0, right = 0; right < merged.size(); ++right)
+	{
+		const size_t r = merged[right].second;
+		if(++in_window[r] == needed[r])
+			++satisfied;
+
+		for(; satisfied == lists.size(); ++left)
+		{
+			best = std::min(best, merged[right].first - merged[left].first + 1);
+			const size_t l = merged[left].second;
+			if(in_window[l]-- == needed[l])
+				--satisfied;
+		}
+	}
+
+	return best;
+}
+
+bool phrase_match(const phrase_t& phrase, const std::vector<const std::vector<position_t>*>& positions)
+{
+	if(positions.empty())
+		return true;
+
+	if(phrase.proximity)
+		return min_window(positions) <= positions.size() + phrase.slop;
+
+	// Each position of the first term can start the phrase
+	for(const position_t start : *positions.front())
+	{
+		bool match = true;
+		for(size_t i = 1; i < positions.size() and match; ++i)
+			match = std::binary_search(positions[i]->begin(), positions[i]->end(), start + i);
+
+		if(match)
+			return true;
+	}
+
+	return false;
+}
+
+}
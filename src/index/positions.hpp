@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.hpp"
+
+namespace sindex
+{
+
+typedef uint32_t position_t;
+
+/**
+ * Entry of the positions' lexicon, the byte range of a term's positions in the posting_lists_positions file
+ */
+struct PositionsLexiconValue
+{
+	size_t start_pos;
+	size_t end_pos;
+
+	static constexpr size_t serialize_size = 2;
+
+	std::array<uint64_t, serialize_size> serialize() const {return {start_pos, end_pos};}
+	static PositionsLexiconValue deserialize(const std::array<uint64_t, serialize_size>& ser) {return {ser[0], ser[1]};}
+};
+
+/**
+ * A phrase, or proximity, operator of a query.
+ * An exact phrase matches the documents where its terms appear consecutively and in order. A proximity operator
+ * matches the documents where all its terms appear, in any order, within a window of terms.size() + slop positions.
+ */
+struct phrase_t
+{
+	std::vector<std::string> terms;
+	bool proximity = false;
+	unsigned slop = 0;
+};
+
+/**
+ * The positions of a term are written 8-byte aligned as
+ *   [uint64 n_samples][n_samples * sample_t][entries]
+ * one entry per posting, in increasing docid order:
+ *   [VByte docid][VByte length in bytes of the positions][VByte positions' gaps]
+ * Every SAMPLE_INTERVAL-th entry is sampled, so that a cursor can jump close to a docid without reading the entries
+ * in between.
+ */
+struct PositionsSample
+{
+	docid_t docid;
+	uint64_t offset; // Of the entry, from the beginning of the entries
+};
+
+constexpr size_t POSITIONS_SAMPLE_INTERVAL = 64;
+
+/**
+ * Builds the positions of a posting list, in the format read by PositionsCursor
+ */
+class PositionsWriter
+{
+	std::vector<PositionsSample> samples;
+	std::vector<uint8_t> entries;
+	size_t n_entries = 0;
+
+public:
+	void add(docid_t docid, const std::vector<position_t>& positions);
+
+	/** Writes the posting list's positions, padded to 8 bytes. Returns the start of the written data */
+	size_t write(std::ostream& teletype) const;
+};
+
+/**
+ * Reads the positions of a term, for docids in non-decreasing order
+ */
+class PositionsCursor
+{
+	const PositionsSample *samples;
+	size_t n_samples;
+	const uint8_t *entries;
+	const uint8_t *end;
+	const uint8_t *curr;
+
+	docid_t decoded_docid = DOCID_MAX;
+	std::vector<position_t> positions;
+
+public:
+	PositionsCursor(const uint8_t *begin, const uint8_t *end);
+
+	/** The positions of the term in the document, empty if it doesn't appear there */
+	const std::vector<position_t>& get(docid_t docid);
+};
+
+/**
+ * @param positions the positions of the phrase's terms, in the phrase's order
+ * @return true if the positions satisfy the phrase
+ */
+bool phrase_match(const phrase_t& phrase, const std::vector<const std::vector<position_t>*>& positions);
+
+}
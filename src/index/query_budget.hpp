@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace sindex
+{
+
+/**
+ * Caps the work of a query on an index chunk: a deadline and a number of postings to score. The query processing
+ * loops charge it once per document they evaluate, when it runs out they stop and return the top-k found so far,
+ * which is then approximate. The clock is only read every CLOCK_INTERVAL charges, so checking it is cheap.
+ */
+class QueryBudget
+{
+public:
+	using clock = std::chrono::steady_clock;
+	static constexpr unsigned CLOCK_INTERVAL = 256;
+
+private:
+	clock::time_point deadline;
+	size_t max_postings;
+
+	size_t postings = 0;
+	unsigned charges = 0;
+	bool exhausted = false;
+
+public:
+	/**
+	 * @param deadline when the query must stop, clock::time_point::max() for no deadline
+	 * @param max_postings how many postings the query may score, 0 for no limit
+	 */
+	explicit QueryBudget(clock::time_point deadline = clock::time_point::max(), size_t max_postings = 0):
+			deadline(deadline), max_postings(max_postings) {}
+
+	/** Charges the postings scored for a document, returns true if the query must stop */
+	bool charge(size_t scored)
+	{
+		postings += scored;
+		if(max_postings and postings >= max_postings)
+			exhausted = true;
+		else if(++charges % CLOCK_INTERVAL == 0 and deadline != clock::time_point::max() and clock::now() >= deadline)
+			exhausted = true;
+
+		return exhausted;
+	}
+
+	/** If the query was stopped by the budget, its results are approximate */
+	bool is_exhausted() const {return exhausted;}
+	size_t get_postings() const {return postings;}
+};
+
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <string_view>
 #include "types.hpp"
 
 namespace sindex
@@ -10,6 +11,9 @@ public:
 	// - '= default;' specifies that the default implementation of the destructor is used.
 	virtual ~QueryScorer() = default; // destructor
 
+	// If true, the scorer can use the index's precomputed per-document norms in place of the documents' lengths
+	static constexpr bool uses_doc_norm = false;
+
 	virtual score_t score(freq_t tf_term_doc, score_t idf, doclen_t dl, double avgdl) const = 0;
 	virtual bool needs_doc_metadata() const {return false;}
 	virtual score_t get_sigma(const SigmaLexiconValue& lv) const = 0;
@@ -31,9 +35,12 @@ public:
  * and sigma value retrieval based on specific parameters.
  *
  */
-class QueryTFIDFScorer: public QueryScorer
+class QueryTFIDFScorer final: public QueryScorer
 {
 public:
+	// Identifies the scorer in caches' keys
+	static constexpr std::string_view name = "tfidf";
+
 	score_t score(freq_t tf_term_doc, score_t idf, doclen_t dl, double avgdl) const override;
 	static score_t idf(size_t n_docs, freq_t df_term);
 	score_t get_sigma(const SigmaLexiconValue& lv) const override;
@@ -54,16 +61,25 @@ public:
  * The 'score' function computes and returns the score based on specified input parameters.
  * The 'needs_doc_metadata' function indicates whether document metadata is required for the scorer.
  * The 'get_sigma' functions override methods from the base class to calculate and return sigma values.
+ * The 'doc_norm' function computes the length normalization of a document, k1*((1-b)+b*dl/avgdl), the index
+ * precomputes it for all its documents so that the 'score' overload that takes it only has to do one division.
+ * The 'same_params' function tells whether two scorers have the same k1 and b, i.e. the same norms.
  *
  */
-class QueryBM25Scorer: public QueryScorer
+class QueryBM25Scorer final: public QueryScorer
 {
 	double k1;
 	double b;
 
 public:
+	static constexpr bool uses_doc_norm = true;
+	static constexpr std::string_view name = "bm25";
+
 	explicit QueryBM25Scorer(double k1 = 0.82, double b = 0.68);
 	score_t score(freq_t tf_term_doc, score_t idf, doclen_t dl, double avgdl) const override;
+	score_t score(freq_t tf_term_doc, score_t idf, float doc_norm) const {return (tf_term_doc / (doc_norm + tf_term_doc)) * idf;}
+	float doc_norm(doclen_t dl, double avgdl) const {return k1*((1-b) + b*dl/avgdl);}
+	bool same_params(const QueryBM25Scorer& o) const {return k1 == o.k1 and b == o.b;}
 	bool needs_doc_metadata() const override {return true;}
 	score_t get_sigma(const SigmaLexiconValue& lv) const override;
 	score_t get_sigma(const SigmaLexiconValue::skip_pointer_t& skip_ptr) const override;
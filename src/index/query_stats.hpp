@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace sindex
+{
+
+/**
+ * What a query cost to an index: the counters are collected only if the query processing algorithms are given a
+ * QueryStats, otherwise they're skipped. The ones of a query's chunks add up.
+ */
+struct QueryStats
+{
+	struct term_t
+	{
+		// Postings read from the docids' stream
+		uint64_t postings_decoded = 0;
+		// Skip blocks left behind by skip_block() and seek_block(), their remaining postings are never decoded
+		uint64_t blocks_skipped = 0;
+	};
+
+	// Keyed by term, the nodes are stable: the posting lists' iterators count on them
+	std::map<std::string, term_t, std::less<>> terms;
+
+	// Lookups in the local, global, positions' and impact lexica
+	uint64_t lexicon_probes = 0;
+	uint64_t postings_scored = 0;
+	// Documents pushed in the top-k heap, and the ones popped out of it to make room
+	uint64_t heap_pushes = 0;
+	uint64_t heap_evictions = 0;
+	// Lists moved from the essential to the non-essential set by BMM
+	uint64_t pivot_moves = 0;
+
+	QueryStats& operator+=(const QueryStats& b)
+	{
+		for(const auto& [term, stats] : b.terms)
+		{
+			auto& t = terms[term];
+			t.postings_decoded += stats.postings_decoded;
+			t.blocks_skipped += stats.blocks_skipped;
+		}
+
+		lexicon_probes += b.lexicon_probes;
+		postings_scored += b.postings_scored;
+		heap_pushes += b.heap_pushes;
+		heap_evictions += b.heap_evictions;
+		pivot_moves += b.pivot_moves;
+		return *this;
+	}
+};
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include "types.hpp"
+
+namespace sindex
+{
+
+/**
+ * Top-k threshold shared by all the index chunks that are solving the same query.
+ * Every chunk publishes the k-th best score it found so far, so the shared value is the largest of them: a document
+ * whose score doesn't exceed it cannot make it into the final top-k, thus every chunk can use it to prune.
+ * It only grows and it's lock-free.
+ */
+class SharedThreshold
+{
+	std::atomic<score_t> θ;
+	static_assert(std::atomic<score_t>::is_always_lock_free);
+
+public:
+	explicit SharedThreshold(score_t initial = 0): θ(initial) {}
+
+	score_t get() const {return θ.load(std::memory_order_relaxed);}
+
+	/** Atomically sets the threshold to max(current, candidate) */
+	void raise(score_t candidate)
+	{
+		score_t current = get();
+		while(candidate > current and not θ.compare_exchange_weak(current, candidate, std::memory_order_relaxed))
+			continue;
+	}
+};
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "types.hpp"
+
+namespace sindex
+{
+
+/**
+ * Whether the top-k documents of a tier 0, a pruned index, are the ones of the full index.
+ * On the full index, a document out of the tier 0's top-k scores at most the (k+1)-th tier 0 score, or the threshold
+ * if the tier 0 didn't return it, on its kept postings plus the query terms' bounds on its dropped ones. A document in
+ * the top-k scores at least its tier 0 score. Their scores are the ones of their kept postings only, they must be
+ * computed again on the full index.
+ * @param results the tier 0's best k + 1 results, best first
+ * @param pruned_bound the sum of the query terms' highest scores among their dropped postings
+ * @param min_score only the documents scoring more than this were returned
+ */
+template<class Result>
+bool tier0_top_k_is_exact(const std::vector<Result>& results, size_t k, score_t pruned_bound, score_t min_score = 0)
+{
+	const score_t kth_score = k > 0 and results.size() >= k ? results[k - 1].score : 0;
+	const score_t next_score = results.size() > k ? results[k].score : 0;
+
+	return std::max(next_score, min_score) + pruned_bound <= std::max(kth_score, min_score);
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <queue>
+#include <vector>
+#include "types.hpp"
+
+namespace sindex
+{
+
+/**
+ * A result of the merged top-k, the index chunk it comes from resolves its docno
+ */
+struct shard_result_t
+{
+	score_t score;
+	size_t shard;
+	docid_t docid;
+};
+
+/**
+ * Merges the results of the index chunks, each one sorted best first, into the best k of them. A heap holds the next
+ * result of each chunk, so the merge costs O(k log(chunks)) instead of sorting all the chunks' results. Ties go to
+ * the lowest chunk.
+ */
+inline std::vector<shard_result_t> merge_top_k(const std::vector<std::vector<docid_result_t>>& shard_results, size_t k)
+{
+	struct cursor
+	{
+		score_t score;
+		size_t shard;
+		size_t pos;
+	};
+
+	// Max heap on the score
+	const auto worse = [](const cursor& a, const cursor& b) {
+		return a.score < b.score or (a.score == b.score and a.shard > b.shard);
+	};
+
+	std::vector<cursor> heads;
+	heads.reserve(shard_results.size());
+	for(size_t shard = 0; shard < shard_results.size(); ++shard)
+		if(not shard_results[shard].empty())
+			heads.push_back({shard_results[shard].front().score, shard, 0});
+
+	std::priority_queue<cursor, std::vector<cursor>, decltype(worse)> heap(worse, std::move(heads));
+
+	std::vector<shard_result_t> merged;
+	merged.reserve(k);
+	while(merged.size() < k and not heap.empty())
+	{
+		auto head = heap.top();
+		heap.pop();
+
+		const auto& results = shard_results[head.shard];
+		merged.push_back({results[head.pos].score, head.shard, results[head.pos].docid});
+
+		if(++head.pos < results.size())
+		{
+			head.score = results[head.pos].score;
+			heap.push(head);
+		}
+	}
+
+	return merged;
+}
+
+}
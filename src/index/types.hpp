@@ -5,6 +5,7 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cmath>
 #include <map>
 #include <array>
 #include <vector>
@@ -17,6 +18,7 @@ typedef std::string docno_t;
 typedef uint64_t doclen_t;
 typedef size_t freq_t;
 typedef double score_t;
+typedef uint8_t impact_t;
 
 // Maximum value of docid_t, representing the maximum possible document identifier
 constexpr docid_t DOCID_MAX = std::numeric_limits<docid_t>::max();
@@ -37,6 +39,18 @@ struct result_t
 	bool operator==(const result_t &b) const {return score == b.score;}
 };
 
+/*
+	A result of an index chunk, still identified by its docid: docids are global, so the results of all the chunks can
+	be merged before resolving the docnos. Only the ones of the final top-k are resolved, see Index::get_docno.
+*/
+struct docid_result_t
+{
+	docid_t docid;
+	score_t score;
+
+	bool operator>(const docid_result_t &b) const {return score > b.score;}
+};
+
 struct DocumentInfoSerialized
 {
 	size_t docno_offset;
@@ -103,6 +117,7 @@ struct SigmaLexiconValue : public LexiconValue
 
          - The first part of the struct is serialized as before using LexiconValue::serialize().
          - Global sigmas (bm25_sigma and tfidf_sigma) are converted to fixed-point integers and added to 'ser'.
+           They are rounded up, so that they stay upper bounds.
          - For each skip pointer in 'skip_pointers', its respective data is serialized:
          - 'bm25_ub' and 'tfidf_ub' are converted to fixed-point integers and added to 'ser'.
 	     - 'last_docid', 'docid_offset', and 'freq_offset' are added to 'ser'.
@@ -117,14 +132,14 @@ struct SigmaLexiconValue : public LexiconValue
 		ser.insert(ser.end(), ser_base.begin(), ser_base.end());
 		
 		// Global sigmas
-		ser.push_back(static_cast<uint64_t>(bm25_sigma * fixed_point_factor));
-		ser.push_back(static_cast<uint64_t>(tfidf_sigma * fixed_point_factor));
+		ser.push_back(static_cast<uint64_t>(std::ceil(bm25_sigma * fixed_point_factor)));
+		ser.push_back(static_cast<uint64_t>(std::ceil(tfidf_sigma * fixed_point_factor)));
 
 		// Add sigma values 'n skip list
 		for (const auto& sp : skip_pointers)
 			ser.insert(ser.end(), {
-				static_cast<uint64_t>(sp.bm25_ub * fixed_point_factor),
-				static_cast<uint64_t>(sp.tfidf_ub * fixed_point_factor),
+				static_cast<uint64_t>(std::ceil(sp.bm25_ub * fixed_point_factor)),
+				static_cast<uint64_t>(std::ceil(sp.tfidf_ub * fixed_point_factor)),
 				sp.last_docid,
 				sp.docid_offset,
 				sp.freq_offset
@@ -168,4 +183,59 @@ struct SigmaLexiconValue : public LexiconValue
 	}
 };
 
+/*
+	ImpactLexiconValue describes the impact-ordered copy of a term's posting list:
+	- 'start_pos' and 'end_pos' delimit the term's postings in the impact-ordered file.
+	- 'segments' lists the postings grouped by quantized score, in decreasing impact order. Each segment stores its
+	  impact, how many postings it holds and the offset (relative to 'start_pos') of its first docid.
+
+	Inside a segment docids are increasing and gap-encoded with Variable Bytes, so that a segment can be decoded
+	without touching the others.
+*/
+struct ImpactLexiconValue
+{
+	size_t start_pos = 0;
+	size_t end_pos = 0;
+
+	struct segment_t
+	{
+		impact_t impact;
+		size_t n_postings;
+		size_t offset;
+	};
+	using segments_t = std::vector<segment_t>;
+	segments_t segments;
+
+	static constexpr size_t serialize_size = 0;
+
+	std::vector<uint64_t> serialize() const
+	{
+		std::vector<uint64_t> ser;
+		ser.reserve(2 + segments.size() * 3);
+		ser.insert(ser.end(), {start_pos, end_pos});
+
+		for(const auto& seg : segments)
+			ser.insert(ser.end(), {seg.impact, seg.n_postings, seg.offset});
+
+		return ser;
+	}
+
+	static ImpactLexiconValue deserialize(const std::vector<uint64_t>& ser)
+	{
+		ImpactLexiconValue ilv;
+		ilv.start_pos = ser[0];
+		ilv.end_pos = ser[1];
+
+		assert((ser.size() - 2) % 3 == 0);
+		for(size_t i = 2; i < ser.size(); i += 3)
+			ilv.segments.push_back({
+				.impact = static_cast<impact_t>(ser[i]),
+				.n_postings = ser[i + 1],
+				.offset = ser[i + 2]
+			});
+
+		return ilv;
+	}
+};
+
 }
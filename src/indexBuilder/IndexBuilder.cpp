@@ -1,6 +1,7 @@
 #include <iostream>
 #include <vector>
 #include "IndexBuilder.hpp"
+#include "../util/trace.hpp"
 
 namespace sindex
 {
@@ -21,6 +22,7 @@ NB: This function is responsible for persisting the index data onto disk in comp
 
 void IndexBuilder::write_to_disk(std::ostream& docid_teletype, std::ostream& freq_teletype, std::ostream& lexicon_teletype, std::ostream& document_index_teletype)
 {
+	TRACE_SPAN("write to disk", "build");
 	std::vector<struct LexiconValue> lexicon_vector;
 	lexicon_vector.reserve(inverted_index.size());
 
@@ -111,5 +113,22 @@ void IndexBuilder::write_to_disk(std::ostream& docid_teletype, std::ostream& fre
 		
 }
 
+void IndexBuilder::write_positions_to_disk(std::ostream& positions_teletype, std::ostream& lexicon_teletype)
+{
+	codes::disk_map_writer<PositionsLexiconValue> builder(lexicon_teletype);
+
+	for(const auto& [term, posting_list] : inverted_index)
+	{
+		if(not posting_list.positions)
+			continue;
+
+		const size_t start_pos = posting_list.positions->write(positions_teletype);
+		builder.add({term, {start_pos, static_cast<size_t>(positions_teletype.tellp())}});
+	}
+
+	positions_teletype.flush();
+	builder.finalize();
+}
+
 }
 
@@ -6,10 +6,12 @@
 #include <string>
 #include <utility>
 #include <vector>
+#include <memory>
 #include <cassert>
 #include <iterator>
 #include "../index/types.hpp"
 #include "../index/Index.hpp"
+#include "../index/positions.hpp"
 #include "../codes/variable_blocks.hpp"
 #include <ranges>
 
@@ -33,6 +35,8 @@ private:
         std::vector<uint8_t> docids;
         std::vector<uint8_t> freqs;
         freq_t n_docs = 0;
+        // Only allocated if the positions are given
+        std::unique_ptr<PositionsWriter> positions;
     };
 
     // For each term in the lexicon we save two vectors: the first contains the compressed docIDs
@@ -71,6 +75,22 @@ public:
 		entry.n_docs += 1;
     }
 
+    /**
+    * Same as above, but it also stores the positions of the term in the document
+    * @param term index of the inverted index
+    * @param id docid
+    * @param positions positions of the term in the document, in increasing order
+    */
+    void add_to_post(const std::string& term, docid_t id, const std::vector<position_t>& positions)
+    {
+        add_to_post(term, id, positions.size());
+
+        auto& entry = inverted_index[term];
+        if(not entry.positions)
+            entry.positions = std::make_unique<PositionsWriter>();
+        entry.positions->add(id, positions);
+    }
+
     /**
     * This function 'add_to_doc' inserts document information into the document index at a specific document ID.
     *
@@ -90,6 +110,14 @@ public:
 
     void write_to_disk(std::ostream& docid_teletype, std::ostream& freq_teletype, std::ostream& lexicon_teletype, std::ostream& document_index_teletype);
 
+    /**
+    * Writes the positions of the posting lists and the lexicon that points to them. Only meaningful if the
+    * postings were added with their positions.
+    * @param positions_teletype stream in which the positions are saved
+    * @param lexicon_teletype stream in which the positions' lexicon is saved
+    */
+    void write_positions_to_disk(std::ostream& positions_teletype, std::ostream& lexicon_teletype);
+
 	/*
 	This function 'get_n_docs_view' creates a view to obtain the number of documents 'n_i' associated with each term in the 'IndexBuilder'.
 
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include "chunks.hpp"
+#include "../index/metadata.hpp"
+#include "../index/query_scorer.hpp"
+#include "../util/trace.hpp"
+#include "../codes/diskmap/diskmap.hpp"
+
+std::vector<chunk_info_t> list_chunks(const std::filesystem::path& dir)
+{
+	std::vector<chunk_info_t> chunks;
+	for(const auto& dir_entry : std::filesystem::directory_iterator(dir))
+	{
+		const auto name = dir_entry.path().filename().string();
+		if(not dir_entry.is_directory() or not name.starts_with("db_"))
+			continue;
+
+		chunk_info_t chunk = {.path = dir_entry.path(), .chunk_n = std::stoul(name.substr(3))};
+
+		// The document index starts with the base docid and the number of documents
+		std::ifstream document_index(chunk.path/"document_index", std::ios::binary);
+		document_index.read((char*)&chunk.base_docid, sizeof(chunk.base_docid));
+		document_index.read((char*)&chunk.n_docs, sizeof(chunk.n_docs));
+
+		chunk.size = std::filesystem::file_size(chunk.path/"posting_lists_docids") +
+				std::filesystem::file_size(chunk.path/"posting_lists_freqs");
+		chunks.push_back(chunk);
+	}
+
+	std::sort(chunks.begin(), chunks.end(), [](const chunk_info_t& a, const chunk_info_t& b) {
+		return a.base_docid < b.base_docid;
+	});
+	return chunks;
+}
+
+void write_chunk(sindex::IndexBuilder& index_builder, const std::filesystem::path& chunk_dir, bool positions)
+{
+	if(not std::filesystem::exists(chunk_dir))
+		std::filesystem::create_directory(chunk_dir);
+
+	// Specify the output files on which we'll write
+	auto pl_docids = std::ofstream(chunk_dir/"posting_lists_docids", std::ios_base::binary);
+	auto pl_freqs = std::ofstream(chunk_dir/"posting_lists_freqs", std::ios_base::binary);
+	// lexicon_temp because we have to calculate the sigmas
+	auto lexicon = std::ofstream(chunk_dir/"lexicon_temp", std::ios_base::binary);
+	auto doc_index = std::ofstream(chunk_dir/"document_index", std::ios_base::binary);
+
+	index_builder.write_to_disk(pl_docids, pl_freqs, lexicon, doc_index);
+
+	if(positions)
+	{
+		auto pl_positions = std::ofstream(chunk_dir/"posting_lists_positions", std::ios_base::binary);
+		auto positions_lexicon = std::ofstream(chunk_dir/"lexicon_positions", std::ios_base::binary);
+		index_builder.write_positions_to_disk(pl_positions, positions_lexicon);
+	}
+}
+
+std::filesystem::path temp_path(const std::filesystem::path& path)
+{
+	return path.string() + ".tmp";
+}
+
+void commit_file(const std::filesystem::path& path)
+{
+	std::filesystem::rename(temp_path(path), path);
+}
+
+void write_global_lexicon(const std::filesystem::path& dir, const std::vector<std::filesystem::path>& chunk_dirs)
+{
+	TRACE_SPAN("merge lexica", "build");
+	std::ofstream lexicon_teletype(temp_path(dir/"global_lexicon"), std::ios::binary);
+
+	// Open up all files and maps from the local lexicon
+	struct lexicon_temp
+	{
+		memory_mmap file; codes::disk_map<sindex::LexiconValue> lexicon;
+		// This is constructor is necessary for older version of Apple's clang :(((
+		lexicon_temp(memory_mmap&& file, codes::disk_map<sindex::LexiconValue>&& lexicon) :
+			file(std::move(file)), lexicon(std::move(lexicon)) {}
+	};
+	std::vector<std::unique_ptr<lexicon_temp>> lexica;
+	lexica.reserve(chunk_dirs.size());
+
+	// Map all lexica
+	for(const auto& db_path : chunk_dirs)
+	{
+		memory_mmap lexicon_mmap(db_path/"lexicon_temp", mmap_policy::sequential());
+
+		lexica.push_back(
+				std::make_unique<lexicon_temp>(
+						std::move(lexicon_mmap), codes::disk_map<sindex::LexiconValue>(lexicon_mmap)));
+	}
+
+	// Preparing merge
+	using iterator = codes::disk_map<sindex::LexiconValue>::iterator;
+	std::vector<std::pair<iterator, iterator>> ranges;
+	ranges.reserve(lexica.size());
+
+	// Fill ranges
+	for(const auto& lexicon : lexica)
+		ranges.emplace_back(lexicon->lexicon.begin(), lexicon->lexicon.end());
+
+	// Extract the n_docs field from a LexiconValue object
+	const auto filter_f = [](const sindex::LexiconValue& v) -> sindex::freq_t {return v.n_docs;};
+	// Sum all the freqs
+	const auto merge_f = []([[maybe_unused]] const std::string& key, const std::vector<sindex::freq_t>& values) {
+		return std::accumulate(values.begin(), values.end(), (sindex::freq_t)0);
+	};
+
+	// Merge
+	codes::merge<sindex::freq_t, iterator, codes::BLOCK_SIZE, sindex::LexiconValue>(lexicon_teletype, ranges, merge_f, filter_f);
+	lexicon_teletype.close();
+	commit_file(dir/"global_lexicon");
+}
+
+void write_metadata(const std::filesystem::path& dir, size_t n_docs, sindex::doclen_t doc_len_sum, bool quantized)
+{
+	std::ofstream metadata(temp_path(dir/"metadata"), std::ios::binary);
+
+	const sindex::CollectionMetadata m = {
+		.doc_len_sum = doc_len_sum,
+		.n_docs = n_docs,
+		// Upper bound of the impacts' quantizer: a BM25 score is always less than the term's idf, and the largest
+		// idf is the one of a term that appears in just one document
+		.impact_upper_bound = sindex::QueryTFIDFScorer::idf(n_docs, 1),
+		.quantized = quantized
+	};
+	m.write(metadata);
+	metadata.close();
+	commit_file(dir/"metadata");
+}
+
+size_t delete_documents(const std::filesystem::path& dir, const std::vector<chunk_info_t>& chunks,
+						const std::unordered_set<sindex::docno_t>& docnos)
+{
+	TRACE_SPAN("delete documents", "build");
+	memory_mmap metadata_mem(dir/"metadata");
+	memory_mmap global_lexicon_mem(dir/"global_lexicon");
+	sindex::Index<sindex::LexiconValue>::global_lexicon_t global_lexicon(global_lexicon_mem);
+
+	size_t n_deleted = 0;
+	for(const auto& chunk : chunks)
+	{
+		// Bit i of byte i / 8 is the document base docid + i
+		std::vector<uint8_t> bitmap((chunk.n_docs + 7) / 8);
+		bool changed = false;
+
+		{
+			index_worker_t<sindex::LexiconValue> index_worker(chunk.path, metadata_mem, global_lexicon, "lexicon_temp", 0, index_mmap_policy::sequential());
+			const auto& index = index_worker.index;
+
+			for(sindex::docid_t docid = chunk.base_docid; docid < chunk.base_docid + chunk.n_docs; ++docid)
+			{
+				const auto offset = docid - chunk.base_docid;
+				if(not index.is_deleted(docid) and not docnos.contains(sindex::docno_t(index.get_docno(docid))))
+					continue;
+
+				if(not index.is_deleted(docid))
+				{
+					n_deleted += 1;
+					changed = true;
+				}
+				bitmap[offset / 8] |= 1 << (offset % 8);
+			}
+		}
+
+		if(changed)
+		{
+			std::ofstream(temp_path(chunk.path/"deleted"), std::ios::binary).write((char*)bitmap.data(), bitmap.size());
+			commit_file(chunk.path/"deleted");
+		}
+	}
+
+	return n_deleted;
+}
+
+std::pair<size_t, sindex::doclen_t> merge_chunks(const std::filesystem::path& dir, const std::vector<chunk_info_t>& chunks,
+												 size_t chunk_n, std::mutex& disk_writer_mutex)
+{
+	TRACE_SPAN("merge chunks", "build");
+	memory_mmap metadata_mem(dir/"metadata");
+	memory_mmap global_lexicon_mem(dir/"global_lexicon");
+	sindex::Index<sindex::LexiconValue>::global_lexicon_t global_lexicon(global_lexicon_mem);
+
+	const auto merged_dir = dir/("merging_" + std::to_string(chunk_n));
+	const sindex::docid_t first = chunks.front().base_docid, last = chunks.back().base_docid + chunks.back().n_docs;
+	std::pair<size_t, sindex::doclen_t> dropped;
+
+	{
+		source_chunks_t source_chunks;
+		for(const auto& chunk : chunks)
+			source_chunks.emplace_back(chunk.path, metadata_mem, global_lexicon, "lexicon_temp", 0, index_mmap_policy::sequential());
+
+		const bool positions = source_chunks.front().index.has_positions();
+		sindex::IndexBuilder index_builder(count_live_documents(source_chunks, first, last), first);
+		dropped = copy_documents(source_chunks, first, last, index_builder, first, positions);
+
+		std::lock_guard<std::mutex> guard(disk_writer_mutex);
+		write_chunk(index_builder, merged_dir, positions);
+	}
+
+	for(const auto& chunk : chunks)
+		std::filesystem::remove_all(chunk.path);
+	std::filesystem::rename(merged_dir, dir/("db_" + std::to_string(chunk_n)));
+
+	return dropped;
+}
+
+/** The documents of a chunk in [first, last) */
+static std::pair<sindex::docid_t, sindex::docid_t> chunk_range(const sindex::Index<sindex::LexiconValue>& index,
+															   sindex::docid_t first, sindex::docid_t last)
+{
+	const sindex::docid_t chunk_end = index.get_base_docid() + index.get_n_local_docs();
+	return {std::max(first, index.get_base_docid()), std::max(std::min(last, chunk_end), index.get_base_docid())};
+}
+
+size_t count_live_documents(const source_chunks_t& chunks, sindex::docid_t first, sindex::docid_t last)
+{
+	size_t n_live_docs = 0;
+	for(const auto& chunk : chunks)
+	{
+		const auto [begin, end] = chunk_range(chunk.index, first, last);
+		for(auto docid = begin; docid < end; ++docid)
+			n_live_docs += not chunk.index.is_deleted(docid);
+	}
+
+	return n_live_docs;
+}
+
+std::pair<size_t, sindex::doclen_t> copy_documents(source_chunks_t& chunks, sindex::docid_t first, sindex::docid_t last,
+												   sindex::IndexBuilder& index_builder, sindex::docid_t new_base, bool positions)
+{
+	TRACE_SPAN("copy documents", "build");
+	size_t dropped_docs = 0;
+	sindex::doclen_t dropped_len = 0;
+
+	// The new docid of each document of the range, DOCID_MAX if it's dropped
+	std::vector<sindex::docid_t> new_docids(last - first, sindex::DOCID_MAX);
+	sindex::docid_t next_docid = new_base;
+	for(const auto& chunk : chunks)
+	{
+		const auto& index = chunk.index;
+		const auto [begin, end] = chunk_range(index, first, last);
+		for(auto docid = begin; docid < end; ++docid)
+		{
+			const auto document_info = index.get_document_info(docid);
+			if(index.is_deleted(docid))
+			{
+				dropped_docs += 1;
+				dropped_len += document_info.lenght;
+				continue;
+			}
+
+			new_docids[docid - first] = next_docid;
+			index_builder.add_to_doc(next_docid++, document_info);
+		}
+	}
+
+	// Chunks are read in docid order, so the postings of each term are added in increasing docid order
+	for(auto& chunk : chunks)
+	{
+		auto& index = chunk.index;
+		const auto [begin, end] = chunk_range(index, first, last);
+		if(begin == end)
+			continue;
+
+		for(const auto& [term, lv] : index.get_local_lexicon())
+		{
+			auto pl = index.get_posting_list(term, lv);
+			auto positions_cursor = positions ? index.get_positions(term) : std::nullopt;
+
+			auto it = pl.begin();
+			it.nextGEQ(begin);
+			for(; it != pl.end() and it->first < end; ++it)
+			{
+				const auto [docid, freq] = *it;
+				const auto new_docid = new_docids[docid - first];
+				if(new_docid == sindex::DOCID_MAX)
+					continue;
+
+				if(positions_cursor)
+					index_builder.add_to_post(term, new_docid, positions_cursor->get(docid));
+				else
+					index_builder.add_to_post(term, new_docid, freq);
+			}
+		}
+	}
+
+	return {dropped_docs, dropped_len};
+}
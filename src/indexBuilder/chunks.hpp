@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "IndexBuilder.hpp"
+#include "../index_worker.hpp"
+
+/*
+ * Chunks of an index written by the builder, read back to write their documents in new chunks. Used by the
+ * incremental builds' merges and by the resharder.
+ */
+
+/**
+ * A chunk of an existing index
+ */
+struct chunk_info_t
+{
+	std::filesystem::path path;
+	// The N of db_N
+	size_t chunk_n;
+	sindex::docid_t base_docid = 0;
+	size_t n_docs = 0;
+	// Bytes of its posting lists
+	size_t size = 0;
+};
+
+/**
+ * Lists the chunks of an index
+ * @param dir the directory where the index is stored
+ * @return the chunks, by base docid
+ */
+std::vector<chunk_info_t> list_chunks(const std::filesystem::path& dir);
+
+/**
+ * Writes a chunk built in memory, with its temporary lexicon
+ * @param index_builder the chunk
+ * @param chunk_dir where to write it, it's created if it does not exist
+ * @param positions whether the postings were added with their positions
+ */
+void write_chunk(sindex::IndexBuilder& index_builder, const std::filesystem::path& chunk_dir, bool positions);
+
+/**
+ * Files of an index that is already there are written aside, at temp_path(path), and then renamed over the old ones
+ * by commit_file(path): an engine started meanwhile reads either the old file or the new one, never half of it.
+ */
+std::filesystem::path temp_path(const std::filesystem::path& path);
+void commit_file(const std::filesystem::path& path);
+
+/**
+ * Merges the temporary lexica of the chunks into the global one
+ * @param dir the directory where the index is stored
+ * @param chunk_dirs the chunks of the index
+ */
+void write_global_lexicon(const std::filesystem::path& dir, const std::vector<std::filesystem::path>& chunk_dirs);
+
+/**
+ * Writes the metadata file
+ * @param dir the directory where the index is stored
+ * @param n_docs the number of documents in the collection
+ * @param doc_len_sum their total length
+ * @param quantized whether the sigma lexica will point to quantized impacts
+ */
+void write_metadata(const std::filesystem::path& dir, size_t n_docs, sindex::doclen_t doc_len_sum, bool quantized);
+
+/**
+ * Marks the given documents as deleted in the bitmaps of the chunks. The engine still scores them but keeps them out
+ * of the results, and they count in the collection's statistics until a merge drops them.
+ * @param dir the directory where the index is stored
+ * @param chunks the index's chunks
+ * @param docnos the documents to delete
+ * @return how many documents were deleted
+ */
+size_t delete_documents(const std::filesystem::path& dir, const std::vector<chunk_info_t>& chunks,
+						const std::unordered_set<sindex::docno_t>& docnos);
+
+/**
+ * Merges adjacent chunks into a new one, dropping their deleted documents. The live documents keep their order and
+ * are renumbered from the first chunk's base docid, the docids of the other chunks don't change. The merged chunk is
+ * built in memory and it replaces the old ones only once it's written.
+ * @param dir the directory where the index is stored
+ * @param chunks the chunks to merge, by base docid
+ * @param chunk_n the number of the merged chunk
+ * @param disk_writer_mutex held while the merged chunk is written
+ * @return the number of dropped documents and their total length
+ */
+std::pair<size_t, sindex::doclen_t> merge_chunks(const std::filesystem::path& dir, const std::vector<chunk_info_t>& chunks,
+												 size_t chunk_n, std::mutex& disk_writer_mutex);
+
+// The chunks of an index, opened with their temporary lexica. Their posting lists are read sequentially
+using source_chunks_t = std::list<index_worker_t<sindex::LexiconValue>>;
+
+/**
+ * Counts the documents in [first, last) of the chunks that are not deleted
+ */
+size_t count_live_documents(const source_chunks_t& chunks, sindex::docid_t first, sindex::docid_t last);
+
+/**
+ * Copies the documents in [first, last) of the chunks to a new chunk, dropping the deleted ones. The documents keep
+ * their order and are renumbered from new_base.
+ * @param chunks the chunks, by base docid
+ * @param index_builder the new chunk, its base docid must be new_base
+ * @param positions whether to copy the positions too, the chunks must have them
+ * @return the number of dropped documents and their total length
+ */
+std::pair<size_t, sindex::doclen_t> copy_documents(source_chunks_t& chunks, sindex::docid_t first, sindex::docid_t last,
+												   sindex::IndexBuilder& index_builder, sindex::docid_t new_base, bool positions);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace sindex
+{
+
+/**
+ * Tiered merge policy of the incremental builds. A chunk's tier grows by one each time its size is `factor` times
+ * bigger, starting from min_size: when `factor` adjacent chunks are in the same tier they're merged into one of the next
+ * tier. A collection that grows by small batches keeps a logarithmic number of chunks, and each posting is rewritten a
+ * logarithmic number of times. Only adjacent chunks are merged, so that the merged one still covers a contiguous range
+ * of docids. Chunks that would grow past max_size, as the ones of a full build, are left alone.
+ */
+struct merge_policy_t
+{
+	size_t factor = 4;
+	size_t min_size = 1;
+	size_t max_size = SIZE_MAX;
+
+	unsigned tier(size_t size) const
+	{
+		unsigned t = 0;
+		for(size_t bound = min_size; size > bound and bound <= SIZE_MAX / factor; bound *= factor)
+			t += 1;
+
+		return t;
+	}
+
+	/**
+	 * @param sizes the chunks' sizes, in docid order
+	 * @return the ranges [first, last) of chunks to merge, they don't overlap. Merging them may form new ranges, so
+	 * the policy should be run again until it returns none
+	 */
+	std::vector<std::pair<size_t, size_t>> plan(const std::vector<size_t>& sizes) const
+	{
+		std::vector<std::pair<size_t, size_t>> merges;
+		if(factor < 2)
+			return merges;
+
+		for(size_t first = 0; first < sizes.size();)
+		{
+			// The run of adjacent chunks in the same tier, up to factor of them
+			size_t last = first + 1, total = sizes[first];
+			while(last < sizes.size() and last - first < factor and tier(sizes[last]) == tier(sizes[first]))
+				total += sizes[last++];
+
+			if(last - first == factor and total <= max_size)
+			{
+				merges.emplace_back(first, last);
+				first = last;
+			}
+			else
+				first += 1;
+		}
+
+		return merges;
+	}
+};
+
+}
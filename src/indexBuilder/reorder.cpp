@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "reorder.hpp"
+
+namespace sindex
+{
+
+namespace
+{
+
+class bisection
+{
+	const std::vector<std::vector<uint32_t>>& docs;
+	const unsigned n_iterations;
+	const size_t min_partition;
+
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> left_deg, right_deg;
+	std::vector<double> gains;
+
+	// Estimated cost of a term with degree d in a partition of n documents
+	static double cost(double d, double n) {return d * std::log2(n / (d + 1));}
+
+	void compute_gains(std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end,
+					   double n_left, double n_right, bool left)
+	{
+		for(auto it = begin; it != end; ++it)
+		{
+			double gain = 0;
+			for(auto term : docs[*it])
+			{
+				const double l = left_deg[term], r = right_deg[term];
+				const double before = cost(l, n_left) + cost(r, n_right);
+				const double after = left ?
+						cost(l - 1, n_left) + cost(r + 1, n_right) :
+						cost(l + 1, n_left) + cost(r - 1, n_right);
+				gain += before - after;
+			}
+
+			gains[*it] = gain;
+		}
+	}
+
+	void count_degrees(std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end,
+					   std::vector<uint32_t>& degrees, int delta)
+	{
+		for(auto it = begin; it != end; ++it)
+			for(auto term : docs[*it])
+				degrees[term] += delta;
+	}
+
+	void bisect(std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end)
+	{
+		const size_t n = end - begin;
+		if(n < min_partition or n < 2)
+			return;
+
+		const auto mid = begin + n / 2;
+		const double n_left = mid - begin, n_right = end - mid;
+		const auto by_gain = [this](uint32_t a, uint32_t b) {return gains[a] > gains[b];};
+
+		for(unsigned iteration = 0; iteration < n_iterations; ++iteration)
+		{
+			count_degrees(begin, mid, left_deg, 1);
+			count_degrees(mid, end, right_deg, 1);
+
+			compute_gains(begin, mid, n_left, n_right, true);
+			compute_gains(mid, end, n_left, n_right, false);
+
+			// Back to zero, for the next round
+			count_degrees(begin, mid, left_deg, -1);
+			count_degrees(mid, end, right_deg, -1);
+
+			std::sort(begin, mid, by_gain);
+			std::sort(mid, end, by_gain);
+
+			// Swap the pairs with the largest gains, while it's worth it
+			size_t swaps = 0;
+			for(auto l = begin, r = mid; l != mid and r != end and gains[*l] + gains[*r] > 0; ++l, ++r, ++swaps)
+				std::iter_swap(l, r);
+
+			if(swaps == 0)
+				break;
+		}
+
+		bisect(begin, mid);
+		bisect(mid, end);
+	}
+
+public:
+	bisection(const std::vector<std::vector<uint32_t>>& docs, size_t n_terms, unsigned n_iterations, size_t min_partition):
+		docs(docs), n_iterations(n_iterations), min_partition(min_partition), order(docs.size()),
+		left_deg(n_terms, 0), right_deg(n_terms, 0), gains(docs.size(), 0)
+	{
+		std::iota(order.begin(), order.end(), 0);
+	}
+
+	std::vector<uint32_t> run()
+	{
+		bisect(order.begin(), order.end());
+		return std::move(order);
+	}
+};
+
+}
+
+std::vector<uint32_t> bp_order(const std::vector<std::vector<uint32_t>>& docs, size_t n_terms,
+							   unsigned n_iterations, size_t min_partition)
+{
+	return bisection(docs, n_terms, n_iterations, min_partition).run();
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sindex
+{
+
+/**
+ * Recursive graph bisection (BP) ordering of the documents.
+ * The documents are recursively split in two halves; at each level documents are swapped between the halves to
+ * minimize the estimated cost of the gaps, d * log(n / (d + 1)), of the terms in both halves. Documents sharing many
+ * terms end up close to each other, which tightens the posting lists' block upper bounds.
+ * @param docs the distinct term ids of each document, terms must be in [0, n_terms)
+ * @param n_terms the number of distinct terms
+ * @param n_iterations the maximum number of swapping rounds at each level
+ * @param min_partition partitions smaller than this are not split further
+ * @return the new order: the i-th element is the index of the document that goes in position i
+ */
+std::vector<uint32_t> bp_order(const std::vector<std::vector<uint32_t>>& docs, size_t n_terms,
+							   unsigned n_iterations = 20, size_t min_partition = 16);
+
+}
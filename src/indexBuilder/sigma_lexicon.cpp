@@ -0,0 +1,200 @@
+#include <fstream>
+#include <memory>
+#include <vector>
+#include "sigma_lexicon.hpp"
+#include "chunks.hpp"
+#include "../index_worker.hpp"
+#include "../util/trace.hpp"
+#include "../codes/diskmap/diskmap.hpp"
+
+/**
+ * This function writes the impact-ordered copy of a posting list: postings are grouped in segments of equal impact,
+ * the segments are written in decreasing impact order and, inside a segment, docids are gap-encoded
+ * @param impacts the <impact, docid> pairs of the posting list
+ * @param impact_postings where to write the segments
+ * @return the lexicon's entry for the posting list
+ */
+static sindex::ImpactLexiconValue write_impact_ordered(std::vector<std::pair<sindex::impact_t, sindex::docid_t>>& impacts, std::ostream& impact_postings)
+{
+	sindex::ImpactLexiconValue ilv;
+	ilv.start_pos = impact_postings.tellp();
+
+	// Decreasing impacts, increasing docids
+	std::sort(impacts.begin(), impacts.end(), [](const auto& a, const auto& b) {
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	});
+
+	sindex::docid_t prev_docid = 0;
+	for(const auto& [impact, docid] : impacts)
+	{
+		// New segment
+		if(ilv.segments.empty() or ilv.segments.back().impact != impact)
+		{
+			ilv.segments.push_back({
+				.impact = impact,
+				.n_postings = 0,
+				.offset = static_cast<size_t>(impact_postings.tellp()) - ilv.start_pos
+			});
+			prev_docid = 0;
+		}
+
+		auto gap = codes::VariableBytes(docid - prev_docid);
+		impact_postings.write((char*)gap.bytes, gap.used_bytes);
+
+		ilv.segments.back().n_postings += 1;
+		prev_docid = docid;
+	}
+
+	ilv.end_pos = impact_postings.tellp();
+	return ilv;
+}
+
+std::atomic<size_t> sum_skip_list_len = 0;
+std::atomic<size_t> n_skip_lists = 0;
+
+std::pair<size_t, std::string> write_sigma_lexicon(const std::filesystem::path& dir, bool impact_ordered, bool quantized,
+												   size_t skip_block_size) {
+	TRACE_SPAN("sigma pass", "build");
+
+	// Statistical stuff
+	std::pair<size_t, std::string> max_skip_list_len = {};
+
+	// Load all db stuff
+	memory_mmap metadata_mem(dir/".."/"metadata");
+	memory_mmap global_lexicon_mem(dir/".."/"global_lexicon");
+	sindex::Index<sindex::LexiconValue>::global_lexicon_t global_lexicon(global_lexicon_mem);
+	sindex::QueryTFIDFScorer tfidf_scorer;
+	sindex::QueryBM25Scorer bm25_scorer;
+
+	// All the posting lists are read once, in order
+	index_worker_t<sindex::LexiconValue> index_worker(dir, metadata_mem, global_lexicon, "lexicon_temp", 0, index_mmap_policy::sequential());
+
+	// The files are written aside, an incremental build rewrites them in an index an engine may be loading
+	std::ofstream sigma_lexicon(temp_path(dir/"lexicon"), std::ios::binary);
+
+	codes::disk_map_writer<sindex::SigmaLexiconValue> sigma_lexicon_writer(sigma_lexicon);
+
+	// Impact-ordered posting lists, only if requested
+	const auto& quantizer = index_worker.index.get_quantizer();
+	std::ofstream impact_postings, impact_lexicon;
+	std::unique_ptr<codes::disk_map_writer<sindex::ImpactLexiconValue>> impact_lexicon_writer;
+	std::vector<std::pair<sindex::impact_t, sindex::docid_t>> impacts;
+
+	// Quantized impacts in place of the frequencies
+	std::ofstream quantized_impacts;
+	if(quantized)
+		quantized_impacts.open(temp_path(dir/"posting_lists_impacts"), std::ios::binary);
+
+	if(impact_ordered)
+	{
+		impact_postings.open(temp_path(dir/"posting_lists_impact_ordered"), std::ios::binary);
+		impact_lexicon.open(temp_path(dir/"lexicon_impact_ordered"), std::ios::binary);
+		impact_lexicon_writer = std::make_unique<codes::disk_map_writer<sindex::ImpactLexiconValue>>(impact_lexicon);
+	}
+
+	// For each term in the local lexicon
+	for(const auto& [term, lv] : index_worker.index.get_local_lexicon())
+	{
+		sindex::SigmaLexiconValue slv = lv;
+		sindex::SigmaLexiconValue::skip_pointer_t current_skip;
+		size_t i = 1;
+
+		auto pl = index_worker.index.get_posting_list(term, lv);
+		auto pl_it = pl.begin();
+		auto pl_curr_block_off = pl.get_offset(pl_it);
+
+		// In quantized mode there's one byte per posting, the offset of a block is the index of its first posting
+		size_t block_first_posting = 0;
+		if(quantized)
+		{
+			slv.start_pos_freq = quantized_impacts.tellp();
+			slv.end_pos_freq = slv.start_pos_freq + lv.n_docs;
+		}
+
+		// Build a skip pointer
+		auto build_skip = [&](const auto& docid) {
+			current_skip.last_docid = docid;
+			current_skip.docid_offset = pl_curr_block_off.docid_off;
+			current_skip.freq_offset = quantized ?
+					codes::serialize_bit_offset(block_first_posting, 0) : pl_curr_block_off.freq_off;
+			slv.skip_pointers.push_back(current_skip);
+
+			current_skip = {};
+			pl_curr_block_off = pl.get_offset(pl_it + 1);
+			block_first_posting = i;
+		};
+
+		// For each posting we score it and update the sigma, if necessary
+		for(; pl_it != pl.end(); ++pl_it, ++i)
+		{
+			const auto& [docid, freq] = *pl_it;
+
+			auto tfidf_score = pl.score(pl_it, tfidf_scorer);
+			auto bm25_score = pl.score(pl_it, bm25_scorer);
+
+			// Sigmas must bound the scores the engine will see, that is the dequantized ones
+			if(quantized)
+			{
+				const auto impact = quantizer.quantize(bm25_score);
+				quantized_impacts.put(static_cast<char>(impact));
+				bm25_score = quantizer.dequantize(impact);
+			}
+
+
+			slv.tfidf_sigma = std::max(slv.tfidf_sigma, tfidf_score);
+			current_skip.tfidf_ub = std::max(current_skip.tfidf_ub, tfidf_score);
+
+			slv.bm25_sigma = std::max(slv.bm25_sigma, bm25_score);
+			current_skip.bm25_ub = std::max(current_skip.bm25_ub, bm25_score);
+
+			if(impact_ordered)
+				impacts.emplace_back(quantizer.quantize(bm25_score), docid);
+			
+			// If we reached the end of the block
+			if (i % skip_block_size == 0)
+				build_skip(docid);
+		}
+
+		// If we have a partial block. Here i is one past the number of postings
+		if ((i - 1) % skip_block_size != 0)
+			build_skip(pl_it->first);
+
+		// Write the new value
+		sigma_lexicon_writer.add(term, slv);
+
+		if(impact_ordered)
+		{
+			impact_lexicon_writer->add(term, write_impact_ordered(impacts, impact_postings));
+			impacts.clear();
+		}
+
+		// Update statistics
+		max_skip_list_len = std::max(max_skip_list_len, {slv.skip_pointers.size(), term});
+		sum_skip_list_len += slv.skip_pointers.size();
+		n_skip_lists += 1;
+	}
+
+	// Write the final informations on the disk
+	sigma_lexicon_writer.finalize();
+	sigma_lexicon.close();
+
+	// The lexica go in place after the postings they point to
+	if(quantized)
+	{
+		quantized_impacts.close();
+		commit_file(dir/"posting_lists_impacts");
+	}
+
+	if(impact_ordered)
+	{
+		impact_lexicon_writer->finalize();
+		impact_postings.close();
+		impact_lexicon.close();
+		commit_file(dir/"posting_lists_impact_ordered");
+		commit_file(dir/"lexicon_impact_ordered");
+	}
+
+	commit_file(dir/"lexicon");
+
+	return max_skip_list_len;
+}
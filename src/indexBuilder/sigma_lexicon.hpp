@@ -0,0 +1,28 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <utility>
+
+constexpr size_t SKIP_BLOCK_SIZE = 15'000;
+
+// Skip lists' statistics, accumulated by all the calls to write_sigma_lexicon
+extern std::atomic<size_t> sum_skip_list_len;
+extern std::atomic<size_t> n_skip_lists;
+
+/**
+ * This function computes the sigma for each term in the local lexicon and writes it to disk
+ * It also computes the skipping list and, if requested, the impact-ordered posting lists.
+ * In quantized mode the new lexicon points to a stream of 8-bit BM25 impacts, one per posting, instead of the
+ * unary-encoded term frequencies.
+ * The directory's parent must contain the collection's metadata and global lexicon.
+ * @param dir the directory where the index is stored
+ * @param impact_ordered whether to write the impact-ordered posting lists too
+ * @param quantized whether to replace term frequencies with quantized impacts
+ * @param skip_block_size postings per skip block, smaller ones are only useful to test the skipping on small indices
+ * @return the maximum length of the skipping list
+ */
+std::pair<size_t, std::string> write_sigma_lexicon(const std::filesystem::path& dir, bool impact_ordered, bool quantized,
+												   size_t skip_block_size = SKIP_BLOCK_SIZE);
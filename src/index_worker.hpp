@@ -4,11 +4,15 @@
 #include <iostream>
 #include <set>
 #include <filesystem>
+#include <optional>
+#include <memory>
 #include "normalizer/WordNormalizer.hpp"
 #include "index/types.hpp"
 #include "index/Index.hpp"
 #include "index/query_scorer.hpp"
+#include "index/metadata.hpp"
 #include "util/memory.hpp"
+#include "util/block_cache.hpp"
 #include "util/thread_pool.hpp"
 
 template<class LVT>
@@ -17,18 +21,109 @@ struct index_worker_t
 	memory_mmap local_lexicon_mem;
 	typename sindex::Index<LVT>::local_lexicon_t local_lexicon;
 
-	memory_mmap iid_mem;
-	memory_mmap iif_mem;
+	// Mapped, or read through a block cache
+	std::unique_ptr<memory_area> iid_mem;
+	std::unique_ptr<memory_area> iif_mem;
 	memory_mmap di_mem;
 
 	sindex::Index<LVT> index;
 
-	index_worker_t(const std::filesystem::path& db, memory_area& metadata, typename sindex::Index<LVT>::global_lexicon_t& global_lexicon, sindex::QueryScorer& scorer, const std::string& lexicon_name = "lexicon_temp"):
-			local_lexicon_mem(db/lexicon_name),
+	// Impact-ordered posting lists, they're written only if the builder was asked to
+	std::optional<memory_mmap> impact_lexicon_mem;
+	std::optional<memory_mmap> impact_postings_mem;
+
+	// Positions, they're written only if the builder was asked to
+	std::optional<memory_mmap> positions_lexicon_mem;
+	std::optional<memory_mmap> positions_mem;
+
+	// Bitmap of the deleted documents, it's written only by the incremental builds
+	std::optional<memory_mmap> deleted_mem;
+
+	/** Quantized indices' sigma lexica point to the impacts' stream instead of the tfs' one */
+	static std::string freqs_file_name(const memory_area& metadata)
+	{
+		if(std::is_same_v<LVT, sindex::SigmaLexiconValue> and sindex::CollectionMetadata::read(metadata).quantized)
+			return "posting_lists_impacts";
+
+		return "posting_lists_freqs";
+	}
+
+	/** Maps a posting lists' file, or reads it through a block cache if cache_bytes is not 0 */
+	static std::unique_ptr<memory_area> open_postings(const std::filesystem::path& file, size_t cache_bytes, const mmap_policy& policy)
+	{
+		if(cache_bytes == 0)
+			return std::make_unique<memory_mmap>(file, policy);
+
+		return std::make_unique<memory_block_cache>(file, cache_bytes);
+	}
+
+	/** The share of cache_bytes of the file, proportional to its size */
+	static size_t cache_share(const std::filesystem::path& file, const std::filesystem::path& other, size_t cache_bytes)
+	{
+		if(cache_bytes == 0)
+			return 0;
+
+		const auto size = std::filesystem::file_size(file), other_size = std::filesystem::file_size(other);
+		return std::max<size_t>(1, (long double)cache_bytes * size / std::max<size_t>(1, size + other_size));
+	}
+
+	/**
+	 * @param block_cache_bytes if not 0 the posting lists are not mapped, they're read through block caches of this
+	 * many bytes in total. Only the posting lists of the queries are loaded, see memory_block_cache
+	 * @param policy how the mapped files are kept in memory, by class
+	 */
+	index_worker_t(const std::filesystem::path& db, memory_area& metadata, typename sindex::Index<LVT>::global_lexicon_t& global_lexicon,
+				   const std::string& lexicon_name = "lexicon_temp", size_t block_cache_bytes = 0, const index_mmap_policy& policy = {}):
+			local_lexicon_mem(db/lexicon_name, policy.lexicon),
 			local_lexicon(local_lexicon_mem),
-			iid_mem(db/"posting_lists_docids"),
-			iif_mem(db/"posting_lists_freqs"),
-			di_mem(db/"document_index"),
-			index(std::move(local_lexicon), global_lexicon, iid_mem, iif_mem, di_mem, metadata, scorer)
-	{}
+			iid_mem(open_postings(db/"posting_lists_docids",
+								  cache_share(db/"posting_lists_docids", db/freqs_file_name(metadata), block_cache_bytes), policy.postings)),
+			iif_mem(open_postings(db/freqs_file_name(metadata),
+								  cache_share(db/freqs_file_name(metadata), db/"posting_lists_docids", block_cache_bytes), policy.postings)),
+			di_mem(db/"document_index", policy.document_index),
+			index(std::move(local_lexicon), global_lexicon, *iid_mem, *iif_mem, di_mem, metadata)
+	{
+		if(block_cache_bytes)
+			index.enable_block_cache(static_cast<memory_block_cache&>(*iid_mem), static_cast<memory_block_cache&>(*iif_mem));
+
+		if(std::filesystem::exists(db/"lexicon_impact_ordered"))
+		{
+			impact_lexicon_mem.emplace(db/"lexicon_impact_ordered", policy.lexicon);
+			impact_postings_mem.emplace(db/"posting_lists_impact_ordered", policy.postings);
+			index.load_impacts(typename sindex::Index<LVT>::impact_lexicon_t(*impact_lexicon_mem), *impact_postings_mem);
+		}
+
+		if(std::filesystem::exists(db/"lexicon_positions"))
+		{
+			positions_lexicon_mem.emplace(db/"lexicon_positions", policy.lexicon);
+			positions_mem.emplace(db/"posting_lists_positions", policy.postings);
+			index.load_positions(typename sindex::Index<LVT>::positions_lexicon_t(*positions_lexicon_mem), *positions_mem);
+		}
+
+		if(std::filesystem::exists(db/"deleted"))
+		{
+			deleted_mem.emplace(db/"deleted", policy.document_index);
+			index.load_deleted(*deleted_mem);
+		}
+	}
+
+	/** Faults in all the mapped files from the calling thread, see memory_mmap::prefault */
+	void prefault() const
+	{
+		for(const memory_area *mem : std::initializer_list<const memory_area *>{&local_lexicon_mem, iid_mem.get(), iif_mem.get(), &di_mem})
+			mem->prefault();
+
+		for(const auto *mem : {&impact_lexicon_mem, &impact_postings_mem, &positions_lexicon_mem, &positions_mem, &deleted_mem})
+			if(*mem)
+				(*mem)->prefault();
+	}
+
+	/** The block caches of the posting lists, none if they're mapped */
+	std::vector<const memory_block_cache *> block_caches() const
+	{
+		if(not index.has_block_cache())
+			return {};
+
+		return {static_cast<const memory_block_cache *>(iid_mem.get()), static_cast<const memory_block_cache *>(iif_mem.get())};
+	}
 };
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "index/types.hpp"
+#include "index/Index.hpp"
+#include "index/query_scorer.hpp"
+#include "index/metadata.hpp"
+#include "index_worker.hpp"
+#include "indexBuilder/IndexBuilder.hpp"
+#include "indexBuilder/sigma_lexicon.hpp"
+#include "util/thread_pool.hpp"
+#include "util/pruner_options.hpp"
+#include "codes/diskmap/diskmap.hpp"
+
+/*
+ * Static index pruning: the pruner reads an index written by the builder and writes a smaller one, the tier 0, with
+ * the same format and the same collection statistics. Only the postings that are likely to make it into a top-k are
+ * kept. For each term we also write the highest score of its dropped postings, so that the engine can tell whether
+ * the tier 0 results of a query may be trusted.
+ */
+
+// Highest BM25 score of the dropped postings of each term, over all the chunks
+std::map<std::string, sindex::score_t> pruned_bounds;
+std::mutex pruned_bounds_mutex;
+
+std::atomic<size_t> n_postings = 0;
+std::atomic<size_t> n_kept_postings = 0;
+
+/**
+ * Prunes one chunk of the index
+ * @param in_db the chunk to read
+ * @param out_db where to write the pruned chunk
+ * @param metadata the collection's metadata
+ * @param global_lexicon the collection's global lexicon
+ * @param options the pruner options
+ */
+static void prune_chunk(const std::filesystem::path& in_db, const std::filesystem::path& out_db, memory_area& metadata,
+						sindex::Index<sindex::SigmaLexiconValue>::global_lexicon_t& global_lexicon, const pruner_options& options)
+{
+	// All the posting lists are read once, in order
+	index_worker_t<sindex::SigmaLexiconValue> index_worker(in_db, metadata, global_lexicon, "lexicon", 0, index_mmap_policy::sequential());
+	auto& index = index_worker.index;
+	const sindex::QueryBM25Scorer bm25_scorer;
+
+	// The document index is copied as is, so that the docids don't change
+	sindex::IndexBuilder index_builder(index.get_n_local_docs(), index.get_base_docid());
+	for(sindex::docid_t docid = index.get_base_docid(); docid < index.get_base_docid() + index.get_n_local_docs(); ++docid)
+		index_builder.add_to_doc(docid, index.get_document_info(docid));
+
+	std::map<std::string, sindex::score_t> chunk_bounds;
+	std::vector<sindex::score_t> scores;
+	size_t chunk_postings = 0, chunk_kept_postings = 0;
+
+	for(const auto& [term, lv] : index.get_local_lexicon())
+	{
+		auto pl = index.get_posting_list(term, lv);
+
+		scores.clear();
+		for(auto it = pl.begin(); it != pl.end(); ++it)
+			scores.push_back(pl.score(it, bm25_scorer));
+
+		// The k-th best score of the term, short lists are kept whole
+		sindex::score_t threshold = options.global_threshold;
+		if(scores.size() > options.k)
+		{
+			auto kth_scores = scores;
+			std::nth_element(kth_scores.begin(), kth_scores.begin() + (options.k - 1), kth_scores.end(), std::greater<>());
+			threshold = std::max(threshold, options.epsilon * kth_scores[options.k - 1]);
+		}
+
+		sindex::score_t dropped_bound = 0;
+		size_t i = 0;
+		for(auto it = pl.begin(); it != pl.end(); ++it, ++i)
+		{
+			if(scores[i] < threshold)
+			{
+				dropped_bound = std::max(dropped_bound, scores[i]);
+				continue;
+			}
+
+			index_builder.add_to_post(term, it->first, it->second);
+			chunk_kept_postings += 1;
+		}
+
+		chunk_postings += scores.size();
+		if(dropped_bound > 0)
+			chunk_bounds[term] = dropped_bound;
+	}
+
+	std::filesystem::create_directory(out_db);
+	auto pl_docids = std::ofstream(out_db/"posting_lists_docids", std::ios_base::binary);
+	auto pl_freqs = std::ofstream(out_db/"posting_lists_freqs", std::ios_base::binary);
+	auto lexicon = std::ofstream(out_db/"lexicon_temp", std::ios_base::binary);
+	auto doc_index = std::ofstream(out_db/"document_index", std::ios_base::binary);
+	index_builder.write_to_disk(pl_docids, pl_freqs, lexicon, doc_index);
+
+	// The tier 0 keeps the deleted documents out of the results too
+	if(std::filesystem::exists(in_db/"deleted"))
+		std::filesystem::copy_file(in_db/"deleted", out_db/"deleted");
+
+	n_postings += chunk_postings;
+	n_kept_postings += chunk_kept_postings;
+
+	std::lock_guard<std::mutex> guard(pruned_bounds_mutex);
+	for(const auto& [term, bound] : chunk_bounds)
+		pruned_bounds[term] = std::max(pruned_bounds[term], bound);
+}
+
+int main(int argc, char** argv)
+{
+	using namespace std::chrono_literals;
+
+	const pruner_options options(argc, argv);
+	const auto& in_dir = options.in_dir;
+	const auto& out_dir = options.out_dir;
+
+	if(not std::filesystem::exists(in_dir))
+	{
+		std::cerr << "Data dir " << in_dir << " does not exist" << std::endl;
+		return -1;
+	}
+
+	if(options.k == 0 or options.epsilon < 0 or options.epsilon > 1)
+	{
+		std::cerr << "Epsilon must be in [0, 1] and k must be positive" << std::endl;
+		return -1;
+	}
+
+	memory_mmap metadata_mem(in_dir/"metadata");
+	memory_mmap global_lexicon_mem(in_dir/"global_lexicon");
+	sindex::Index<sindex::SigmaLexiconValue>::global_lexicon_t global_lexicon(global_lexicon_mem);
+
+	// We need the term frequencies to write the tier 0 in the same format
+	if(sindex::CollectionMetadata::read(metadata_mem).quantized)
+	{
+		std::cerr << "The index stores quantized impacts in place of the term frequencies, "
+				  << "prune an index built without `--quantized`" << std::endl;
+		return -1;
+	}
+
+	if(std::filesystem::exists(out_dir))
+		std::filesystem::remove_all(out_dir);
+	std::filesystem::create_directory(out_dir);
+
+	// Same collection statistics, so the scores of the tier 0 are the ones of the full index
+	std::filesystem::copy_file(in_dir/"metadata", out_dir/"metadata");
+	std::filesystem::copy_file(in_dir/"global_lexicon", out_dir/"global_lexicon");
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	std::vector<std::filesystem::path> out_dbs;
+	thread_pool pool(4);
+	for (auto const& dir_entry : std::filesystem::directory_iterator(in_dir))
+	{
+		if(not dir_entry.is_directory())
+			continue;
+
+		const auto out_db = out_dir/dir_entry.path().filename();
+		out_dbs.push_back(out_db);
+
+		pool.wait_for_free_worker();
+		pool.add_job([in_db = dir_entry.path(), out_db, &metadata_mem, &global_lexicon, &options] {
+			prune_chunk(in_db, out_db, metadata_mem, global_lexicon, options);
+		});
+	}
+	pool.wait_all_jobs();
+
+	const auto stop_time_1 = std::chrono::steady_clock::now();
+	std::cout << "Pruned " << out_dbs.size() << " chunks in " << (stop_time_1 - start_time) / 1.0s << "s, kept "
+			  << n_kept_postings << " postings out of " << n_postings << std::endl;
+
+	// Create skip-list and compute their sigma
+	for(const auto& path : out_dbs)
+	{
+		pool.wait_for_free_worker();
+		pool.add_job([path] {
+			write_sigma_lexicon(path, false, false);
+		});
+	}
+	pool.wait_all_jobs();
+
+	// One bound per term of the collection, 0 if none of its postings was dropped
+	std::ofstream bounds_teletype(out_dir/"pruned_bounds", std::ios::binary);
+	codes::disk_map_writer<uint64_t> bounds_writer(bounds_teletype);
+	for(const auto& [term, n_docs] : global_lexicon)
+	{
+		auto it = pruned_bounds.find(term);
+		const sindex::score_t bound = it == pruned_bounds.end() ? 0 : it->second;
+		bounds_writer.add(term, static_cast<uint64_t>(std::ceil(bound * sindex::SigmaLexiconValue::fixed_point_factor)));
+	}
+	bounds_writer.finalize();
+
+	const auto stop_time = std::chrono::steady_clock::now();
+	std::cout << "Re-built local lexica in " << (stop_time - stop_time_1) / 1.0s << "s" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "index/types.hpp"
+#include "index/Index.hpp"
+#include "index/query_scorer.hpp"
+#include "index/metadata.hpp"
+#include "index_worker.hpp"
+#include "indexBuilder/IndexBuilder.hpp"
+#include "indexBuilder/chunks.hpp"
+#include "indexBuilder/sigma_lexicon.hpp"
+#include "util/thread_pool.hpp"
+#include "util/resharder_options.hpp"
+
+/*
+ * Resharding: the resharder reads an index written by the builder, whose chunks are cut by the size of the input, and
+ * writes the same collection in a given number of chunks. The posting lists, the document indices and the lexica of
+ * the old chunks are merged, or split, into the new ones, which cover contiguous docid ranges of about the same total
+ * documents' length. Deleted documents are dropped and the docids are reassigned from 1. The skip lists and the sigmas
+ * are then computed again, as the builder does. A tier 0 written by the pruner keeps the statistics of its full index.
+ */
+
+// At most one thread should write on disk at a given time
+std::mutex disk_writer_mutex;
+
+std::atomic<size_t> n_dropped_docs = 0;
+std::atomic<sindex::doclen_t> dropped_len = 0;
+
+/**
+ * The docid ranges of the new chunks, cut so that their live documents have about the same total length, that is
+ * about the same number of postings
+ * @return the first docid of each new chunk, and one past the last docid of the collection
+ */
+static std::vector<sindex::docid_t> cut_chunks(const source_chunks_t& chunks, unsigned n_chunks)
+{
+	uint64_t total_len = 0;
+	for(const auto& chunk : chunks)
+		for(sindex::docid_t docid = chunk.index.get_base_docid(); docid < chunk.index.get_base_docid() + chunk.index.get_n_local_docs(); ++docid)
+			if(not chunk.index.is_deleted(docid))
+				total_len += chunk.index.get_document_info(docid).lenght;
+
+	std::vector<sindex::docid_t> bounds = {chunks.front().index.get_base_docid()};
+	uint64_t len = 0;
+	for(const auto& chunk : chunks)
+		for(sindex::docid_t docid = chunk.index.get_base_docid(); docid < chunk.index.get_base_docid() + chunk.index.get_n_local_docs(); ++docid)
+		{
+			if(chunk.index.is_deleted(docid))
+				continue;
+
+			len += chunk.index.get_document_info(docid).lenght;
+			if(bounds.size() < n_chunks and len * n_chunks >= total_len * bounds.size())
+				bounds.push_back(docid + 1);
+		}
+
+	const auto& last = chunks.back().index;
+	bounds.push_back(last.get_base_docid() + last.get_n_local_docs());
+
+	// With fewer documents than chunks, or a very long document, some ranges may be empty
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+	return bounds;
+}
+
+int main(int argc, char** argv)
+{
+	using namespace std::chrono_literals;
+
+	const resharder_options options(argc, argv);
+	const auto& in_dir = options.in_dir;
+	const auto& out_dir = options.out_dir;
+
+	if(not std::filesystem::exists(in_dir))
+	{
+		std::cerr << "Data dir " << in_dir << " does not exist" << std::endl;
+		return -1;
+	}
+
+	if(std::filesystem::exists(out_dir) and std::filesystem::equivalent(in_dir, out_dir))
+	{
+		std::cerr << "The resharded index must be written in another directory" << std::endl;
+		return -1;
+	}
+
+	memory_mmap metadata_mem(in_dir/"metadata");
+	memory_mmap global_lexicon_mem(in_dir/"global_lexicon");
+	sindex::Index<sindex::LexiconValue>::global_lexicon_t global_lexicon(global_lexicon_mem);
+	const auto metadata = sindex::CollectionMetadata::read(metadata_mem);
+
+	const auto chunks = list_chunks(in_dir);
+	if(chunks.empty())
+	{
+		std::cerr << "Data dir " << in_dir << " has no index chunks" << std::endl;
+		return -1;
+	}
+
+	// All the posting lists are read once per new chunk they end up in, in order
+	source_chunks_t source_chunks;
+	for(const auto& chunk : chunks)
+		source_chunks.emplace_back(chunk.path, metadata_mem, global_lexicon, "lexicon_temp", 0, index_mmap_policy::sequential());
+
+	// A tier 0 keeps the full index's statistics, its bounds are scores computed with them: it can't drop documents
+	const bool tier0 = std::filesystem::exists(in_dir/"pruned_bounds");
+	if(tier0)
+	{
+		size_t n_chunk_docs = 0;
+		for(const auto& chunk : chunks)
+			n_chunk_docs += chunk.n_docs;
+
+		const auto& last = chunks.back();
+		if(count_live_documents(source_chunks, chunks.front().base_docid, last.base_docid + last.n_docs) < n_chunk_docs)
+		{
+			std::cerr << "The tier 0 has deleted documents, dropping them would change its statistics. "
+					  << "Prune the resharded full index instead" << std::endl;
+			return -1;
+		}
+	}
+
+	// The new chunks have the same files of the old ones
+	const bool positions = source_chunks.front().index.has_positions();
+	const bool impact_ordered = std::filesystem::exists(chunks.front().path/"lexicon_impact_ordered");
+
+	if(std::filesystem::exists(out_dir))
+		std::filesystem::remove_all(out_dir);
+	std::filesystem::create_directory(out_dir);
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	const auto bounds = cut_chunks(source_chunks, options.n_chunks);
+	std::vector<std::filesystem::path> out_dbs;
+	sindex::docid_t new_base = 1;
+	thread_pool pool(4);
+	for(size_t i = 0; i + 1 < bounds.size(); ++i)
+	{
+		const auto out_db = out_dir/("db_" + std::to_string(i));
+		out_dbs.push_back(out_db);
+
+		const sindex::docid_t first = bounds[i], last = bounds[i + 1];
+		const size_t n_live_docs = count_live_documents(source_chunks, first, last);
+
+		pool.wait_for_free_worker();
+		pool.add_job([first, last, n_live_docs, new_base, out_db, positions, &source_chunks] {
+			sindex::IndexBuilder index_builder(n_live_docs, new_base);
+			const auto [dropped_docs, dropped_docs_len] = copy_documents(source_chunks, first, last, index_builder, new_base, positions);
+			n_dropped_docs += dropped_docs;
+			dropped_len += dropped_docs_len;
+
+			std::lock_guard<std::mutex> guard(disk_writer_mutex);
+			write_chunk(index_builder, out_db, positions);
+		});
+
+		new_base += n_live_docs;
+	}
+	pool.wait_all_jobs();
+
+	const auto stop_time_1 = std::chrono::steady_clock::now();
+	std::cout << "Wrote " << out_dbs.size() << " chunks from " << chunks.size() << " in "
+			  << (stop_time_1 - start_time) / 1.0s << "s, dropped " << n_dropped_docs << " deleted documents" << std::endl;
+
+	if(tier0)
+	{
+		// The tier 0's lexica only count the kept postings, its statistics and bounds are the full index's ones
+		std::filesystem::copy_file(in_dir/"global_lexicon", out_dir/"global_lexicon");
+		std::filesystem::copy_file(in_dir/"metadata", out_dir/"metadata");
+		std::filesystem::copy_file(in_dir/"pruned_bounds", out_dir/"pruned_bounds");
+	}
+	else
+	{
+		// The statistics change only if deleted documents were dropped
+		write_global_lexicon(out_dir, out_dbs);
+
+		const size_t n_docs = new_base - 1;
+		const sindex::CollectionMetadata new_metadata = {
+			.doc_len_sum = metadata.doc_len_sum - dropped_len,
+			.n_docs = n_docs,
+			.impact_upper_bound = sindex::QueryTFIDFScorer::idf(n_docs, 1),
+			.quantized = metadata.quantized
+		};
+		std::ofstream metadata_teletype(out_dir/"metadata", std::ios::binary);
+		new_metadata.write(metadata_teletype);
+		metadata_teletype.close();
+	}
+
+	// Create skip-list and compute their sigma
+	for(const auto& path : out_dbs)
+	{
+		pool.wait_for_free_worker();
+		pool.add_job([path, impact_ordered, &metadata] {
+			write_sigma_lexicon(path, impact_ordered, metadata.quantized);
+		});
+	}
+	pool.wait_all_jobs();
+
+	const auto stop_time = std::chrono::steady_clock::now();
+	std::cout << "Re-built local lexica in " << (stop_time - stop_time_1) / 1.0s << "s" << std::endl;
+
+	return 0;
+}
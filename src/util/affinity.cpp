@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <string>
+#include "affinity.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+std::vector<int> allowed_cpus()
+{
+	std::vector<int> cpus;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(set), &set) == 0)
+		for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			if(CPU_ISSET(cpu, &set))
+				cpus.push_back(cpu);
+#endif
+
+	// Unknown topology, assume the CPUs are numbered from 0
+	if(cpus.empty())
+		for(unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+			cpus.push_back(cpu);
+
+	return cpus;
+}
+
+int cpu_numa_node(int cpu)
+{
+#ifdef __linux__
+	// The kernel links the CPU's node as a nodeN entry of its sysfs dir
+	const std::filesystem::path cpu_dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+	std::error_code ec;
+	for(const auto& entry : std::filesystem::directory_iterator(cpu_dir, ec))
+	{
+		const auto name = entry.path().filename().string();
+		if(name.size() > 4 and name.starts_with("node") and std::isdigit((unsigned char)name[4]))
+			return std::stoi(name.substr(4));
+	}
+#else
+	(void)cpu;
+#endif
+
+	return -1;
+}
+
+bool pin_thread(std::thread& thread, int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+	(void)thread; (void)cpu;
+	return false;
+#endif
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+
+/*
+ * CPU affinity helpers. They're only implemented on Linux, elsewhere threads are never pinned and the topology is
+ * unknown.
+ */
+
+/** The CPUs this process is allowed to run on, in increasing order */
+std::vector<int> allowed_cpus();
+
+/** The NUMA node of a CPU, -1 if unknown */
+int cpu_numa_node(int cpu);
+
+/**
+ * Restricts a thread to one CPU
+ * @return false if the thread could not be pinned
+ */
+bool pin_thread(std::thread& thread, int cpu);
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "block_cache.hpp"
+#include "io_ring.hpp"
+
+memory_block_cache::pin& memory_block_cache::pin::operator=(pin&& other) noexcept
+{
+	if(this != &other)
+	{
+		if(cache)
+			cache->release(first_block, last_block);
+
+		cache = other.cache;
+		first_block = other.first_block;
+		last_block = other.last_block;
+		other.cache = nullptr;
+	}
+
+	return *this;
+}
+
+memory_block_cache::pin::~pin()
+{
+	if(cache)
+		cache->release(first_block, last_block);
+}
+
+memory_block_cache::memory_block_cache(const std::string& filename, size_t capacity):
+	capacity(capacity)
+{
+	fd = open(filename.c_str(), O_RDONLY);
+
+	struct stat st{};
+	if(fd == -1 or fstat(fd, &st) == -1)
+		abort();
+
+	buff_size = st.st_size;
+	blocks.resize((buff_size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+	// Only address space: the memory is allocated when a block is read in, and given back when it's evicted
+	buff = (uint8_t *)mmap(nullptr, std::max<size_t>(buff_size, 1), PROT_READ | PROT_WRITE,
+						   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(buff == MAP_FAILED)
+		abort();
+}
+
+memory_block_cache::~memory_block_cache()
+{
+	munmap(buff, std::max<size_t>(buff_size, 1));
+	close(fd);
+}
+
+std::pair<uint8_t *, size_t> memory_block_cache::get() const
+{
+	return {buff, buff_size};
+}
+
+std::vector<memory_block_cache::pin> memory_block_cache::acquire(const std::vector<std::pair<size_t, size_t>>& ranges)
+{
+	std::vector<pin> pins;
+	pins.reserve(ranges.size());
+	std::vector<size_t> to_load;
+
+	std::unique_lock lock(mutex);
+
+	// Pin everything, claim the missing blocks
+	for(const auto& [offset, length] : ranges)
+	{
+		if(length == 0 or offset >= buff_size)
+		{
+			pins.emplace_back();
+			continue;
+		}
+
+		const size_t first_block = offset / BLOCK_SIZE;
+		const size_t last_block = (std::min(offset + length, buff_size) - 1) / BLOCK_SIZE;
+		for(size_t b = first_block; b <= last_block; ++b)
+		{
+			auto& block = blocks[b];
+			if(block.pins++ == 0 and block.state == LOADED)
+				lru.erase(block.lru_it);
+
+			if(block.state == EMPTY)
+			{
+				block.state = LOADING;
+				to_load.push_back(b);
+				n_misses += 1;
+			}
+			else
+				n_hits += 1;
+		}
+
+		pins.emplace_back(this, first_block, last_block);
+	}
+
+	// The I/O is done without the lock, other readers may load other blocks meanwhile
+	if(not to_load.empty())
+	{
+		lock.unlock();
+		std::sort(to_load.begin(), to_load.end());
+		load(to_load);
+		lock.lock();
+
+		for(auto b : to_load)
+		{
+			blocks[b].state = LOADED;
+			loaded_bytes += block_length(b);
+		}
+
+		loaded_cv.notify_all();
+		evict();
+	}
+
+	// Some blocks may be loaded by other readers
+	loaded_cv.wait(lock, [&] {
+		for(const auto& [offset, length] : ranges)
+			if(length != 0 and offset < buff_size)
+				for(size_t b = offset / BLOCK_SIZE; b <= (std::min(offset + length, buff_size) - 1) / BLOCK_SIZE; ++b)
+					if(blocks[b].state != LOADED)
+						return false;
+		return true;
+	});
+
+	return pins;
+}
+
+void memory_block_cache::load(const std::vector<size_t>& to_load)
+{
+	// One ring per thread, rings can't be shared
+	static thread_local io_ring ring;
+
+	std::vector<read_request> reqs;
+	for(size_t i = 0; i < to_load.size();)
+	{
+		// A run of consecutive blocks
+		size_t j = i + 1;
+		while(j < to_load.size() and to_load[j] == to_load[j - 1] + 1)
+			++j;
+
+		const size_t offset = to_load[i] * BLOCK_SIZE;
+		const size_t end = to_load[j - 1] * BLOCK_SIZE + block_length(to_load[j - 1]);
+		reqs.push_back({buff + offset, end - offset, (off_t)offset});
+		i = j;
+	}
+
+	// The index is unusable if it can't be read
+	if(not ring.read(fd, reqs))
+		abort();
+}
+
+void memory_block_cache::evict()
+{
+	while(loaded_bytes > capacity and not lru.empty())
+	{
+		const size_t b = lru.front();
+		lru.pop_front();
+
+		// The pages go back to the system, they read as zeros until the block is loaded again
+		madvise(buff + b * BLOCK_SIZE, block_length(b), MADV_DONTNEED);
+		blocks[b].state = EMPTY;
+		loaded_bytes -= block_length(b);
+		n_evictions += 1;
+	}
+}
+
+void memory_block_cache::release(size_t first_block, size_t last_block)
+{
+	std::lock_guard guard(mutex);
+	for(size_t b = first_block; b <= last_block; ++b)
+	{
+		auto& block = blocks[b];
+		if(--block.pins == 0 and block.state == LOADED)
+			block.lru_it = lru.insert(lru.end(), b);
+	}
+
+	evict();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "memory.hpp"
+
+/**
+ * A file read into a user-space cache of fixed-size blocks, an alternative to memory_mmap for files larger than the
+ * memory. The file's address space is reserved as anonymous memory and the blocks are read into it explicitly,
+ * through io_uring when available, so that a miss never becomes a page fault on the reader's thread.
+ * Only the pinned blocks can be read: acquire() loads the ranges a reader needs, all of them with one batch of reads,
+ * and pins them until the returned pins are destroyed. The least recently used unpinned blocks are evicted as soon as
+ * the loaded ones exceed the capacity.
+ */
+class memory_block_cache: public memory_area
+{
+public:
+	static constexpr size_t BLOCK_SIZE = 1 << 16;
+
+	/** Keeps a range of blocks loaded, it's released when destroyed */
+	class pin
+	{
+		memory_block_cache *cache = nullptr;
+		size_t first_block = 0, last_block = 0;
+
+	public:
+		pin() = default;
+		pin(memory_block_cache *cache, size_t first_block, size_t last_block):
+				cache(cache), first_block(first_block), last_block(last_block) {}
+		pin(pin&& other) noexcept {*this = std::move(other);}
+		pin& operator=(pin&& other) noexcept;
+		~pin();
+	};
+
+private:
+	enum block_state_t: uint8_t {EMPTY, LOADING, LOADED};
+
+	struct block_t
+	{
+		block_state_t state = EMPTY;
+		uint32_t pins = 0;
+		// Position in the LRU list, only meaningful for the loaded and unpinned blocks
+		std::list<size_t>::iterator lru_it;
+	};
+
+	int fd;
+	uint8_t *buff;
+	size_t buff_size;
+	size_t capacity;
+	size_t loaded_bytes = 0;
+
+	std::vector<block_t> blocks;
+	// Loaded and unpinned blocks, least recently used first
+	std::list<size_t> lru;
+
+	std::mutex mutex;
+	std::condition_variable loaded_cv;
+
+	std::atomic<size_t> n_hits = 0;
+	std::atomic<size_t> n_misses = 0;
+	std::atomic<size_t> n_evictions = 0;
+
+	size_t block_length(size_t block) const {return std::min(BLOCK_SIZE, buff_size - block * BLOCK_SIZE);}
+
+	/** Reads the blocks from the file, runs of consecutive blocks with one request */
+	void load(const std::vector<size_t>& to_load);
+	/** Must be called with the lock held */
+	void evict();
+	void release(size_t first_block, size_t last_block);
+
+public:
+	/**
+	 * @param filename the file to read
+	 * @param capacity bytes of loaded blocks to keep, the pinned blocks may exceed it
+	 */
+	memory_block_cache(const std::string& filename, size_t capacity);
+	~memory_block_cache() override;
+
+	memory_block_cache(const memory_block_cache&) = delete;
+	memory_block_cache& operator=(const memory_block_cache&) = delete;
+
+	std::pair<uint8_t *, size_t> get() const override;
+
+	/**
+	 * Loads the <offset, length> ranges, with one batch of reads for all the missing blocks, and pins them
+	 * @return one pin per range
+	 */
+	std::vector<pin> acquire(const std::vector<std::pair<size_t, size_t>>& ranges);
+
+	size_t hits() const {return n_hits;}
+	size_t misses() const {return n_misses;}
+	size_t evictions() const {return n_evictions;}
+};
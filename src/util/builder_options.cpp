@@ -0,0 +1,69 @@
+#include <unistd.h>
+#include <getopt.h>
+#include "builder_options.hpp"
+
+// Used to tweak the builder's behaviour based on command line arguments
+builder_options::builder_options(int argc, char **argv)
+{
+	static const option long_options[] = {
+			/*   NAME       ARGUMENT           FLAG  SHORTNAME */
+			{"impact-ordered",	no_argument,       nullptr, 'i'},
+			{"quantized",	no_argument,       nullptr, 'q'},
+			{"positions",	no_argument,       nullptr, 'P'},
+			{"reorder",	required_argument, nullptr, 'r'},
+			{"quality",	required_argument, nullptr, 'Q'},
+			{"trace",	required_argument, nullptr, 'X'},
+			{"append",	no_argument,       nullptr, 'a'},
+			{"delete",	required_argument, nullptr, 'D'},
+			{"merge-factor",	required_argument, nullptr, 'm'},
+			{nullptr, 0, nullptr, 0}
+	};
+
+	int c;
+	int option_index = 0;
+	while ((c = getopt_long(argc, argv, "iqPr:Q:X:aD:m:", long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+		case 'i':
+			impact_ordered = true;
+			break;
+		case 'q':
+			quantized = true;
+			break;
+		case 'P':
+			positions = true;
+			break;
+		case 'X':
+			trace_file = optarg;
+			break;
+		case 'r':
+			if(optarg == std::string("bp"))
+				reorder = BP;
+			else if(optarg == std::string("docno"))
+				reorder = DOCNO;
+			else if(optarg == std::string("quality"))
+				reorder = QUALITY;
+			else
+				reorder = NONE;
+			break;
+		case 'Q':
+			quality_file = optarg;
+			break;
+		case 'a':
+			append = true;
+			break;
+		case 'D':
+			delete_file = optarg;
+			break;
+		case 'm':
+			merge_factor = std::stoul(optarg);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if(optind < argc)
+		out_dir = argv[optind];
+}
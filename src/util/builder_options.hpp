@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <filesystem>
+
+struct builder_options
+{
+	// How the documents of a chunk are reordered before the docids are assigned
+	enum reorder_t {NONE, BP, DOCNO, QUALITY};
+
+	std::filesystem::path out_dir = "data";
+	bool impact_ordered = false;
+	bool quantized = false;
+	bool positions = false;
+	reorder_t reorder = NONE;
+	// Lines of docno\tscore, used by the QUALITY reordering
+	std::filesystem::path quality_file;
+	// Where to write the trace of the build, empty to disable it. Only if tracing is compiled in
+	std::filesystem::path trace_file;
+	// Add the documents to the index in out_dir, instead of building it from scratch
+	bool append = false;
+	// Lines of docno, the documents to delete from the index. Only when appending
+	std::filesystem::path delete_file;
+	// How many chunks of the same tier the incremental builds merge, less than 2 to never merge them
+	unsigned merge_factor = 4;
+
+	builder_options(int argc, char **argv);
+};
+
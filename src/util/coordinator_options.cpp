@@ -0,0 +1,50 @@
+#include <unistd.h>
+#include <getopt.h>
+#include "coordinator_options.hpp"
+
+// Used to tweak the coordinator's behaviour based on command line arguments
+coordinator_options::coordinator_options(int argc, char **argv)
+{
+	static const option long_options[] = {
+			/*   NAME       ARGUMENT           FLAG  SHORTNAME */
+			{"top-k",	required_argument, nullptr, 'k'},
+			{"run-name",	required_argument, nullptr, 'r'},
+			{"batch",	no_argument,       nullptr, 'b'},
+			{"probes",	required_argument, nullptr, 'p'},
+			{"timeout",	required_argument, nullptr, 'd'},
+			{"serve",	required_argument, nullptr, 'S'},
+			{nullptr, 0, nullptr, 0}
+	};
+
+	int c;
+	int option_index = 0;
+	while ((c = getopt_long(argc, argv, "k:r:p:d:S:b", long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+		case 'k':
+			k = std::stoi(optarg);
+			break;
+		case 'r':
+			run_name = optarg;
+			break;
+		case 'b':
+			batch_mode = true;
+			break;
+		case 'p':
+			probes = std::stoul(optarg);
+			break;
+		case 'd':
+			timeout = std::chrono::milliseconds(std::stoul(optarg));
+			break;
+		case 'S':
+			serve_address = optarg;
+			break;
+		default:
+			break;
+		}
+	}
+
+	while(optind < argc)
+		shards.emplace_back(argv[optind++]);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+
+struct coordinator_options
+{
+	unsigned k = 10;
+	std::string run_name = "MIRCV0";
+	bool batch_mode = false;
+	// The engines serving the shards, in order: Unix sockets' paths or `tcp:PORT`
+	std::vector<std::string> shards;
+	// Shards asked before the others, their k-th score is the others' threshold. 0 to ask all of them at once
+	size_t probes = 1;
+	// How long to wait for a shard's results before leaving it out of the query, 0 to wait forever
+	std::chrono::milliseconds timeout{0};
+	// Serve the queries over a socket instead of reading them from stdin, as the engine does
+	std::string serve_address;
+
+	coordinator_options(int argc, char **argv);
+};
@@ -1,7 +1,33 @@
 #include <unistd.h>
 #include <getopt.h>
+#include <iostream>
+#include <algorithm>
 #include "engine_options.hpp"
 
+// Parses a `class=policy` argument, the policy replaces the class's default one
+void engine_options::parse_mmap_policy(const std::string& arg)
+{
+	const auto eq = arg.find('=');
+	const auto file_class = arg.substr(0, eq);
+
+	mmap_policy *policy = nullptr;
+	if(file_class == "lexicon")
+		policy = &mmap_policies.lexicon;
+	else if(file_class == "document-index")
+		policy = &mmap_policies.document_index;
+	else if(file_class == "postings")
+		policy = &mmap_policies.postings;
+
+	mmap_policy parsed;
+	if(not policy or eq == std::string::npos or not mmap_policy::parse(arg.substr(eq + 1), parsed))
+	{
+		std::cerr << "Ignoring invalid mmap policy " << arg << std::endl;
+		return;
+	}
+
+	*policy = parsed;
+}
+
 // Used to tweak the engine's behaviour based on command line arguments
 engine_options::engine_options(int argc, char **argv)
 {
@@ -13,12 +39,30 @@ engine_options::engine_options(int argc, char **argv)
 			{"batch",	no_argument,       nullptr, 'b'},
 			{"threads",	required_argument, nullptr, 't'},
 			{"score",	required_argument, nullptr, 's'},
+			{"postings-budget",	required_argument, nullptr, 'p'},
+			{"cache-size",	required_argument, nullptr, 'c'},
+			{"pair-cache-size",	required_argument, nullptr, 'C'},
+			{"tier0",	required_argument, nullptr, 'T'},
+			{"in-flight",	required_argument, nullptr, 'w'},
+			{"pin",	no_argument,       nullptr, 'P'},
+			{"readahead",	required_argument, nullptr, 'R'},
+			{"block-cache",	required_argument, nullptr, 'B'},
+			{"mmap",	required_argument, nullptr, 'm'},
+			{"serve",	required_argument, nullptr, 'S'},
+			{"metrics",	required_argument, nullptr, 'M'},
+			{"metrics-format",	required_argument, nullptr, 'F'},
+			{"metrics-interval",	required_argument, nullptr, 'I'},
+			{"trace",	required_argument, nullptr, 'X'},
+			{"explain",	no_argument,       nullptr, 'E'},
+			{"deadline",	required_argument, nullptr, 'd'},
+			{"shed-load",	required_argument, nullptr, 'l'},
+			{"shard",	required_argument, nullptr, 'n'},
 			{nullptr, 0, nullptr, 0}
 	};
 
 	int c;
 	int option_index = 0;
-	while ((c = getopt_long(argc, argv, "k:r:a:t:s:b", long_options, &option_index)) != -1)
+	while ((c = getopt_long(argc, argv, "k:r:a:t:s:p:c:C:T:w:R:B:m:S:M:F:I:X:d:l:n:bPE", long_options, &option_index)) != -1)
 	{
 		switch (c)
 		{
@@ -35,12 +79,76 @@ engine_options::engine_options(int argc, char **argv)
 				algorithm = DAAT_CONJUNCTIVE;
 			else if(optarg == std::string("bmm"))
 				algorithm = BMM;
+			else if(optarg == std::string("saat"))
+				algorithm = SAAT;
+			else if(optarg == std::string("bmand") or optarg == std::string("bmm-c"))
+				algorithm = BMAND;
 			else
 				algorithm = DAAT_DISJUNCTIVE;
 			break;
 		case 'b':
 			batch_mode = true;
 			break;
+		case 'P':
+			pinned = true;
+			break;
+		case 'R':
+			readahead_size = std::stoul(optarg) << 10;
+			break;
+		case 'B':
+			block_cache_size = std::stoul(optarg) << 20;
+			break;
+		case 'm':
+			parse_mmap_policy(optarg);
+			break;
+		case 'S':
+			serve_address = optarg;
+			break;
+		case 'M':
+			metrics_path = optarg;
+			break;
+		case 'F':
+			if(optarg == std::string("prometheus"))
+				metrics_format = query_metrics::PROMETHEUS;
+			else // assume JSON
+				metrics_format = query_metrics::JSON;
+			break;
+		case 'I':
+			metrics_interval = std::stoul(optarg);
+			break;
+		case 'X':
+			trace_file = optarg;
+			break;
+		case 'E':
+			explain = true;
+			break;
+		case 'd':
+			deadline = std::chrono::microseconds((long long)(std::stod(optarg) * 1000));
+			break;
+		case 'l':
+			shed_load = std::stoul(optarg);
+			break;
+		case 'n':
+		{
+			// I/N
+			const std::string arg = optarg;
+			const auto slash = arg.find('/');
+			if(slash == std::string::npos)
+			{
+				std::cerr << "Ignoring invalid shard " << arg << ", expected I/N" << std::endl;
+				break;
+			}
+
+			shard = std::stoul(arg.substr(0, slash));
+			n_shards = std::max(1ul, std::stoul(arg.substr(slash + 1)));
+			if(shard >= n_shards)
+			{
+				std::cerr << "Ignoring invalid shard " << arg << ", I must be less than N" << std::endl;
+				shard = 0;
+				n_shards = 1;
+			}
+			break;
+		}
 		case 't':
 			thread_count = std::stoi(optarg);
 			break;
@@ -50,11 +158,30 @@ engine_options::engine_options(int argc, char **argv)
 			else // assume BM25
 				score = BM25;
 			break;
+		case 'p':
+			postings_budget = std::stoul(optarg);
+			break;
+		case 'c':
+			cache_size = std::stoul(optarg) << 20;
+			break;
+		case 'C':
+			pair_cache_size = std::stoul(optarg) << 20;
+			break;
+		case 'T':
+			tier0_dir = optarg;
+			break;
+		case 'w':
+			in_flight = std::stoul(optarg);
+			break;
 		default:
 			break;
 		}
 	}
 
+	// By default there are enough queries to keep all the workers busy
+	if(in_flight == 0)
+		in_flight = 2 * thread_count;
+
 	if(optind < argc)
 		data_dir = argv[optind];
 }
@@ -1,10 +1,13 @@
 #pragma once
 #include <string>
 #include <filesystem>
+#include <chrono>
+#include "memory.hpp"
+#include "metrics.hpp"
 
 struct engine_options
 {
-	enum algorithm_t {DAAT_DISJUNCTIVE, DAAT_CONJUNCTIVE, BMM};
+	enum algorithm_t {DAAT_DISJUNCTIVE, DAAT_CONJUNCTIVE, BMM, SAAT, BMAND};
 	enum score_t {BM25, TFIDF};
 
 	unsigned k = 10;
@@ -14,7 +17,53 @@ struct engine_options
 	std::filesystem::path data_dir = "data";
 	unsigned thread_count = 1;
 	score_t score = BM25;
+	// Postings each index chunk may score for a query, 0 for no limit. The results of the stopped queries are approximate
+	size_t postings_budget = 0;
+	// How long a query may take, from its arrival, before its chunks return what they found so far. 0 for no deadline
+	std::chrono::microseconds deadline{0};
+	// When more than this many queries are in flight, the new ones drop their lowest-idf terms. 0 to never drop them
+	size_t shed_load = 0;
+	// Bytes of the query result cache, 0 to disable it
+	size_t cache_size = 0;
+	// Bytes of the cache of the term pairs' intersections, shared among the index chunks. 0 to disable it
+	size_t pair_cache_size = 0;
+	// Index written by the pruner, queried before the full one. Empty to disable it
+	std::filesystem::path tier0_dir;
+	// Queries solved concurrently in batch mode, their results are still printed in input order
+	size_t in_flight = 0;
+	// Pin the workers to the CPUs and run each index chunk's tasks on its own worker
+	bool pinned = false;
+	// Bytes read ahead from the start of each posting list of a query, 0 to disable the readahead
+	size_t readahead_size = 0;
+	// Bytes of the block caches the posting lists are read through in place of mapping them, 0 to map them
+	size_t block_cache_size = 0;
+	// How the index's files are kept in memory. Lexica and document index are read with point lookups
+	index_mmap_policy mmap_policies = {
+			.lexicon = {.access = mmap_policy::RANDOM},
+			.document_index = {.access = mmap_policy::RANDOM},
+			.postings = {}
+	};
+
+	// Load only the chunks whose position, in the order of their names, is shard modulo n_shards. A coordinator fans
+	// the queries out to the engines of all the shards
+	unsigned shard = 0;
+	unsigned n_shards = 1;
+
+	// Serve the queries over a socket instead of reading them from stdin: a Unix socket's path or `tcp:PORT`
+	std::string serve_address;
+	// Where the latency metrics are written at the end, on SIGUSR1 and periodically. Empty for stderr, on SIGUSR1 only
+	std::string metrics_path;
+	query_metrics::format_t metrics_format = query_metrics::JSON;
+	// Seconds between the periodic dumps of the metrics, 0 to disable them
+	unsigned metrics_interval = 0;
+	// Where to write the trace of the queries, empty to disable it. Only if tracing is compiled in
+	std::filesystem::path trace_file;
+	// Print the work done by each query: postings decoded and blocks skipped per term, postings scored, heap updates
+	bool explain = false;
 
 	engine_options(int argc, char **argv);
+
+private:
+	void parse_mmap_policy(const std::string& arg);
 };
 
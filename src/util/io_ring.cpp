@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "io_ring.hpp"
+
+#ifdef SEARCHENGINECPP_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+bool pread_full(int fd, uint8_t *buff, size_t length, off_t offset)
+{
+	while(length > 0)
+	{
+		const auto ret = pread(fd, buff, length, offset);
+		if(ret < 0 and errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return false;
+
+		buff += ret;
+		length -= ret;
+		offset += ret;
+	}
+
+	return true;
+}
+
+#ifdef SEARCHENGINECPP_IO_URING
+
+io_ring::io_ring(unsigned entries)
+{
+	io_uring_params params{};
+	ring_fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if(ring_fd < 0)
+		return;
+
+	sq_entries = params.sq_entries;
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+	// Newer kernels map both rings at once
+	const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if(single_mmap)
+		sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+	sq_ptr = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	cq_ptr = single_mmap ? sq_ptr :
+			mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+	sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+	if(sq_ptr == MAP_FAILED or cq_ptr == MAP_FAILED or sqes == MAP_FAILED)
+	{
+		if(sqes != MAP_FAILED)
+			munmap(sqes, sqes_size);
+		if(cq_ptr != MAP_FAILED and cq_ptr != sq_ptr)
+			munmap(cq_ptr, cq_ring_size);
+		if(sq_ptr != MAP_FAILED)
+			munmap(sq_ptr, sq_ring_size);
+
+		close(ring_fd);
+		ring_fd = -1;
+		return;
+	}
+
+	auto *sq = (uint8_t *)sq_ptr;
+	sq_head = (unsigned *)(sq + params.sq_off.head);
+	sq_tail = (unsigned *)(sq + params.sq_off.tail);
+	sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+	sq_array = (unsigned *)(sq + params.sq_off.array);
+
+	auto *cq = (uint8_t *)cq_ptr;
+	cq_head = (unsigned *)(cq + params.cq_off.head);
+	cq_tail = (unsigned *)(cq + params.cq_off.tail);
+	cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+	cqes = cq + params.cq_off.cqes;
+}
+
+io_ring::~io_ring()
+{
+	shutdown();
+}
+
+void io_ring::shutdown()
+{
+	if(ring_fd < 0)
+		return;
+
+	munmap(sqes, sqes_size);
+	if(cq_ptr != sq_ptr)
+		munmap(cq_ptr, cq_ring_size);
+	munmap(sq_ptr, sq_ring_size);
+	close(ring_fd);
+	ring_fd = -1;
+}
+
+bool io_ring::read_batch(int fd, read_request *reqs, size_t n)
+{
+	// We're the only producer, the tail is only written by us
+	unsigned tail = *sq_tail;
+	for(size_t i = 0; i < n; ++i, ++tail)
+	{
+		const unsigned idx = tail & *sq_mask;
+		auto *sqe = (io_uring_sqe *)sqes + idx;
+		std::memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->addr = (uint64_t)reqs[i].buff;
+		sqe->len = reqs[i].length;
+		sqe->off = reqs[i].offset;
+		sqe->user_data = i;
+		sq_array[idx] = idx;
+	}
+	__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+	size_t to_submit = n, completed = 0;
+	bool ok = true;
+	while(completed < n)
+	{
+		unsigned head = *cq_head;
+		const unsigned cq_tail_now = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+		// Nothing completed yet: submit what's left and wait for at least one completion
+		if(head == cq_tail_now)
+		{
+			const auto ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+			// Requests may be left in the rings, they can't be trusted anymore
+			if(ret < 0 and errno != EINTR)
+			{
+				shutdown();
+				return false;
+			}
+			if(ret > 0)
+				to_submit -= std::min<size_t>(ret, to_submit);
+			continue;
+		}
+
+		for(; head != cq_tail_now; ++head, ++completed)
+		{
+			const auto *cqe = (io_uring_cqe *)cqes + (head & *cq_mask);
+			auto& req = reqs[cqe->user_data];
+
+			// Errors and short reads are finished synchronously
+			if(cqe->res < 0)
+				ok = pread_full(fd, req.buff, req.length, req.offset) and ok;
+			else if((size_t)cqe->res < req.length)
+				ok = pread_full(fd, req.buff + cqe->res, req.length - cqe->res, req.offset + cqe->res) and ok;
+		}
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	return ok;
+}
+
+#else
+
+io_ring::io_ring(unsigned) {}
+io_ring::~io_ring() = default;
+void io_ring::shutdown() {}
+bool io_ring::read_batch(int, read_request *, size_t) {return false;}
+
+#endif
+
+bool io_ring::read(int fd, std::vector<read_request>& reqs)
+{
+	bool ok = true;
+	for(size_t i = 0, n; i < reqs.size(); i += n)
+	{
+		n = available() ? std::min<size_t>(sq_entries, reqs.size() - i) : reqs.size() - i;
+		if(available() and read_batch(fd, reqs.data() + i, n))
+			continue;
+
+		// No ring or the kernel refused the batch: reading the ranges again is harmless
+		for(size_t j = i; j < i + n; ++j)
+			ok = pread_full(fd, reqs[j].buff, reqs[j].length, reqs[j].offset) and ok;
+	}
+
+	return ok;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * A read of a file's range into a buffer
+ */
+struct read_request
+{
+	uint8_t *buff;
+	size_t length;
+	off_t offset;
+};
+
+/**
+ * Minimal io_uring instance that reads batches of ranges: all the requests of a batch are submitted with one system
+ * call and run concurrently in the kernel. It talks to the kernel directly, there's no need for liburing.
+ * If io_uring is not compiled in (the USE_IO_URING CMake option) or the kernel refuses it, the reads fall back to
+ * one pread() per request. An instance must not be shared among threads.
+ */
+class io_ring
+{
+	int ring_fd = -1;
+
+	// Submission queue
+	unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+	unsigned sq_entries = 0;
+	void *sqes = nullptr;
+
+	// Completion queue
+	unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+	void *cqes = nullptr;
+
+	// The rings' mappings
+	void *sq_ptr = nullptr, *cq_ptr = nullptr;
+	size_t sq_ring_size = 0, cq_ring_size = 0, sqes_size = 0;
+
+	/** Submits up to sq_entries requests and waits for them */
+	bool read_batch(int fd, read_request *reqs, size_t n);
+	/** Releases the ring, the following reads use pread() */
+	void shutdown();
+
+public:
+	explicit io_ring(unsigned entries = 64);
+	~io_ring();
+
+	io_ring(const io_ring&) = delete;
+	io_ring& operator=(const io_ring&) = delete;
+
+	bool available() const {return ring_fd >= 0;}
+
+	/**
+	 * Reads all the requests, whatever the backend
+	 * @return false if some read failed
+	 */
+	bool read(int fd, std::vector<read_request>& reqs);
+};
+
+/** Reads a whole range with pread(), retrying short reads */
+bool pread_full(int fd, uint8_t *buff, size_t length, off_t offset);
@@ -1,53 +1,168 @@
 #include "memory.hpp"
+#include "io_ring.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <tuple>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+/**
+ * Copies a file into explicit huge pages
+ * @return the mapping and its size, nullptr if there are not enough huge pages reserved
+ */
+static std::pair<void*, size_t> hugetlb_copy(int fd, size_t size)
+{
+#ifdef MAP_HUGETLB
+	// The default huge page size on x86-64 and arm64, munmap needs a multiple of it
+	constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+	const size_t map_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+	void* mapped = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(mapped == MAP_FAILED)
+		return {nullptr, 0};
+
+	if(not pread_full(fd, (uint8_t *)mapped, size, 0))
+	{
+		munmap(mapped, map_size);
+		return {nullptr, 0};
+	}
+
+	mprotect(mapped, map_size, PROT_READ);
+	return {mapped, map_size};
+#else
+	return {nullptr, 0};
+#endif
+}
+
 /**
  * This procedure mmaps a file in memory
  * @param filename
- * @return a pair containing the pointer to the mapped file and its size
+ * @param policy how the mapping is kept in memory
+ * @return the pointer to the mapped file, its size and the size of the mapping
  */
-static std::pair<void*, size_t> mmap_helper(char const *const filename)
+static std::tuple<void*, size_t, size_t> mmap_helper(char const *const filename, const mmap_policy& policy)
 {
 	auto fd = open(filename, O_RDONLY);
 
 	// Get file's size
 	struct stat st{};
-	auto ret_stat= stat(filename, &st);
-
-	if(ret_stat == -1)
+	if(fd == -1 or fstat(fd, &st) == -1)
+	{
+		std::cerr << "Cannot open " << filename << ": " << std::strerror(errno) << std::endl;
 		abort();
+	}
+
+	// Nothing to map, mmap refuses empty mappings
+	if(st.st_size == 0)
+	{
+		close(fd);
+		return {nullptr, 0, 0};
+	}
+
+	void* mapped = nullptr;
+	size_t map_size = st.st_size;
+
+	if(policy.huge_pages == mmap_policy::EXPLICIT_HUGE_PAGES)
+	{
+		std::tie(mapped, map_size) = hugetlb_copy(fd, st.st_size);
+		if(not mapped)
+		{
+			std::clog << "Not enough huge pages for " << filename << ", it is mapped with normal pages" << std::endl;
+			map_size = st.st_size;
+		}
+	}
 
 	// Map file in memory
-	void* mapped = (uint8_t *)mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(not mapped)
+	{
+		const int flags = MAP_SHARED | (policy.populate ? MAP_POPULATE : 0);
+		mapped = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+		if(mapped == MAP_FAILED)
+		{
+			std::cerr << "Cannot map " << filename << ": " << std::strerror(errno) << std::endl;
+			abort();
+		}
+
+		// Hints are only meaningful for the file's pages, the huge pages are not backed by it
+		if(policy.access == mmap_policy::RANDOM)
+			madvise(mapped, map_size, MADV_RANDOM);
+		else if(policy.access == mmap_policy::SEQUENTIAL)
+			madvise(mapped, map_size, MADV_SEQUENTIAL);
+
+#ifdef MADV_HUGEPAGE
+		// Ignored by kernels without read-only THP for files
+		if(policy.huge_pages == mmap_policy::TRANSPARENT_HUGE_PAGES)
+			madvise(mapped, map_size, MADV_HUGEPAGE);
+#endif
+	}
 
 	close(fd);
 
-	return {mapped, st.st_size};
+	if(policy.lock and mlock(mapped, map_size) == -1)
+		std::clog << "Cannot lock " << filename << " in memory: " << std::strerror(errno) << std::endl;
+
+	return {mapped, st.st_size, map_size};
+}
+
+bool mmap_policy::parse(const std::string& str, mmap_policy& policy)
+{
+	size_t start = 0;
+	while(start <= str.size())
+	{
+		auto end = str.find(',', start);
+		if(end == std::string::npos)
+			end = str.size();
+
+		const auto word = str.substr(start, end - start);
+		if(word == "normal")
+			policy.access = NORMAL;
+		else if(word == "random")
+			policy.access = RANDOM;
+		else if(word == "sequential")
+			policy.access = SEQUENTIAL;
+		else if(word == "populate")
+			policy.populate = true;
+		else if(word == "lock")
+			policy.lock = true;
+		else if(word == "thp")
+			policy.huge_pages = TRANSPARENT_HUGE_PAGES;
+		else if(word == "hugetlb")
+			policy.huge_pages = EXPLICIT_HUGE_PAGES;
+		else
+			return false;
+
+		start = end + 1;
+	}
+
+	return true;
 }
 
-memory_mmap::memory_mmap(const std::string &filename)
+memory_mmap::memory_mmap(const std::string &filename, const mmap_policy& policy)
 {
-	auto [b, s] = mmap_helper(filename.c_str());
+	auto [b, s, m] = mmap_helper(filename.c_str(), policy);
 	buff = static_cast<uint8_t *>(b);
 	buff_size = s;
+	map_size = m;
 }
 
 memory_mmap::memory_mmap(memory_mmap &&other)
 {
 	buff = other.buff;
 	buff_size = other.buff_size;
+	map_size = other.map_size;
 
 	other.buff = nullptr;
 	other.buff_size = 0;
+	other.map_size = 0;
 }
 
 memory_mmap::~memory_mmap()
 {
 	if(buff)
-		munmap((void *) buff, buff_size);
+		munmap((void *) buff, map_size);
 }
 
 std::pair<uint8_t *, size_t> memory_mmap::get() const
@@ -55,6 +170,15 @@ std::pair<uint8_t *, size_t> memory_mmap::get() const
 	return {buff, buff_size};
 }
 
+void memory_mmap::prefault() const
+{
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	// Volatile loads can't be optimized away
+	for(size_t off = 0; off < buff_size; off += page_size)
+		(void)*(volatile const uint8_t *)(buff + off);
+}
+
 std::pair<uint8_t *, size_t> memory_buffer::get() const
 {
 	return {buff, buff_size};
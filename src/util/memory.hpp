@@ -10,6 +10,51 @@ class memory_area
 public:
 	virtual ~memory_area() = default;
 	virtual std::pair<uint8_t *, size_t> get() const = 0;
+	/** Loads the whole area from the calling thread, a no-op if it's already in memory */
+	virtual void prefault() const {}
+};
+
+/**
+ * How a mapped file is kept in memory
+ */
+struct mmap_policy
+{
+	enum access_t {NORMAL, RANDOM, SEQUENTIAL};
+	enum huge_pages_t {NO_HUGE_PAGES, TRANSPARENT_HUGE_PAGES, EXPLICIT_HUGE_PAGES};
+
+	// Hint to the kernel's readahead: none for point lookups, aggressive for scans
+	access_t access = NORMAL;
+	// Read the whole file when it's mapped, instead of one fault at a time
+	bool populate = false;
+	// Keep the file in memory, for small hot files. Limited by RLIMIT_MEMLOCK
+	bool lock = false;
+	// Transparent huge pages need a kernel with read-only THP for files. Explicit ones are reserved hugetlb pages,
+	// the file is copied into them
+	huge_pages_t huge_pages = NO_HUGE_PAGES;
+
+	/**
+	 * Parses a comma separated list of: normal, random, sequential, populate, lock, thp, hugetlb
+	 * @return false if a word is not known
+	 */
+	static bool parse(const std::string& str, mmap_policy& policy);
+
+	/** Scans of the whole file, like the builder's passes */
+	static mmap_policy sequential() {return {.access = SEQUENTIAL};}
+};
+
+/**
+ * The policies of the classes of files of an index
+ */
+struct index_mmap_policy
+{
+	// Local, global and impact lexica, they're searched with point lookups
+	mmap_policy lexicon;
+	// Read once per result
+	mmap_policy document_index;
+	// Posting lists, impacts and positions, they're scanned from a random starting point
+	mmap_policy postings;
+
+	static index_mmap_policy sequential() {return {mmap_policy::sequential(), mmap_policy::sequential(), mmap_policy::sequential()};}
 };
 
 /**
@@ -19,11 +64,19 @@ class memory_mmap: public memory_area
 {
 	uint8_t *buff;
 	size_t buff_size;
+	// The mapping may be larger than the file when it's made of huge pages
+	size_t map_size;
 public:
-	explicit memory_mmap(const std::string& filename);
+	explicit memory_mmap(const std::string& filename, const mmap_policy& policy = {});
 	memory_mmap(memory_mmap&&);
 	~memory_mmap() override;
 	std::pair<uint8_t *, size_t> get() const override;
+
+	/**
+	 * Reads one byte per page, so that the whole file is faulted in by the calling thread. Pages that are not cached
+	 * yet are allocated on the caller's NUMA node
+	 */
+	void prefault() const override;
 };
 
 /**
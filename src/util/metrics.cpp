@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "metrics.hpp"
+
+size_t latency_histogram::bucket_of(uint64_t value)
+{
+	// Small values have a bucket each
+	if(value < (2ULL << SUB_BUCKET_BITS))
+		return value;
+
+	// Then 2^SUB_BUCKET_BITS buckets per power of two, indexed by the bits after the most significant one
+	const unsigned msb = 63 - __builtin_clzll(value);
+	const unsigned shift = msb - SUB_BUCKET_BITS;
+	return (shift << SUB_BUCKET_BITS) + (value >> shift);
+}
+
+uint64_t latency_histogram::bucket_top(size_t bucket)
+{
+	if(bucket < (2ULL << SUB_BUCKET_BITS))
+		return bucket;
+
+	const unsigned shift = (bucket >> SUB_BUCKET_BITS) - 1;
+	const uint64_t mantissa = (bucket & ((1ULL << SUB_BUCKET_BITS) - 1)) + (1ULL << SUB_BUCKET_BITS);
+	return ((mantissa + 1) << shift) - 1;
+}
+
+void latency_histogram::record(uint64_t us)
+{
+	counts[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+	n_values.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(us, std::memory_order_relaxed);
+
+	uint64_t current_max = max_value.load(std::memory_order_relaxed);
+	while(us > current_max and not max_value.compare_exchange_weak(current_max, us, std::memory_order_relaxed));
+}
+
+uint64_t latency_histogram::value_at(double percentile) const
+{
+	const uint64_t total = n_values;
+	if(total == 0)
+		return 0;
+
+	// Rank of the value, 1-based
+	const auto rank = std::max<uint64_t>(1, (uint64_t)std::ceil(percentile / 100 * total));
+
+	uint64_t seen = 0;
+	for(size_t bucket = 0; bucket < N_BUCKETS; ++bucket)
+	{
+		seen += counts[bucket].load(std::memory_order_relaxed);
+		if(seen >= rank)
+			return std::min(bucket_top(bucket), max());
+	}
+
+	return max();
+}
+
+// The reported percentiles, and their names
+static constexpr std::pair<double, const char *> PERCENTILES[] = {
+		{50, "p50"}, {90, "p90"}, {99, "p99"}, {99.9, "p999"}
+};
+
+double query_metrics::qps() const
+{
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+	return elapsed.count() > 0 ? queries.count() / elapsed.count() : 0;
+}
+
+/** One line of the summary: count, mean and percentiles in milliseconds */
+static void summary_line(std::ostream& out, const std::string& label, const latency_histogram& h)
+{
+	out << std::setw(24) << std::left << label << std::right << " n " << std::setw(8) << h.count()
+		<< "  mean " << std::setw(9) << h.mean() / 1000;
+
+	for(const auto& [percentile, name] : PERCENTILES)
+		out << "  " << name << ' ' << std::setw(9) << h.value_at(percentile) / 1000.;
+
+	out << "  max " << std::setw(9) << h.max() / 1000. << '\n';
+}
+
+std::string query_metrics::summary() const
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(3);
+	out << "Latency (ms) of " << queries.count() << " queries, " << qps() << " queries/s\n";
+	summary_line(out, "all", queries);
+
+	for(const auto& path : paths)
+		if(path.histogram.count())
+			summary_line(out, path.label, path.histogram);
+
+	out << "Latency (ms) of the index chunks' tasks\n";
+	for(const auto& shard : shards)
+		if(shard.histogram.count())
+			summary_line(out, shard.label, shard.histogram);
+
+	return out.str();
+}
+
+/** Labels are paths and algorithm names, only quotes and backslashes need to be escaped */
+static std::string escape(const std::string& str)
+{
+	std::string escaped;
+	for(char c : str)
+	{
+		if(c == '"' or c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+static void json_histogram(std::ostream& out, const latency_histogram& h)
+{
+	out << "{\"count\": " << h.count() << ", \"mean\": " << h.mean() / 1000;
+	for(const auto& [percentile, name] : PERCENTILES)
+		out << ", \"" << name << "\": " << h.value_at(percentile) / 1000.;
+	out << ", \"max\": " << h.max() / 1000. << '}';
+}
+
+static void json_groups(std::ostream& out, const std::deque<query_metrics::group_t>& groups)
+{
+	out << '{';
+	for(bool first = true; const auto& group : groups)
+	{
+		out << (first ? "" : ", ") << '"' << escape(group.label) << "\": ";
+		json_histogram(out, group.histogram);
+		first = false;
+	}
+	out << '}';
+}
+
+std::string query_metrics::to_json() const
+{
+	std::ostringstream out;
+	out << std::setprecision(6);
+	out << "{\"queries\": " << queries.count() << ", \"qps\": " << qps() << ", \"latency_ms\": ";
+	json_histogram(out, queries);
+	out << ", \"by_path\": ";
+	json_groups(out, paths);
+	out << ", \"by_shard\": ";
+	json_groups(out, shards);
+	out << "}\n";
+
+	return out.str();
+}
+
+/** A summary metric: its quantiles, sum and count, in seconds */
+static void prometheus_summary(std::ostream& out, const std::string& name, const std::string& labels, const latency_histogram& h)
+{
+	const std::string sep = labels.empty() ? "" : ",";
+	for(const auto& [percentile, _] : PERCENTILES)
+		out << name << '{' << labels << sep << "quantile=\"" << percentile / 100 << "\"} " << h.value_at(percentile) / 1e6 << '\n';
+
+	out << name << "_sum{" << labels << "} " << h.mean() * h.count() / 1e6 << '\n';
+	out << name << "_count{" << labels << "} " << h.count() << '\n';
+}
+
+std::string query_metrics::to_prometheus() const
+{
+	std::ostringstream out;
+	out << std::setprecision(6);
+
+	out << "# HELP engine_queries_per_second Queries solved per second since startup\n";
+	out << "# TYPE engine_queries_per_second gauge\n";
+	out << "engine_queries_per_second " << qps() << '\n';
+
+	out << "# HELP engine_query_latency_seconds End-to-end latency of the queries, by the path that solved them\n";
+	out << "# TYPE engine_query_latency_seconds summary\n";
+	prometheus_summary(out, "engine_query_latency_seconds", "path=\"all\"", queries);
+	for(const auto& path : paths)
+		prometheus_summary(out, "engine_query_latency_seconds", "path=\"" + escape(path.label) + '"', path.histogram);
+
+	out << "# HELP engine_shard_latency_seconds Latency of the queries' tasks on each index chunk\n";
+	out << "# TYPE engine_shard_latency_seconds summary\n";
+	for(const auto& shard : shards)
+		prometheus_summary(out, "engine_shard_latency_seconds", "shard=\"" + escape(shard.label) + '"', shard.histogram);
+
+	return out.str();
+}
+
+metrics_reporter::metrics_reporter(const query_metrics& metrics, std::string path, query_metrics::format_t format,
+								   unsigned interval):
+		metrics(metrics), path(std::move(path)), format(format), interval(interval),
+		worker(&metrics_reporter::worker_procedure, this) {}
+
+metrics_reporter::~metrics_reporter()
+{
+	{
+		std::lock_guard guard(mutex);
+		halt = true;
+	}
+	cv.notify_all();
+	worker.join();
+}
+
+void metrics_reporter::worker_procedure()
+{
+	using namespace std::chrono_literals;
+
+	auto next_dump = std::chrono::steady_clock::now() + interval;
+	std::unique_lock lock(mutex);
+	while(not halt)
+	{
+		// Signal handlers can't notify, the flag is polled
+		cv.wait_for(lock, 100ms);
+
+		const auto now = std::chrono::steady_clock::now();
+		const bool periodic = interval.count() and now >= next_dump;
+		if(not dump_requested.exchange(false) and not periodic)
+			continue;
+
+		if(periodic)
+			next_dump = now + interval;
+
+		lock.unlock();
+		dump();
+		lock.lock();
+	}
+}
+
+void metrics_reporter::dump() const
+{
+	const auto text = format == query_metrics::JSON ? metrics.to_json() : metrics.to_prometheus();
+	if(path == "-")
+	{
+		std::cerr << text << std::flush;
+		return;
+	}
+
+	// Written aside and renamed, readers see either the old dump or the new one
+	const auto tmp_path = path + ".tmp";
+	{
+		std::ofstream out(tmp_path);
+		out << text;
+	}
+	std::rename(tmp_path.c_str(), path.c_str());
+}
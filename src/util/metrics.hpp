@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * Latency histogram in the style of HdrHistogram: the buckets are linear within each power of two, so every value is
+ * recorded with a relative error below 1/32 from 1us to hours, in a fixed amount of memory. Recording is lock-free
+ * and can be done concurrently with the readers.
+ */
+class latency_histogram
+{
+	static constexpr unsigned SUB_BUCKET_BITS = 5;
+	static constexpr size_t N_BUCKETS = (64 - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+	std::array<std::atomic<uint64_t>, N_BUCKETS> counts = {};
+	std::atomic<uint64_t> n_values = 0;
+	std::atomic<uint64_t> sum = 0;
+	std::atomic<uint64_t> max_value = 0;
+
+	static size_t bucket_of(uint64_t value);
+	/** The highest value recorded in the bucket */
+	static uint64_t bucket_top(size_t bucket);
+
+public:
+	/** Records a latency in microseconds */
+	void record(uint64_t us);
+	void record(std::chrono::steady_clock::duration latency)
+	{
+		record(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+	}
+
+	uint64_t count() const {return n_values;}
+	uint64_t max() const {return max_value;}
+	double mean() const {return n_values ? (double)sum / n_values : 0;}
+
+	/**
+	 * @param percentile in [0, 100]
+	 * @return the smallest recorded value (up to the bucket's precision) such that `percentile`% of the values are
+	 * less than or equal to it, in microseconds
+	 */
+	uint64_t value_at(double percentile) const;
+};
+
+/**
+ * The engine's latency metrics: all the queries, the queries by the path that solved them (the algorithm, the cache,
+ * the tier 0...) and the tasks of each index chunk. Paths and chunks are registered before the queries run.
+ */
+class query_metrics
+{
+public:
+	struct group_t
+	{
+		std::string label;
+		latency_histogram histogram;
+
+		explicit group_t(std::string label): label(std::move(label)) {}
+	};
+
+	enum format_t {JSON, PROMETHEUS};
+
+private:
+	const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+	latency_histogram queries;
+	// Deques, so that the histograms never move
+	std::deque<group_t> paths;
+	std::deque<group_t> shards;
+
+public:
+	size_t add_path(const std::string& label) {paths.emplace_back(label); return paths.size() - 1;}
+	size_t add_shard(const std::string& label) {shards.emplace_back(label); return shards.size() - 1;}
+
+	/** Records a query's end-to-end latency */
+	void record_query(size_t path, std::chrono::steady_clock::duration latency)
+	{
+		queries.record(latency);
+		paths[path].histogram.record(latency);
+	}
+
+	/** Records the latency of a query's task on an index chunk */
+	void record_shard(size_t shard, std::chrono::steady_clock::duration latency) {shards[shard].histogram.record(latency);}
+
+	/** Queries per second since the metrics were created */
+	double qps() const;
+
+	/** Human readable summary, for the end of a run */
+	std::string summary() const;
+
+	std::string to_json() const;
+	/** Prometheus' text exposition format */
+	std::string to_prometheus() const;
+};
+
+/**
+ * Writes the metrics to a file, on request or periodically, from a background thread. The file is replaced
+ * atomically so that scrapers never see a partial dump.
+ */
+class metrics_reporter
+{
+	const query_metrics& metrics;
+	std::string path;
+	query_metrics::format_t format;
+	std::chrono::seconds interval;
+
+	std::atomic<bool> dump_requested = false;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool halt = false;
+
+	std::thread worker;
+
+	void worker_procedure();
+
+public:
+	/**
+	 * @param path where to write the metrics, `-` for stderr
+	 * @param interval seconds between periodic dumps, 0 to only dump on request
+	 */
+	metrics_reporter(const query_metrics& metrics, std::string path, query_metrics::format_t format, unsigned interval);
+	~metrics_reporter();
+
+	/** Asks the background thread for a dump. It's async-signal-safe */
+	void request_dump() {dump_requested = true;}
+
+	/** Writes the metrics from the calling thread */
+	void dump() const;
+};
@@ -0,0 +1,40 @@
+#include <unistd.h>
+#include <getopt.h>
+#include "pruner_options.hpp"
+
+// Used to tweak the pruner's behaviour based on command line arguments
+pruner_options::pruner_options(int argc, char **argv)
+{
+	static const option long_options[] = {
+			/*   NAME       ARGUMENT           FLAG  SHORTNAME */
+			{"epsilon",	required_argument, nullptr, 'e'},
+			{"top-k",	required_argument, nullptr, 'k'},
+			{"global",	required_argument, nullptr, 'g'},
+			{nullptr, 0, nullptr, 0}
+	};
+
+	int c;
+	int option_index = 0;
+	while ((c = getopt_long(argc, argv, "e:k:g:", long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+		case 'e':
+			epsilon = std::stod(optarg);
+			break;
+		case 'k':
+			k = std::stoi(optarg);
+			break;
+		case 'g':
+			global_threshold = std::stod(optarg);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if(optind < argc)
+		in_dir = argv[optind++];
+	if(optind < argc)
+		out_dir = argv[optind];
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <filesystem>
+
+struct pruner_options
+{
+	std::filesystem::path in_dir = "data";
+	std::filesystem::path out_dir = "data_tier0";
+	// Carmel et al.'s per-term pruning: postings scoring less than epsilon times the k-th best score of their term
+	// are dropped
+	double epsilon = 0.5;
+	unsigned k = 10;
+	// Postings scoring less than this BM25 score are dropped too, 0 to disable it
+	double global_threshold = 0;
+
+	pruner_options(int argc, char **argv);
+};
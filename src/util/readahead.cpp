@@ -0,0 +1,59 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include "readahead.hpp"
+
+readahead_queue::readahead_queue(size_t max_pending):
+	max_pending(max_pending), worker(&readahead_queue::worker_procedure, this)
+{}
+
+readahead_queue::~readahead_queue()
+{
+	{
+		std::lock_guard guard(mutex);
+		halt = true;
+		cv.notify_all();
+	}
+
+	worker.join();
+}
+
+void readahead_queue::add(const uint8_t *addr, size_t length)
+{
+	if(length == 0)
+		return;
+
+	std::lock_guard guard(mutex);
+	if(ranges.size() >= max_pending)
+	{
+		n_dropped += 1;
+		return;
+	}
+
+	ranges.emplace_back(addr, length);
+	cv.notify_one();
+}
+
+void readahead_queue::worker_procedure()
+{
+	const uintptr_t page_mask = ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1);
+
+	while(true)
+	{
+		std::pair<const uint8_t *, size_t> range;
+		{
+			std::unique_lock lock(mutex);
+			cv.wait(lock, [&] {return halt or not ranges.empty();});
+			if(halt)
+				return;
+
+			range = ranges.front();
+			ranges.pop_front();
+		}
+
+		// madvise wants a page aligned address
+		const auto [addr, length] = range;
+		const uintptr_t begin = (uintptr_t)addr & page_mask;
+		madvise((void *)begin, (uintptr_t)addr + length - begin, MADV_WILLNEED);
+		n_issued += 1;
+	}
+}
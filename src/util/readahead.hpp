@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * Background I/O thread that asks the kernel to read ahead ranges of mapped files (madvise(MADV_WILLNEED)).
+ * The query threads enqueue the ranges they'll read soon and go on, the advice itself may block on I/O so it's
+ * issued by this thread. Ranges are dropped when too many are pending: a late readahead is useless anyway.
+ */
+class readahead_queue
+{
+	std::deque<std::pair<const uint8_t *, size_t>> ranges;
+	size_t max_pending;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool halt = false;
+
+	std::atomic<size_t> n_issued = 0;
+	std::atomic<size_t> n_dropped = 0;
+
+	std::thread worker;
+
+	void worker_procedure();
+
+public:
+	explicit readahead_queue(size_t max_pending = 1024);
+	~readahead_queue();
+
+	/** Enqueues a range, it never blocks on I/O */
+	void add(const uint8_t *addr, size_t length);
+
+	size_t issued() const {return n_issued;}
+	size_t dropped() const {return n_dropped;}
+};
@@ -0,0 +1,35 @@
+#include <unistd.h>
+#include <getopt.h>
+#include <algorithm>
+#include <thread>
+#include "resharder_options.hpp"
+
+// Used to tweak the resharder's behaviour based on command line arguments
+resharder_options::resharder_options(int argc, char **argv):
+	n_chunks(std::max(1u, std::thread::hardware_concurrency()))
+{
+	static const option long_options[] = {
+			/*   NAME       ARGUMENT           FLAG  SHORTNAME */
+			{"chunks",	required_argument, nullptr, 'n'},
+			{nullptr, 0, nullptr, 0}
+	};
+
+	int c;
+	int option_index = 0;
+	while ((c = getopt_long(argc, argv, "n:", long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+		case 'n':
+			n_chunks = std::max(1ul, std::stoul(optarg));
+			break;
+		default:
+			break;
+		}
+	}
+
+	if(optind < argc)
+		in_dir = argv[optind++];
+	if(optind < argc)
+		out_dir = argv[optind];
+}
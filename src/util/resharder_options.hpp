@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+#include <filesystem>
+
+struct resharder_options
+{
+	std::filesystem::path in_dir = "data";
+	std::filesystem::path out_dir = "data_resharded";
+	// How many chunks to write, by default one per hardware thread
+	unsigned n_chunks;
+
+	resharder_options(int argc, char **argv);
+};
@@ -0,0 +1,72 @@
+#include "result_cache.hpp"
+
+result_cache::result_cache(size_t max_bytes, size_t n_shards):
+	shards(new shard_t[n_shards]), n_shards(n_shards), shard_max_bytes(max_bytes / n_shards)
+{
+}
+
+std::optional<result_cache::results_t> result_cache::get(const std::string& key)
+{
+	auto& shard = shard_of(key);
+
+	{ // Critical section
+		std::lock_guard lock(shard.mutex);
+		auto entry_it = shard.entries.find(key);
+		if(entry_it != shard.entries.end())
+		{
+			// Move it in front
+			shard.lru.splice(shard.lru.begin(), shard.lru, entry_it->second);
+			++n_hits;
+			return entry_it->second->second;
+		}
+	}
+
+	++n_misses;
+	return std::nullopt;
+}
+
+void result_cache::put(const std::string& key, const results_t& results)
+{
+	const size_t size = entry_size(key, results);
+
+	// It would evict the whole shard
+	if(size > shard_max_bytes)
+		return;
+
+	auto& shard = shard_of(key);
+	std::lock_guard lock(shard.mutex);
+
+	// Replace the old entry
+	auto entry_it = shard.entries.find(key);
+	if(entry_it != shard.entries.end())
+	{
+		shard.used_bytes -= entry_size(entry_it->second->first, entry_it->second->second);
+		shard.lru.erase(entry_it->second);
+		shard.entries.erase(entry_it);
+	}
+
+	// Make room, evicting from the back
+	while(shard.used_bytes + size > shard_max_bytes)
+	{
+		const auto& [old_key, old_results] = shard.lru.back();
+		shard.used_bytes -= entry_size(old_key, old_results);
+		shard.entries.erase(old_key);
+		shard.lru.pop_back();
+	}
+
+	// The map's key is a view of the string stored in the list
+	shard.lru.emplace_front(key, results);
+	shard.entries.emplace(shard.lru.front().first, shard.lru.begin());
+	shard.used_bytes += size;
+}
+
+size_t result_cache::entry_size(const std::string& key, const results_t& results)
+{
+	// Bookkeeping: list's node and map's entry
+	size_t size = sizeof(shard_t::entry_t) + 4 * sizeof(void*) + key.size();
+
+	for(const auto& result : results)
+		size += sizeof(result) + result.docno.size();
+
+	return size;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../index/types.hpp"
+
+/**
+ * Thread-safe LRU cache of query results, bounded by memory.
+ * The keys are split among independent shards, each one with its own lock, so that concurrent lookups rarely contend.
+ * The key is opaque, it must identify everything that changes the results (tokens, algorithm, scorer, k...)
+ */
+class result_cache
+{
+	using results_t = std::vector<sindex::result_t>;
+
+	struct shard_t
+	{
+		using entry_t = std::pair<std::string, results_t>;
+
+		std::mutex mutex;
+		// Most recently used first
+		std::list<entry_t> lru;
+		std::unordered_map<std::string_view, std::list<entry_t>::iterator> entries;
+		size_t used_bytes = 0;
+	};
+
+	std::unique_ptr<shard_t[]> shards;
+	size_t n_shards;
+	size_t shard_max_bytes;
+
+	std::atomic<size_t> n_hits = 0;
+	std::atomic<size_t> n_misses = 0;
+
+	shard_t& shard_of(const std::string& key) {return shards[std::hash<std::string>{}(key) % n_shards];}
+
+public:
+	/**
+	 * @param max_bytes memory limit of the whole cache, an estimate of the keys' and results' footprint
+	 * @param n_shards number of independently locked shards
+	 */
+	explicit result_cache(size_t max_bytes, size_t n_shards = 16);
+
+	/** The cached results, if any. A hit marks the entry as the most recently used */
+	std::optional<results_t> get(const std::string& key);
+
+	/** Inserts or replaces the results of a key, evicting the least recently used entries of its shard */
+	void put(const std::string& key, const results_t& results);
+
+	/** Estimated memory footprint of an entry */
+	static size_t entry_size(const std::string& key, const results_t& results);
+
+	size_t hits() const {return n_hits;}
+	size_t misses() const {return n_misses;}
+};
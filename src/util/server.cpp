@@ -0,0 +1,281 @@
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+
+// How often serve() checks whether it was stopped
+static constexpr int POLL_TIMEOUT_MS = 200;
+
+static bool write_full(int fd, const char *buff, size_t length)
+{
+	while(length > 0)
+	{
+		// No SIGPIPE if the client went away
+		const auto ret = send(fd, buff, length, MSG_NOSIGNAL);
+		if(ret < 0 and errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return false;
+
+		buff += ret;
+		length -= ret;
+	}
+
+	return true;
+}
+
+static bool read_full(int fd, char *buff, size_t length)
+{
+	while(length > 0)
+	{
+		const auto ret = recv(fd, buff, length, 0);
+		if(ret < 0 and errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return false;
+
+		buff += ret;
+		length -= ret;
+	}
+
+	return true;
+}
+
+bool send_message(int fd, const std::string& message)
+{
+	const uint32_t length = htonl(message.size());
+	return write_full(fd, (const char *)&length, sizeof(length)) and write_full(fd, message.data(), message.size());
+}
+
+bool recv_message(int fd, std::string& message, size_t max_length)
+{
+	uint32_t length;
+	if(not read_full(fd, (char *)&length, sizeof(length)))
+		return false;
+
+	length = ntohl(length);
+	if(length > max_length)
+		return false;
+
+	message.resize(length);
+	return read_full(fd, message.data(), length);
+}
+
+std::string query_request(const std::string& query, double threshold)
+{
+	if(threshold == 0)
+		return query;
+
+	// Enough digits to read back the same double
+	std::ostringstream request;
+	request << std::setprecision(std::numeric_limits<double>::max_digits10) << "threshold " << threshold << '\n' << query;
+	return request.str();
+}
+
+bool parse_query_request(const std::string& request, std::string& query, double& threshold)
+{
+	threshold = 0;
+
+	// Queries are a single line, a request with more of them has the threshold one
+	const auto newline = request.find('\n');
+	if(newline == std::string::npos)
+	{
+		query = request;
+		return true;
+	}
+
+	std::istringstream header(request.substr(0, newline));
+	std::string name;
+	if(not (header >> name >> threshold) or name != "threshold")
+		return false;
+
+	query = request.substr(newline + 1);
+	return true;
+}
+
+std::string query_response(const std::vector<sindex::result_t>& results, bool approximate, bool partial)
+{
+	std::ostringstream response;
+	response << std::setprecision(std::numeric_limits<sindex::score_t>::max_digits10) << "ok"
+			 << (approximate ? " approximate" : "") << (partial ? " partial" : "") << '\n';
+	for(const auto& result : results)
+		response << result.docno << '\t' << result.score << '\n';
+
+	return response.str();
+}
+
+std::string error_response(const std::string& reason)
+{
+	return "error " + reason + '\n';
+}
+
+/** Fills the socket address of a Unix or loopback TCP address, as accepted by query_server::listen */
+static socklen_t parse_address(const std::string& address, sockaddr_storage& storage)
+{
+	std::memset(&storage, 0, sizeof(storage));
+
+	if(address.starts_with("tcp:"))
+	{
+		auto *in = (sockaddr_in *)&storage;
+		in->sin_family = AF_INET;
+		in->sin_port = htons(std::stoi(address.substr(4)));
+		in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		return sizeof(sockaddr_in);
+	}
+
+	auto *un = (sockaddr_un *)&storage;
+	if(address.size() >= sizeof(un->sun_path))
+		return 0;
+
+	un->sun_family = AF_UNIX;
+	std::strcpy(un->sun_path, address.c_str());
+	return sizeof(sockaddr_un);
+}
+
+int connect_to(const std::string& address)
+{
+	sockaddr_storage storage;
+	const auto length = parse_address(address, storage);
+	if(length == 0)
+		return -1;
+
+	const int fd = socket(storage.ss_family, SOCK_STREAM, 0);
+	if(fd == -1)
+		return -1;
+
+	if(connect(fd, (sockaddr *)&storage, length) == -1)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+bool query_server::listen(const std::string& address)
+{
+	sockaddr_storage storage;
+	const auto length = parse_address(address, storage);
+	if(length == 0)
+	{
+		std::cerr << "Invalid address " << address << std::endl;
+		return false;
+	}
+
+	listen_fd = socket(storage.ss_family, SOCK_STREAM, 0);
+	if(listen_fd == -1)
+	{
+		std::cerr << "Cannot create the socket: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	if(storage.ss_family == AF_UNIX)
+	{
+		// A leftover of a previous run
+		unlink(address.c_str());
+		unix_path = address;
+	}
+	else
+	{
+		const int yes = 1;
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+	}
+
+	if(bind(listen_fd, (sockaddr *)&storage, length) == -1 or ::listen(listen_fd, SOMAXCONN) == -1)
+	{
+		std::cerr << "Cannot listen on " << address << ": " << std::strerror(errno) << std::endl;
+		close(listen_fd);
+		listen_fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+void query_server::serve(const handler_t& handler)
+{
+	pollfd pfd = {.fd = listen_fd, .events = POLLIN, .revents = 0};
+
+	while(not halt)
+	{
+		reap_connections();
+
+		// Wake up every now and then to check the halt flag
+		const int ret = poll(&pfd, 1, POLL_TIMEOUT_MS);
+		if(ret <= 0)
+			continue;
+
+		const int fd = accept(listen_fd, nullptr, nullptr);
+		if(fd == -1)
+			continue;
+
+		n_connections += 1;
+
+		std::lock_guard guard(connections_mutex);
+		auto& connection = connections.emplace_back();
+		connection.fd = fd;
+		connection.thread = std::thread(&query_server::serve_connection, this, std::ref(connection), std::cref(handler));
+	}
+
+	// Unblock the connections waiting for a request, the ones running the handler finish their request first
+	{
+		std::lock_guard guard(connections_mutex);
+		for(auto& connection : connections)
+			shutdown(connection.fd, SHUT_RDWR);
+	}
+
+	for(auto& connection : connections)
+		connection.thread.join();
+	connections.clear();
+}
+
+void query_server::serve_connection(connection_t& connection, const handler_t& handler)
+{
+	std::string request;
+	while(not halt and recv_message(connection.fd, request))
+	{
+		n_requests += 1;
+		if(not send_message(connection.fd, handler(request)))
+			break;
+	}
+
+	std::lock_guard guard(connections_mutex);
+	close(connection.fd);
+	// The fd may be reused by a new connection, it must not be shut down again
+	connection.fd = -1;
+	connection.done = true;
+}
+
+void query_server::reap_connections()
+{
+	std::lock_guard guard(connections_mutex);
+	for(auto it = connections.begin(); it != connections.end();)
+	{
+		if(not it->done)
+		{
+			++it;
+			continue;
+		}
+
+		it->thread.join();
+		it = connections.erase(it);
+	}
+}
+
+query_server::~query_server()
+{
+	if(listen_fd != -1)
+		close(listen_fd);
+
+	if(not unix_path.empty())
+		unlink(unix_path.c_str());
+}
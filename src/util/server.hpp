@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../index/types.hpp"
+
+/*
+ * The server's protocol: every message, request or response, is a 32 bit big-endian length followed by that many
+ * bytes. A client can send any number of requests on a connection, each gets one response, in order.
+ * A request is a query's text, optionally preceded by a `threshold SCORE` line: only the documents scoring more than
+ * that are worth returning, as the client already has k better ones from elsewhere.
+ * A response starts with a status line: `ok`, followed by one `docno\tscore` line per result, best first, or
+ * `error REASON` if the request could not be served. The `ok` line may be followed by `approximate`, if a budget
+ * stopped the query, and by `partial`, if the results of some shards are missing.
+ */
+
+/**
+ * Writes a whole length-prefixed message
+ * @return false if the connection was closed
+ */
+bool send_message(int fd, const std::string& message);
+
+/**
+ * Reads a whole length-prefixed message
+ * @param max_length longer messages are refused
+ * @return false if the connection was closed or the message is too long
+ */
+bool recv_message(int fd, std::string& message, size_t max_length = 1 << 20);
+
+/** Builds a query's request, with the threshold line only if it's not 0 */
+std::string query_request(const std::string& query, double threshold = 0);
+
+/**
+ * Splits a request in its query and threshold, 0 if it has none
+ * @return false if the threshold line is malformed
+ */
+bool parse_query_request(const std::string& request, std::string& query, double& threshold);
+
+/** Builds a query's response, the scores with enough digits to be read back exactly */
+std::string query_response(const std::vector<sindex::result_t>& results, bool approximate = false, bool partial = false);
+
+/** Builds the response to a request that could not be served */
+std::string error_response(const std::string& reason);
+
+/**
+ * Connects to a server
+ * @param address see query_server::listen
+ * @return the socket, -1 on failure
+ */
+int connect_to(const std::string& address);
+
+/**
+ * Serves length-prefixed requests over a Unix domain or a loopback TCP socket. Each connection is served by its own
+ * thread, which calls the handler for every request and sends back what it returns. The handler is called
+ * concurrently by the connections' threads.
+ */
+class query_server
+{
+public:
+	using handler_t = std::function<std::string(const std::string&)>;
+
+private:
+	struct connection_t
+	{
+		int fd;
+		std::thread thread;
+		std::atomic<bool> done = false;
+	};
+
+	int listen_fd = -1;
+	std::string unix_path;
+
+	std::atomic<bool> halt = false;
+
+	std::list<connection_t> connections;
+	std::mutex connections_mutex;
+
+	std::atomic<size_t> n_connections = 0;
+	std::atomic<size_t> n_requests = 0;
+
+	void serve_connection(connection_t& connection, const handler_t& handler);
+	/** Joins the threads of the closed connections */
+	void reap_connections();
+
+public:
+	query_server() = default;
+	~query_server();
+
+	query_server(const query_server&) = delete;
+	query_server& operator=(const query_server&) = delete;
+
+	/**
+	 * Binds the socket
+	 * @param address a Unix socket's path, or `tcp:PORT` to listen on the loopback interface
+	 * @return false if the socket could not be bound
+	 */
+	bool listen(const std::string& address);
+
+	/** Accepts connections until stop() is called, then closes them all and returns */
+	void serve(const handler_t& handler);
+
+	/** Makes serve() return. It's async-signal-safe */
+	void stop() {halt = true;}
+
+	size_t connections_served() const {return n_connections;}
+	size_t requests_served() const {return n_requests;}
+};
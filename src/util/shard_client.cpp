@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "shard_client.hpp"
+#include "server.hpp"
+#include "../index/top_k_merge.hpp"
+
+shard_client::shard_client(std::vector<std::string> addresses, size_t n_probes, std::chrono::milliseconds timeout):
+		addresses(std::move(addresses)), n_probes(n_probes), timeout(timeout)
+{
+	fds.assign(this->addresses.size(), -1);
+}
+
+shard_client::~shard_client()
+{
+	for(const int fd : fds)
+		if(fd != -1)
+			close(fd);
+}
+
+bool shard_client::connect_shard(size_t shard)
+{
+	if(fds[shard] != -1)
+		return true;
+
+	fds[shard] = connect_to(addresses[shard]);
+	if(fds[shard] == -1)
+	{
+		std::clog << "Shard " << addresses[shard] << " is unreachable" << std::endl;
+		return false;
+	}
+
+	// A shard that hangs times out the reads, then it's dropped like a dead one
+	if(timeout.count())
+	{
+		timeval tv = {.tv_sec = timeout.count() / 1000, .tv_usec = (timeout.count() % 1000) * 1000};
+		setsockopt(fds[shard], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	}
+
+	return true;
+}
+
+void shard_client::drop_shard(size_t shard)
+{
+	std::clog << "Shard " << addresses[shard] << " failed, reconnecting at the next query" << std::endl;
+
+	// Its late response must not be read as the next query's one
+	close(fds[shard]);
+	fds[shard] = -1;
+}
+
+void shard_client::ask(size_t first, size_t last, const std::string& query, sindex::score_t threshold,
+					   std::vector<std::vector<sindex::result_t>>& shard_results, bool& partial, bool& approximate)
+{
+	const auto request = query_request(query, threshold);
+
+	// All the requests go out before waiting for any response, so that the shards solve the query concurrently
+	std::vector<bool> sent(last - first, false);
+	for(size_t shard = first; shard < last; ++shard)
+	{
+		if(not connect_shard(shard))
+			continue;
+
+		sent[shard - first] = send_message(fds[shard], request);
+		if(not sent[shard - first])
+			drop_shard(shard);
+	}
+
+	std::string response;
+	for(size_t shard = first; shard < last; ++shard)
+	{
+		bool shard_approximate, shard_partial;
+		if(sent[shard - first] and recv_message(fds[shard], response) and
+		   parse_response(response, shard_results[shard], shard_approximate, shard_partial))
+		{
+			// A shard can be a coordinator too
+			approximate |= shard_approximate;
+			partial |= shard_partial;
+			continue;
+		}
+
+		if(sent[shard - first])
+			drop_shard(shard);
+
+		shard_results[shard].clear();
+		n_failures += 1;
+		partial = true;
+	}
+}
+
+std::vector<sindex::result_t> shard_client::search(const std::string& query, size_t k, bool *partial,
+												   sindex::score_t threshold, bool *approximate)
+{
+	std::vector<std::vector<sindex::result_t>> shard_results(addresses.size());
+	const size_t n_first = n_probes == 0 ? addresses.size() : std::min(n_probes, addresses.size());
+
+	bool any_partial = false, any_approximate = false;
+	ask(0, n_first, query, threshold, shard_results, any_partial, any_approximate);
+
+	// The other shards only have to beat the probes' k-th result
+	if(n_first < addresses.size())
+	{
+		const auto probe_results = merge(shard_results, k);
+		if(probe_results.size() == k)
+			threshold = std::max(threshold, probe_results.back().score);
+
+		ask(n_first, addresses.size(), query, threshold, shard_results, any_partial, any_approximate);
+	}
+
+	if(partial)
+		*partial = any_partial;
+	if(approximate)
+		*approximate = any_approximate;
+
+	return merge(shard_results, k);
+}
+
+bool shard_client::parse_response(const std::string& response, std::vector<sindex::result_t>& results, bool& approximate,
+								  bool& partial)
+{
+	results.clear();
+	approximate = partial = false;
+
+	// An error response counts as a failure of the shard
+	std::istringstream lines(response);
+	std::string line;
+	if(not std::getline(lines, line))
+		return false;
+
+	std::istringstream status(line);
+	std::string word;
+	if(not (status >> word) or word != "ok")
+		return false;
+
+	while(status >> word)
+	{
+		approximate |= word == "approximate";
+		partial |= word == "partial";
+	}
+
+	while(std::getline(lines, line))
+	{
+		const auto tab = line.find('\t');
+		if(tab == std::string::npos)
+			return false;
+
+		std::istringstream score(line.substr(tab + 1));
+		sindex::result_t result = {.docno = line.substr(0, tab), .score = 0};
+		if(not (score >> result.score))
+			return false;
+
+		results.push_back(std::move(result));
+	}
+
+	return true;
+}
+
+std::vector<sindex::result_t> shard_client::merge(const std::vector<std::vector<sindex::result_t>>& shard_results, size_t k)
+{
+	// The heap merge works on docids, a result's position in its shard's list stands for it
+	std::vector<std::vector<sindex::docid_result_t>> positions(shard_results.size());
+	for(size_t shard = 0; shard < shard_results.size(); ++shard)
+		for(size_t pos = 0; pos < shard_results[shard].size(); ++pos)
+			positions[shard].push_back({.docid = (sindex::docid_t)pos, .score = shard_results[shard][pos].score});
+
+	std::vector<sindex::result_t> merged;
+	for(const auto& result : sindex::merge_top_k(positions, k))
+		merged.push_back(shard_results[result.shard][result.docid]);
+
+	return merged;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../index/types.hpp"
+
+/**
+ * Fans a query out to the engines serving the shards of a collection (see `engine --shard`) and merges their top-k.
+ * The probe shards are asked first; the k-th score of their merged results is then sent, as the threshold, to all the
+ * other shards at once, so that they only return, and prune for, the documents that can still enter the top-k.
+ * A shard that can't be reached, or doesn't answer in time, is left out of the query and reconnected to at the next
+ * one: its results are missing, the others' are still returned.
+ * A client is not thread safe, it keeps one connection per shard.
+ */
+class shard_client
+{
+	std::vector<std::string> addresses;
+	// -1 if not connected
+	std::vector<int> fds;
+	size_t n_probes;
+	std::chrono::milliseconds timeout;
+
+	std::atomic<size_t> n_failures = 0;
+
+	/** Connects to a shard if it isn't already, false on failure */
+	bool connect_shard(size_t shard);
+	void drop_shard(size_t shard);
+
+	/**
+	 * Sends the query to the shards [first, last) and collects their results, best first. The ones that fail leave an
+	 * empty cell
+	 * @param partial set to true if any of them failed, or answered with partial results
+	 * @param approximate set to true if any of them answered with approximate results
+	 */
+	void ask(size_t first, size_t last, const std::string& query, sindex::score_t threshold,
+			 std::vector<std::vector<sindex::result_t>>& shard_results, bool& partial, bool& approximate);
+
+public:
+	/**
+	 * @param addresses the shards' engines, see query_server::listen
+	 * @param n_probes how many shards, the first ones, are asked before the others. 0 asks all of them at once
+	 * @param timeout how long to wait for a shard's results, 0 to wait forever
+	 */
+	explicit shard_client(std::vector<std::string> addresses, size_t n_probes = 1,
+						  std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+	~shard_client();
+
+	shard_client(const shard_client&) = delete;
+	shard_client& operator=(const shard_client&) = delete;
+
+	/**
+	 * Solves a query on all the shards
+	 * @param k the shards' engines must return at least k results
+	 * @param partial set to true if some shard's results are missing
+	 * @param threshold only the documents scoring more than this are needed, as for the engine's requests
+	 * @param approximate set to true if some shard stopped the query early, see the engine's budgets
+	 * @return the best k results, best first
+	 */
+	std::vector<sindex::result_t> search(const std::string& query, size_t k, bool *partial = nullptr,
+										 sindex::score_t threshold = 0, bool *approximate = nullptr);
+
+	/** Shards left out of a query, summed over the queries */
+	size_t failures() const {return n_failures;}
+
+	/**
+	 * Parses a response of the engine's server mode, see query_response
+	 * @param approximate, partial set as told by the response's status line
+	 * @return false if it's malformed or an error
+	 */
+	static bool parse_response(const std::string& response, std::vector<sindex::result_t>& results, bool& approximate,
+							   bool& partial);
+
+	/** Merges the shards' results, each one best first, into the best k. Ties go to the lowest shard */
+	static std::vector<sindex::result_t> merge(const std::vector<std::vector<sindex::result_t>>& shard_results, size_t k);
+};
@@ -1,8 +1,9 @@
 #include <cassert>
 #include "thread_pool.hpp"
+#include "affinity.hpp"
 
 thread_pool::thread_pool(size_t n_workers):
-	idling(new std::atomic_bool[n_workers])
+	idling(new std::atomic_bool[n_workers]), worker_jobs(new std::queue<Task>[n_workers])
 {
 	for(size_t i = 0; i < n_workers; ++i)
 	{
@@ -34,6 +35,33 @@ void thread_pool::add_job(const Task&& job)
 	jobs_queue_cv.notify_one();
 }
 
+void thread_pool::add_job(size_t worker_id, const Task&& job)
+{
+	std::lock_guard queue_lock{jobs_queue_mutex};
+	worker_jobs[worker_id % workers.size()].emplace(job);
+	// The shared condition variable may wake up the wrong worker
+	jobs_queue_cv.notify_all();
+}
+
+bool thread_pool::pin_workers(const std::vector<int>& cpus)
+{
+	bool pinned = not cpus.empty();
+	for(size_t i = 0; i < workers.size() and not cpus.empty(); ++i)
+		pinned = pin_thread(workers[i], cpus[i % cpus.size()]) and pinned;
+
+	return pinned;
+}
+
+// Must be called with the jobs' lock held
+bool thread_pool::all_queues_empty() const
+{
+	for(size_t i = 0; i < workers.size(); ++i)
+		if(not worker_jobs[i].empty())
+			return false;
+
+	return jobs.empty();
+}
+
 template<class T>
 static T front_and_pop(std::queue<T>& q)
 {
@@ -50,18 +78,19 @@ void thread_pool::worker_procedure(size_t worker_id)
 		auto [stop, job] = [&] () -> std::pair<bool, Task>
 		{
 			std::unique_lock queue_lock(jobs_queue_mutex);
-			jobs_queue_cv.wait(queue_lock, [&]{ return halt or not jobs.empty(); });
+			auto& own_jobs = worker_jobs[worker_id];
+			jobs_queue_cv.wait(queue_lock, [&]{ return halt or not jobs.empty() or not own_jobs.empty(); });
 
 			// HALT
-			if (halt and jobs.empty())
+			if (halt and jobs.empty() and own_jobs.empty())
 				return {true, nullptr};
 
-			assert(not jobs.empty());
+			assert(not jobs.empty() or not own_jobs.empty());
 
 			// Found a job
 			idling[worker_id] = false;
 			jobs_queue_popped_cv.notify_all();
-			return {false, front_and_pop(jobs)};
+			return {false, front_and_pop(own_jobs.empty() ? jobs : own_jobs)};
 		}();
 
 		if(not stop)
@@ -82,7 +111,7 @@ void thread_pool::wait_for_empty_queue()
 {
 	// Critical section, wait the queue to be empty
 	std::unique_lock queue_lock(jobs_queue_mutex);
-	jobs_queue_popped_cv.wait(queue_lock, [&]{ return jobs.empty(); });
+	jobs_queue_popped_cv.wait(queue_lock, [&]{ return all_queues_empty(); });
 }
 
 void thread_pool::wait_for_free_worker()
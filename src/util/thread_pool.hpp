@@ -22,6 +22,8 @@ class thread_pool
 
 	// and Resources
 	std::queue<Task> jobs;
+	// Jobs that must run on a given worker, they're picked before the shared ones
+	std::unique_ptr<std::queue<Task>[]> worker_jobs;
 
 	// and mechanisms, too
 	std::condition_variable jobs_queue_cv;
@@ -33,6 +35,7 @@ class thread_pool
 
 	// workers' main loop
 	void worker_procedure(size_t worker_id);
+	bool all_queues_empty() const;
 
 public:
 	explicit thread_pool(size_t n_workers = std::thread::hardware_concurrency());
@@ -41,4 +44,15 @@ public:
 	void wait_for_free_worker();
 	void wait_all_jobs();
 	void add_job(const Task&& job);
+
+	/** Adds a job that only the given worker will run */
+	void add_job(size_t worker_id, const Task&& job);
+
+	/**
+	 * Pins the i-th worker to the CPU cpus[i % cpus.size()]
+	 * @return false if some worker could not be pinned
+	 */
+	bool pin_workers(const std::vector<int>& cpus);
+
+	size_t size() const {return workers.size();}
 };
@@ -0,0 +1,131 @@
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "trace.hpp"
+
+namespace trace
+{
+
+namespace
+{
+struct event_t
+{
+	const char *name;
+	const char *category;
+	double start_us;
+	double duration_us;
+};
+
+/** A thread's events, only its owner writes them while recording */
+struct thread_buffer_t
+{
+	uint64_t tid;
+	std::mutex mutex;
+	std::vector<event_t> events;
+};
+
+std::atomic<bool> recording = false;
+std::string trace_path;
+std::chrono::steady_clock::time_point epoch;
+
+// The buffers of all the threads that recorded something, they outlive their threads
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<thread_buffer_t>> buffers;
+
+thread_buffer_t& this_thread_buffer()
+{
+	thread_local thread_buffer_t *buffer = [] {
+		std::lock_guard guard(buffers_mutex);
+		auto& buffer = buffers.emplace_back(std::make_unique<thread_buffer_t>());
+		buffer->tid = buffers.size();
+		return buffer.get();
+	}();
+
+	return *buffer;
+}
+
+/** Names are literals in the code, only quotes and backslashes could break the JSON */
+void write_escaped(std::ostream& out, const char *str)
+{
+	for(; *str; ++str)
+	{
+		if(*str == '"' or *str == '\\')
+			out << '\\';
+		out << *str;
+	}
+}
+}
+
+bool start(const std::string& path)
+{
+#ifdef SEARCHENGINECPP_TRACE
+	trace_path = path;
+	epoch = std::chrono::steady_clock::now();
+	recording = true;
+	return true;
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+void stop()
+{
+	if(not recording.exchange(false))
+		return;
+
+	std::ofstream out(trace_path);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+	bool first = true;
+	std::lock_guard guard(buffers_mutex);
+	for(auto& buffer : buffers)
+	{
+		std::lock_guard buffer_guard(buffer->mutex);
+		for(const auto& event : buffer->events)
+		{
+			out << (first ? "" : ",\n") << "{\"name\": \"";
+			write_escaped(out, event.name);
+			out << "\", \"cat\": \"";
+			write_escaped(out, event.category);
+			out << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->tid << ", \"ts\": " << event.start_us
+				<< ", \"dur\": " << event.duration_us << '}';
+			first = false;
+		}
+
+		buffer->events.clear();
+	}
+
+	out << "\n]}\n";
+}
+
+bool enabled()
+{
+	return recording.load(std::memory_order_relaxed);
+}
+
+span::span(const char *name, const char *category):
+		name(name), category(category), recording(enabled())
+{
+	if(recording)
+		start_time = std::chrono::steady_clock::now();
+}
+
+span::~span()
+{
+	// Stopped meanwhile, the buffers may be being written
+	if(not recording or not enabled())
+		return;
+
+	using namespace std::chrono;
+	const auto stop_time = steady_clock::now();
+
+	auto& buffer = this_thread_buffer();
+	std::lock_guard guard(buffer.mutex);
+	buffer.events.push_back({name, category, duration<double, std::micro>(start_time - epoch).count(),
+							 duration<double, std::micro>(stop_time - start_time).count()});
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+ * Tracing of the hot paths, in Chrome's trace event format (chrome://tracing, https://ui.perfetto.dev).
+ * A TRACE_SPAN records how long its scope took on the current thread, nested spans are shown nested. The spans are
+ * compiled in only with the USE_TRACING CMake option, and recorded only between trace::start and trace::stop: a
+ * compiled in span that is not recorded costs one relaxed atomic load.
+ */
+
+namespace trace
+{
+
+/**
+ * Starts recording the spans of all the threads
+ * @param path where trace::stop will write the trace
+ * @return false if tracing was not compiled in
+ */
+bool start(const std::string& path);
+
+/** Stops recording and writes the trace. Spans still open are dropped */
+void stop();
+
+bool enabled();
+
+/** Records its lifetime as a complete event. The name must be a string literal */
+class span
+{
+	const char *name;
+	const char *category;
+	std::chrono::steady_clock::time_point start_time;
+	bool recording;
+
+public:
+	span(const char *name, const char *category);
+	~span();
+
+	span(const span&) = delete;
+	span& operator=(const span&) = delete;
+};
+
+}
+
+#ifdef SEARCHENGINECPP_TRACE
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SPAN(name, category) const trace::span TRACE_CONCAT(trace_span_, __LINE__)(name, category)
+#else
+#define TRACE_SPAN(name, category) do {} while(false)
+#endif
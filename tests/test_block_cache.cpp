@@ -0,0 +1,110 @@
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "util/block_cache.hpp"
+#include "util/io_ring.hpp"
+
+static std::string write_test_file(size_t length)
+{
+	std::string path = "/tmp/test_block_cache_" + std::to_string(getpid());
+	std::ofstream out(path, std::ios::binary);
+	for(size_t i = 0; i < length; ++i)
+		out.put((char)(i * 7 + i / 251));
+
+	return path;
+}
+
+static uint8_t expected_byte(size_t i) {return (uint8_t)(i * 7 + i / 251);}
+
+TEST(BlockCache, reads_ranges)
+{
+	constexpr size_t length = 5 * memory_block_cache::BLOCK_SIZE + 123;
+	const auto path = write_test_file(length);
+
+	{
+		memory_block_cache cache(path, length);
+		ASSERT_EQ(cache.get().second, length);
+		const uint8_t *data = cache.get().first;
+
+		// Ranges across blocks, overlapping and past the end of the file
+		std::vector<std::pair<size_t, size_t>> ranges = {{10, 100}, {memory_block_cache::BLOCK_SIZE - 5, 10},
+														  {3 * memory_block_cache::BLOCK_SIZE, 2 * memory_block_cache::BLOCK_SIZE},
+														  {length - 10, 100}, {0, 0}};
+		auto pins = cache.acquire(ranges);
+		ASSERT_EQ(pins.size(), ranges.size());
+
+		for(const auto& [offset, len] : ranges)
+			for(size_t i = offset; i < std::min(offset + len, length); ++i)
+				ASSERT_EQ(data[i], expected_byte(i));
+
+		ASSERT_EQ(cache.evictions(), 0);
+
+		// Already loaded
+		const size_t misses = cache.misses(), hits = cache.hits();
+		auto more_pins = cache.acquire({{20, 30}});
+		ASSERT_EQ(cache.misses(), misses);
+		ASSERT_EQ(cache.hits(), hits + 1);
+	}
+
+	std::remove(path.c_str());
+}
+
+TEST(BlockCache, evicts_and_reloads)
+{
+	constexpr size_t length = 8 * memory_block_cache::BLOCK_SIZE;
+	const auto path = write_test_file(length);
+
+	{
+		// Room for two blocks only
+		memory_block_cache cache(path, 2 * memory_block_cache::BLOCK_SIZE);
+		const uint8_t *data = cache.get().first;
+
+		for(int round = 0; round < 2; ++round)
+			for(size_t b = 0; b < 8; ++b)
+			{
+				const size_t offset = b * memory_block_cache::BLOCK_SIZE + 1000;
+				auto pins = cache.acquire({{offset, 500}});
+				for(size_t i = offset; i < offset + 500; ++i)
+					ASSERT_EQ(data[i], expected_byte(i));
+			}
+
+		ASSERT_EQ(cache.misses(), 16);
+		ASSERT_EQ(cache.evictions(), 14);
+
+		// Pinned blocks are never evicted, even past the capacity
+		auto pins = cache.acquire({{0, length}});
+		for(size_t i = 0; i < length; i += 997)
+			ASSERT_EQ(data[i], expected_byte(i));
+	}
+
+	std::remove(path.c_str());
+}
+
+TEST(IoRing, read)
+{
+	constexpr size_t length = 300'000;
+	const auto path = write_test_file(length);
+	const int fd = open(path.c_str(), O_RDONLY);
+	ASSERT_NE(fd, -1);
+
+	// More requests than the ring's entries, one of them past the end of the file
+	io_ring ring(8);
+	std::vector<std::vector<uint8_t>> buffs(20, std::vector<uint8_t>(1000));
+	std::vector<read_request> reqs;
+	for(size_t i = 0; i < buffs.size(); ++i)
+		reqs.push_back({buffs[i].data(), 1000, (off_t)(i * 14'000)});
+	reqs.push_back({buffs[0].data(), 1000, (off_t)length});
+
+	ASSERT_FALSE(ring.read(fd, reqs));
+
+	reqs.pop_back();
+	ASSERT_TRUE(ring.read(fd, reqs));
+	for(size_t i = 0; i < buffs.size(); ++i)
+		for(size_t j = 0; j < 1000; ++j)
+			ASSERT_EQ(buffs[i][j], expected_byte(i * 14'000 + j));
+
+	close(fd);
+	std::remove(path.c_str());
+}
@@ -81,3 +81,36 @@ TEST(UnaryCode, encode_decode)
 	for(size_t i = 0; i < data_to_encode.size(); i++)
 		ASSERT_EQ(data_to_encode[i], data_decoded[i]);
 }
+
+TEST(UnaryCode, encode_last_value_across_bytes)
+{
+	// The first byte ends in the middle of the 4, its last bits go in a second byte
+	const std::vector<uint64_t> data_to_encode{6, 4};
+
+	codes::UnaryEncoder encoder(data_to_encode.begin(), data_to_encode.end());
+	const std::vector<uint8_t> encoded(encoder.begin(), encoder.end());
+	ASSERT_EQ(encoded.size(), 2);
+
+	codes::UnaryDecoder decoder(encoded.begin(), encoded.end());
+	auto it = decoder.begin();
+	ASSERT_EQ(*it, 6);
+	ASSERT_EQ(*++it, 4);
+}
+
+TEST(UnaryCode, restart_at_datum)
+{
+	// Some data span more bytes
+	const std::vector<uint64_t> values{3, 1, 12, 2, 9, 1, 17, 1, 6};
+	codes::UnaryEncoder encoder(values.begin(), values.end());
+	const std::vector<uint8_t> data(encoder.begin(), encoder.end());
+
+	// Decoding from where a datum starts gives back the same datum, as seeking to a skip block does
+	codes::UnaryDecoder decoder(data.begin(), data.end());
+	size_t i = 0;
+	for(auto it = decoder.begin(); i < values.size(); ++it, ++i)
+	{
+		ASSERT_EQ(*it, values[i]);
+		const auto restarted = decoder.at(it.get_datum_raw_iterator() - data.begin(), it.get_bit_offset());
+		ASSERT_EQ(*restarted, values[i]) << " at index " << i;
+	}
+}
@@ -130,6 +130,13 @@ TEST_F(DiskTest, data_search)
 	}
 }
 
+TEST_F(DiskTest, data_search_before_first)
+{
+	// Generated keys only have lowercase letters, these sort before all of them
+	ASSERT_EQ(map->find("0"), map->end());
+	ASSERT_EQ(map->find("Autocisterna"), map->end());
+}
+
 TEST_F(DiskTest, data_search_complete)
 {
 	size_t index = 0;
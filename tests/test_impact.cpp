@@ -0,0 +1,44 @@
+#include <map>
+#include <random>
+#include "gtest/gtest.h"
+#include "index/impact.hpp"
+
+TEST(ImpactQuantizer, quantize)
+{
+	sindex::ImpactQuantizer quantizer(10.0);
+
+	ASSERT_EQ(quantizer.quantize(0), 0);
+	ASSERT_EQ(quantizer.quantize(10.0), sindex::ImpactQuantizer::levels);
+	ASSERT_EQ(quantizer.quantize(20.0), sindex::ImpactQuantizer::levels);
+
+	// Tiny scores must not be lost
+	ASSERT_EQ(quantizer.quantize(1e-9), 1);
+
+	for(double score = 0.1; score < 10.0; score += 0.37)
+		ASSERT_NEAR(quantizer.dequantize(quantizer.quantize(score)), score, 10.0 / sindex::ImpactQuantizer::levels);
+}
+
+TEST(ImpactAccumulators, reuse)
+{
+	sindex::ImpactAccumulators accumulators;
+	std::mt19937 gen(0xcafebabe);
+
+	for(size_t n_docs : {100'000, 5'000, 70'000})
+	{
+		std::uniform_int_distribution<size_t> distrib_doc(0, n_docs - 1);
+		std::map<size_t, uint32_t> expected;
+
+		accumulators.reset(n_docs);
+		for(int i = 0; i < 3'000; ++i)
+		{
+			auto doc = distrib_doc(gen);
+			accumulators.add(doc, i % 7 + 1);
+			expected[doc] += i % 7 + 1;
+		}
+
+		std::map<size_t, uint32_t> got;
+		accumulators.for_each([&](size_t doc, uint32_t acc) { got[doc] = acc; });
+
+		ASSERT_EQ(expected, got);
+	}
+}
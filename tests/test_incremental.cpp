@@ -0,0 +1,263 @@
+#include <filesystem>
+#include <map>
+#include <random>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "index_worker.hpp"
+#include "indexBuilder/chunks.hpp"
+#include "indexBuilder/sigma_lexicon.hpp"
+
+/*
+ * An index grown by appending chunks, deleting documents and merging chunks, queried after each step as the engine
+ * does and checked against an exhaustive scan of the documents it should hold.
+ */
+
+static constexpr size_t TOP_K = 10;
+
+class Incremental : public testing::Test
+{
+protected:
+	struct document_t
+	{
+		std::map<std::string, sindex::freq_t> tfs;
+		sindex::doclen_t len = 0;
+	};
+
+	std::filesystem::path dir;
+	std::mt19937 rng{42};
+
+	// The documents in the index, the deleted ones too until a merge drops them
+	std::map<sindex::docno_t, document_t> collection;
+	std::set<sindex::docno_t> deleted;
+	size_t next_doc = 1;
+
+	std::vector<std::set<std::string>> queries;
+
+	void SetUp() override
+	{
+		dir = std::filesystem::temp_directory_path()/("test_incremental_" + std::to_string(getpid()));
+		std::filesystem::remove_all(dir);
+		std::filesystem::create_directories(dir);
+
+		std::uniform_int_distribution<size_t> n_terms_distribution(1, 3), term_distribution(0, 7);
+		for(size_t q = 0; q < 50; ++q)
+		{
+			std::set<std::string> query;
+			for(size_t n_terms = n_terms_distribution(rng); query.size() < n_terms;)
+				query.insert("t" + std::to_string(term_distribution(rng)));
+			queries.push_back(std::move(query));
+		}
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove_all(dir);
+	}
+
+	/** Writes n new documents as the chunk db_N, their docids follow the ones already in the index */
+	std::vector<sindex::docno_t> add_chunk(size_t chunk_n, sindex::docid_t base_docid, size_t n, const std::string& extra_term = "")
+	{
+		const std::vector<double> term_probabilities = {0.8, 0.5, 0.3, 0.2, 0.1, 0.05, 0.02, 0.01};
+		std::uniform_int_distribution<sindex::freq_t> tf_distribution(1, 5);
+		std::uniform_real_distribution<double> coin(0, 1);
+
+		sindex::IndexBuilder index_builder(n, base_docid);
+		std::map<std::string, std::map<sindex::docid_t, sindex::freq_t>> postings;
+		std::vector<sindex::docno_t> docnos;
+		for(sindex::docid_t docid = base_docid; docid < base_docid + n; ++docid)
+		{
+			const auto docno = "D" + std::to_string(next_doc++);
+			auto& doc = collection[docno];
+			doc.len = tf_distribution(rng);
+			for(size_t t = 0; t < term_probabilities.size(); ++t)
+				if(coin(rng) < term_probabilities[t])
+					doc.tfs["t" + std::to_string(t)] = tf_distribution(rng);
+			if(not extra_term.empty() and coin(rng) < 0.3)
+				doc.tfs[extra_term] = tf_distribution(rng);
+
+			for(const auto& [term, tf] : doc.tfs)
+			{
+				postings[term][docid] = tf;
+				doc.len += tf;
+			}
+
+			index_builder.add_to_doc(docid, {.docno = docno, .lenght = doc.len});
+			docnos.push_back(docno);
+		}
+
+		for(const auto& [term, term_postings] : postings)
+			for(const auto& [docid, tf] : term_postings)
+				index_builder.add_to_post(term, docid, tf);
+
+		write_chunk(index_builder, dir/("db_" + std::to_string(chunk_n)), false);
+		return docnos;
+	}
+
+	/** Rewrites what depends on the whole collection, as the builder does after appending or merging */
+	void rewrite_collection_files()
+	{
+		std::vector<std::filesystem::path> chunk_dirs;
+		for(const auto& chunk : list_chunks(dir))
+			chunk_dirs.push_back(chunk.path);
+
+		sindex::doclen_t doc_len_sum = 0;
+		for(const auto& [docno, doc] : collection)
+			doc_len_sum += doc.len;
+
+		write_global_lexicon(dir, chunk_dirs);
+		write_metadata(dir, collection.size(), doc_len_sum, false);
+		for(const auto& chunk_dir : chunk_dirs)
+			write_sigma_lexicon(chunk_dir, false, false);
+	}
+
+	/** Solves the query on every chunk, as the engine does, and merges their top-k */
+	std::vector<sindex::result_t> search(const std::set<std::string>& query)
+	{
+		memory_mmap metadata_mem(dir/"metadata");
+		memory_mmap global_lexicon_mem(dir/"global_lexicon");
+		sindex::Index<sindex::SigmaLexiconValue>::global_lexicon_t global_lexicon(global_lexicon_mem);
+
+		std::vector<sindex::result_t> results;
+		for(const auto& chunk : list_chunks(dir))
+		{
+			index_worker_t<sindex::SigmaLexiconValue> worker(chunk.path, metadata_mem, global_lexicon, "lexicon");
+			for(const auto& result : worker.index.query<sindex::QueryBM25Scorer>(query, false, TOP_K))
+				results.push_back({.docno = sindex::docno_t(worker.index.get_docno(result.docid)), .score = result.score});
+		}
+
+		std::sort(results.begin(), results.end(), std::greater<>());
+		results.resize(std::min(results.size(), TOP_K));
+		return results;
+	}
+
+	/** The BM25 scores of the live documents matching the query, the deleted ones count in the statistics */
+	std::map<sindex::docno_t, sindex::score_t> scan(const std::set<std::string>& query) const
+	{
+		const sindex::QueryBM25Scorer scorer;
+		sindex::doclen_t doc_len_sum = 0;
+		std::map<std::string, size_t> n_docs_of_term;
+		for(const auto& [docno, doc] : collection)
+		{
+			doc_len_sum += doc.len;
+			for(const auto& [term, tf] : doc.tfs)
+				n_docs_of_term[term] += 1;
+		}
+		const double avgdl = (double)doc_len_sum / collection.size();
+
+		std::map<sindex::docno_t, sindex::score_t> scores;
+		for(const auto& [docno, doc] : collection)
+			for(const auto& term : query)
+				if(auto tf_it = doc.tfs.find(term); tf_it != doc.tfs.end() and not deleted.contains(docno))
+					scores[docno] += scorer.score(tf_it->second, sindex::QueryTFIDFScorer::idf(collection.size(), n_docs_of_term[term]),
+												  scorer.doc_norm(doc.len, avgdl));
+
+		return scores;
+	}
+
+	/** Checks the results against the scan: the same k-th best scores, each result with its exact score */
+	static void expect_top_k(const std::vector<sindex::result_t>& results,
+							 const std::map<sindex::docno_t, sindex::score_t>& exact_scores, size_t q)
+	{
+		std::vector<sindex::score_t> best;
+		for(const auto& [docno, score] : exact_scores)
+			best.push_back(score);
+		std::sort(best.begin(), best.end(), std::greater<>());
+		best.resize(std::min(best.size(), TOP_K));
+
+		ASSERT_EQ(results.size(), best.size()) << " query " << q;
+		for(size_t i = 0; i < results.size(); ++i)
+		{
+			ASSERT_TRUE(exact_scores.contains(results[i].docno)) << " query " << q << " docno " << results[i].docno;
+			EXPECT_NEAR(results[i].score, exact_scores.at(results[i].docno), 1e-9) << " query " << q;
+			EXPECT_NEAR(results[i].score, best[i], 1e-9) << " query " << q << " rank " << i;
+		}
+	}
+
+	void expect_all_queries()
+	{
+		for(size_t q = 0; q < queries.size(); ++q)
+			expect_top_k(search(queries[q]), scan(queries[q]), q);
+	}
+};
+
+TEST_F(Incremental, append_delete_merge)
+{
+	add_chunk(0, 1, 400);
+	add_chunk(1, 401, 400);
+	rewrite_collection_files();
+	expect_all_queries();
+
+	// Appended documents are searchable, the ones with the new term too
+	const auto appended = add_chunk(2, 801, 200, "fresh");
+	rewrite_collection_files();
+	expect_all_queries();
+
+	const auto fresh_results = search({"fresh"});
+	ASSERT_FALSE(fresh_results.empty());
+	for(const auto& result : fresh_results)
+		EXPECT_NE(std::find(appended.begin(), appended.end(), result.docno), appended.end()) << result.docno;
+	expect_top_k(fresh_results, scan({"fresh"}), 0);
+
+	// Merging chunks without deletions returns the same results as before
+	std::vector<std::vector<sindex::result_t>> before_merge;
+	for(const auto& query : queries)
+		before_merge.push_back(search(query));
+
+	std::mutex disk_writer_mutex;
+	auto chunks = list_chunks(dir);
+	ASSERT_EQ(chunks.size(), 3);
+	ASSERT_EQ(merge_chunks(dir, {chunks[0], chunks[1]}, 3, disk_writer_mutex), std::make_pair(size_t(0), sindex::doclen_t(0)));
+	rewrite_collection_files();
+	ASSERT_EQ(list_chunks(dir).size(), 2);
+
+	for(size_t q = 0; q < queries.size(); ++q)
+	{
+		const auto results = search(queries[q]);
+		ASSERT_EQ(results.size(), before_merge[q].size()) << " query " << q;
+		for(size_t i = 0; i < results.size(); ++i)
+		{
+			EXPECT_NEAR(results[i].score, before_merge[q][i].score, 1e-9) << " query " << q << " rank " << i;
+			// Ties may be broken in another order, with the documents past the k-th too
+			const auto tie = [&](const sindex::result_t& r) {return r.score == results[i].score;};
+			if(std::count_if(results.begin(), results.end(), tie) == 1 and results[i].score > results.back().score)
+			{
+				EXPECT_EQ(results[i].docno, before_merge[q][i].docno) << " query " << q << " rank " << i;
+			}
+		}
+	}
+
+	// Deleted documents are kept out of the results, they still count in the statistics
+	std::unordered_set<sindex::docno_t> to_delete;
+	for(const auto& [docno, doc] : collection)
+		if(std::hash<std::string>{}(docno) % 5 == 0)
+			to_delete.insert(docno);
+	// Including some of the appended ones
+	to_delete.insert(appended.front());
+
+	ASSERT_EQ(delete_documents(dir, list_chunks(dir), to_delete), to_delete.size());
+	deleted.insert(to_delete.begin(), to_delete.end());
+	expect_all_queries();
+	expect_top_k(search({"fresh"}), scan({"fresh"}), 0);
+
+	// Deleting them again changes nothing
+	ASSERT_EQ(delete_documents(dir, list_chunks(dir), to_delete), 0);
+
+	// A merge drops them
+	sindex::doclen_t deleted_len = 0;
+	for(const auto& docno : deleted)
+	{
+		deleted_len += collection.at(docno).len;
+		collection.erase(docno);
+	}
+	deleted.clear();
+
+	chunks = list_chunks(dir);
+	ASSERT_EQ(merge_chunks(dir, chunks, 4, disk_writer_mutex), std::make_pair(to_delete.size(), deleted_len));
+	rewrite_collection_files();
+	ASSERT_EQ(list_chunks(dir).size(), 1);
+	expect_all_queries();
+
+	// The collection's files were rewritten in place, no leftovers
+	for(const auto& entry : std::filesystem::recursive_directory_iterator(dir))
+		EXPECT_NE(entry.path().extension(), ".tmp") << entry.path();
+}
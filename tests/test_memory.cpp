@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "util/memory.hpp"
+
+TEST(MmapPolicy, parse)
+{
+	mmap_policy policy;
+	ASSERT_TRUE(mmap_policy::parse("random,populate,lock,thp", policy));
+	ASSERT_EQ(policy.access, mmap_policy::RANDOM);
+	ASSERT_TRUE(policy.populate);
+	ASSERT_TRUE(policy.lock);
+	ASSERT_EQ(policy.huge_pages, mmap_policy::TRANSPARENT_HUGE_PAGES);
+
+	ASSERT_TRUE(mmap_policy::parse("sequential,hugetlb", policy));
+	ASSERT_EQ(policy.access, mmap_policy::SEQUENTIAL);
+	ASSERT_EQ(policy.huge_pages, mmap_policy::EXPLICIT_HUGE_PAGES);
+
+	ASSERT_FALSE(mmap_policy::parse("random,fast", policy));
+	ASSERT_FALSE(mmap_policy::parse("", policy));
+}
+
+TEST(MmapPolicy, same_contents)
+{
+	const std::string path = "/tmp/test_memory_" + std::to_string(getpid());
+	constexpr size_t length = 3 << 20;
+	{
+		std::ofstream out(path, std::ios::binary);
+		for(size_t i = 0; i < length; ++i)
+			out.put((char)(i % 253));
+	}
+
+	std::vector<mmap_policy> policies = {{}, {.access = mmap_policy::RANDOM, .populate = true},
+										 {.access = mmap_policy::SEQUENTIAL, .lock = true},
+										 {.huge_pages = mmap_policy::TRANSPARENT_HUGE_PAGES},
+										 // Falls back to normal pages if none are reserved
+										 {.huge_pages = mmap_policy::EXPLICIT_HUGE_PAGES}};
+	for(const auto& policy : policies)
+	{
+		memory_mmap mem(path, policy);
+		auto [buff, size] = mem.get();
+		ASSERT_EQ(size, length);
+		for(size_t i = 0; i < length; i += 4091)
+			ASSERT_EQ(buff[i], i % 253);
+	}
+
+	std::remove(path.c_str());
+}
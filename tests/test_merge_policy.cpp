@@ -0,0 +1,41 @@
+#include "gtest/gtest.h"
+#include "indexBuilder/merge_policy.hpp"
+
+TEST(MergePolicy, tiers)
+{
+	const sindex::merge_policy_t policy = {.factor = 4, .min_size = 10, .max_size = 1000};
+
+	ASSERT_EQ(policy.tier(1), 0);
+	ASSERT_EQ(policy.tier(10), 0);
+	ASSERT_EQ(policy.tier(11), 1);
+	ASSERT_EQ(policy.tier(40), 1);
+	ASSERT_EQ(policy.tier(41), 2);
+}
+
+TEST(MergePolicy, merges_adjacent_chunks_of_a_tier)
+{
+	const sindex::merge_policy_t policy = {.factor = 4, .min_size = 10, .max_size = 1000};
+
+	// Not enough chunks in the first tier
+	ASSERT_TRUE(policy.plan({5, 5, 5}).empty());
+
+	// A bigger chunk breaks the run
+	ASSERT_TRUE(policy.plan({5, 5, 30, 5, 5}).empty());
+
+	auto merges = policy.plan({30, 5, 5, 5, 5, 5, 20, 20, 20, 20});
+	ASSERT_EQ(merges.size(), 2);
+	ASSERT_EQ(merges[0].first, 1);
+	ASSERT_EQ(merges[0].second, 5);
+	ASSERT_EQ(merges[1].first, 6);
+	ASSERT_EQ(merges[1].second, 10);
+
+	// The merged chunk would be too big
+	ASSERT_TRUE(policy.plan({400, 300, 200, 200}).empty());
+	ASSERT_TRUE(policy.plan({2000, 2000, 2000, 2000}).empty());
+}
+
+TEST(MergePolicy, disabled)
+{
+	const sindex::merge_policy_t policy = {.factor = 0};
+	ASSERT_TRUE(policy.plan({1, 1, 1, 1, 1}).empty());
+}
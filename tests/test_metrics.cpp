@@ -0,0 +1,72 @@
+#include <thread>
+#include "gtest/gtest.h"
+#include "util/metrics.hpp"
+
+TEST(LatencyHistogram, percentiles)
+{
+	latency_histogram h;
+	ASSERT_EQ(h.value_at(50), 0);
+
+	for(uint64_t v = 1; v <= 100'000; ++v)
+		h.record(v);
+
+	ASSERT_EQ(h.count(), 100'000);
+	ASSERT_EQ(h.max(), 100'000);
+	ASSERT_DOUBLE_EQ(h.mean(), 50'000.5);
+
+	// Values are exact up to 64, then within 1/32
+	for(double p : {50., 90., 99., 99.9})
+	{
+		const double expected = p * 1000;
+		ASSERT_GE(h.value_at(p), expected);
+		ASSERT_LE(h.value_at(p), expected * (1 + 1. / 32));
+	}
+	ASSERT_EQ(h.value_at(100), 100'000);
+	ASSERT_EQ(h.value_at(0.01), 10);
+
+	latency_histogram large;
+	large.record(UINT64_MAX);
+	ASSERT_EQ(large.value_at(50), UINT64_MAX);
+}
+
+TEST(LatencyHistogram, concurrent_records)
+{
+	latency_histogram h;
+	std::vector<std::thread> threads;
+	for(int t = 0; t < 4; ++t)
+		threads.emplace_back([&h, t] {
+			for(int i = 0; i < 10'000; ++i)
+				h.record(t * 1000 + i % 100);
+		});
+
+	for(auto& thread : threads)
+		thread.join();
+
+	ASSERT_EQ(h.count(), 40'000);
+	ASSERT_EQ(h.max(), 3099);
+	ASSERT_EQ(h.value_at(25), 99);
+}
+
+TEST(QueryMetrics, formats)
+{
+	using namespace std::chrono_literals;
+
+	query_metrics metrics;
+	const auto bmm = metrics.add_path("bmm");
+	const auto cache = metrics.add_path("cache");
+	const auto shard = metrics.add_shard("data/db_0");
+
+	metrics.record_query(bmm, 2ms);
+	metrics.record_query(cache, 10us);
+	metrics.record_shard(shard, 1500us);
+
+	const auto json = metrics.to_json();
+	ASSERT_NE(json.find("\"queries\": 2"), std::string::npos);
+	ASSERT_NE(json.find("\"bmm\": {\"count\": 1"), std::string::npos);
+	ASSERT_NE(json.find("\"data/db_0\": {\"count\": 1, \"mean\": 1.5"), std::string::npos);
+
+	const auto prometheus = metrics.to_prometheus();
+	ASSERT_NE(prometheus.find("engine_query_latency_seconds{path=\"bmm\",quantile=\"0.5\"} 0.002\n"), std::string::npos);
+	ASSERT_NE(prometheus.find("engine_query_latency_seconds_count{path=\"all\"} 2\n"), std::string::npos);
+	ASSERT_NE(prometheus.find("engine_shard_latency_seconds_count{shard=\"data/db_0\"} 1\n"), std::string::npos);
+}
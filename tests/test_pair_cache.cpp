@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include "index/pair_cache.hpp"
+
+static std::shared_ptr<sindex::PairPostings> make_postings(size_t n)
+{
+	auto postings = std::make_shared<sindex::PairPostings>();
+	for(size_t i = 0; i < n; ++i)
+	{
+		postings->docids.push_back(i * 3);
+		postings->scores.push_back(1.0 + i);
+	}
+
+	return postings;
+}
+
+TEST(PairCache, key)
+{
+	ASSERT_EQ(sindex::PairCache::make_key("a", "b", "bm25"), sindex::PairCache::make_key("b", "a", "bm25"));
+	ASSERT_NE(sindex::PairCache::make_key("a", "b", "bm25"), sindex::PairCache::make_key("a", "b", "tfidf"));
+}
+
+TEST(PairCache, admission)
+{
+	sindex::PairCache cache(1 << 20, 2);
+	const auto key = sindex::PairCache::make_key("a", "b", "bm25");
+
+	// Not counted
+	ASSERT_FALSE(cache.get(key, false));
+	ASSERT_FALSE(cache.admit(key));
+
+	ASSERT_FALSE(cache.get(key));
+	ASSERT_FALSE(cache.admit(key));
+	ASSERT_FALSE(cache.get(key));
+	ASSERT_TRUE(cache.admit(key));
+
+	cache.put(key, make_postings(10));
+	auto postings = cache.get(key);
+	ASSERT_TRUE(postings);
+	ASSERT_EQ(postings->size(), 10);
+	ASSERT_EQ(postings->docids[3], 9);
+}
+
+TEST(PairCache, eviction)
+{
+	const auto postings = make_postings(100);
+	const auto key_a = sindex::PairCache::make_key("a", "b", "bm25");
+	const auto key_b = sindex::PairCache::make_key("a", "c", "bm25");
+	const auto key_c = sindex::PairCache::make_key("a", "d", "bm25");
+
+	// Room for two pairs
+	sindex::PairCache cache(sindex::PairCache::entry_size(key_a, *postings) * 2);
+	cache.put(key_a, postings);
+	cache.put(key_b, postings);
+
+	// a-b becomes the most recently used, a-c is evicted
+	ASSERT_TRUE(cache.get(key_a));
+	cache.put(key_c, postings);
+
+	ASSERT_TRUE(cache.get(key_a));
+	ASSERT_FALSE(cache.get(key_b));
+	ASSERT_TRUE(cache.get(key_c));
+}
@@ -0,0 +1,62 @@
+#include <cstring>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "index/positions.hpp"
+
+TEST(Positions, write_read)
+{
+	sindex::PositionsWriter writer;
+	std::vector<std::vector<sindex::position_t>> positions;
+
+	// Enough postings to have a few samples
+	for(sindex::docid_t docid = 1; docid <= 500; ++docid)
+	{
+		positions.push_back({});
+		for(sindex::position_t p = docid % 7; p < 300; p += 1 + docid % 13)
+			positions.back().push_back(p);
+
+		writer.add(docid * 3, positions.back());
+	}
+
+	std::ostringstream teletype;
+	teletype.put(0); // Misalign
+	const size_t start = writer.write(teletype);
+	ASSERT_EQ(start % sizeof(uint64_t), 0);
+
+	// Aligned copy
+	const auto str = teletype.str();
+	std::vector<uint64_t> data((str.size() + 7) / 8);
+	memcpy(data.data(), str.data(), str.size());
+	const auto *begin = (const uint8_t*)data.data() + start;
+
+	sindex::PositionsCursor cursor(begin, (const uint8_t*)data.data() + str.size());
+	for(sindex::docid_t docid = 1; docid <= 500; docid += 37)
+	{
+		ASSERT_EQ(cursor.get(docid * 3), positions[docid - 1]);
+		// Not in the posting list
+		ASSERT_TRUE(cursor.get(docid * 3 + 1).empty());
+	}
+}
+
+TEST(Positions, phrase_match)
+{
+	const std::vector<sindex::position_t> a = {1, 5, 10}, b = {2, 8, 12}, c = {3, 20};
+
+	ASSERT_TRUE(sindex::phrase_match({.terms = {"a", "b"}}, {&a, &b}));
+	ASSERT_TRUE(sindex::phrase_match({.terms = {"a", "b", "c"}}, {&a, &b, &c}));
+	ASSERT_FALSE(sindex::phrase_match({.terms = {"b", "a"}}, {&b, &a}));
+	ASSERT_FALSE(sindex::phrase_match({.terms = {"a", "c"}}, {&a, &c}));
+
+	// Any order, a-c fit in 2 + 1 positions: 1, 3
+	ASSERT_TRUE(sindex::phrase_match({.terms = {"c", "a"}, .proximity = true, .slop = 1}, {&c, &a}));
+	ASSERT_FALSE(sindex::phrase_match({.terms = {"c", "a"}, .proximity = true, .slop = 0}, {&c, &a}));
+
+	// A repeated term needs as many positions: a single one doesn't match
+	const std::vector<sindex::position_t> d = {4}, e = {6, 7};
+	ASSERT_FALSE(sindex::phrase_match({.terms = {"d", "d"}}, {&d, &d}));
+	ASSERT_FALSE(sindex::phrase_match({.terms = {"d", "d"}, .proximity = true, .slop = 0}, {&d, &d}));
+	ASSERT_TRUE(sindex::phrase_match({.terms = {"e", "e"}}, {&e, &e}));
+	ASSERT_TRUE(sindex::phrase_match({.terms = {"e", "e"}, .proximity = true, .slop = 0}, {&e, &e}));
+	ASSERT_FALSE(sindex::phrase_match({.terms = {"e", "e", "e"}, .proximity = true, .slop = 5}, {&e, &e, &e}));
+	ASSERT_TRUE(sindex::phrase_match({.terms = {"e", "b", "e"}, .proximity = true, .slop = 0}, {&e, &b, &e}));
+}
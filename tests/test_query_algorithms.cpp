@@ -0,0 +1,363 @@
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "index_worker.hpp"
+#include "indexBuilder/chunks.hpp"
+#include "indexBuilder/sigma_lexicon.hpp"
+#include "index/tier0.hpp"
+
+/*
+ * The query processing algorithms checked against an exhaustive scan, on an index whose posting lists span many skip
+ * blocks: the skipping ones seek between blocks, the scan never does.
+ */
+
+static constexpr size_t N_DOCS = 3000;
+static constexpr size_t SMALL_SKIP_BLOCK = 64;
+static constexpr size_t TOP_K = 10;
+
+class QueryAlgorithms : public testing::Test
+{
+protected:
+	static inline std::filesystem::path dir;
+
+	// term -> docid -> tf, the exact postings
+	static inline std::map<std::string, std::map<sindex::docid_t, sindex::freq_t>> postings;
+	static inline std::vector<sindex::doclen_t> doc_lens;
+	static inline std::vector<std::set<std::string>> queries;
+
+	static inline std::unique_ptr<memory_mmap> metadata_mem;
+	static inline std::unique_ptr<memory_mmap> global_lexicon_mem;
+	static inline std::unique_ptr<sindex::Index<sindex::SigmaLexiconValue>::global_lexicon_t> global_lexicon;
+	static inline std::unique_ptr<index_worker_t<sindex::SigmaLexiconValue>> worker;
+
+	static void SetUpTestSuite()
+	{
+		dir = std::filesystem::temp_directory_path()/("test_query_algorithms_" + std::to_string(getpid()));
+		std::filesystem::remove_all(dir);
+		std::filesystem::create_directories(dir);
+
+		// Terms of every frequency, the tfs are large enough to span the bytes of the unary codes
+		std::mt19937 rng(42);
+		const std::vector<double> term_probabilities = {0.9, 0.7, 0.5, 0.35, 0.2, 0.1, 0.05, 0.02, 0.002};
+		std::uniform_int_distribution<sindex::freq_t> tf_distribution(1, 20);
+		std::uniform_real_distribution<double> coin(0, 1);
+
+		sindex::IndexBuilder index_builder(N_DOCS, 1);
+		doc_lens.assign(N_DOCS + 1, 0);
+		sindex::doclen_t doc_len_sum = 0;
+		for(sindex::docid_t docid = 1; docid <= N_DOCS; ++docid)
+		{
+			sindex::doclen_t len = tf_distribution(rng);
+			for(size_t t = 0; t < term_probabilities.size(); ++t)
+				if(coin(rng) < term_probabilities[t])
+				{
+					const auto tf = tf_distribution(rng);
+					postings["t" + std::to_string(t)][docid] = tf;
+					len += tf;
+				}
+
+			doc_lens[docid] = len;
+			doc_len_sum += len;
+		}
+
+		// The builder adds the postings term by term, in docid order
+		for(const auto& [term, term_postings] : postings)
+			for(const auto& [docid, tf] : term_postings)
+				index_builder.add_to_post(term, docid, tf);
+
+		for(sindex::docid_t docid = 1; docid <= N_DOCS; ++docid)
+			index_builder.add_to_doc(docid, {.docno = "D" + std::to_string(docid), .lenght = doc_lens[docid]});
+
+		write_chunk(index_builder, dir/"db_0", false);
+		write_global_lexicon(dir, {dir/"db_0"});
+
+		const sindex::CollectionMetadata metadata = {
+			.doc_len_sum = doc_len_sum,
+			.n_docs = N_DOCS,
+			.impact_upper_bound = sindex::QueryTFIDFScorer::idf(N_DOCS, 1),
+			.quantized = false
+		};
+		std::ofstream metadata_teletype(dir/"metadata", std::ios::binary);
+		metadata.write(metadata_teletype);
+		metadata_teletype.close();
+
+		write_sigma_lexicon(dir/"db_0", false, false, SMALL_SKIP_BLOCK);
+
+		metadata_mem = std::make_unique<memory_mmap>(dir/"metadata");
+		global_lexicon_mem = std::make_unique<memory_mmap>(dir/"global_lexicon");
+		global_lexicon = std::make_unique<sindex::Index<sindex::SigmaLexiconValue>::global_lexicon_t>(*global_lexicon_mem);
+		worker = std::make_unique<index_worker_t<sindex::SigmaLexiconValue>>(dir/"db_0", *metadata_mem, *global_lexicon, "lexicon");
+
+		// Random queries of 2 to 4 terms
+		std::uniform_int_distribution<size_t> n_terms_distribution(2, 4), term_distribution(0, term_probabilities.size() - 1);
+		for(size_t q = 0; q < 300; ++q)
+		{
+			std::set<std::string> query;
+			for(size_t n_terms = n_terms_distribution(rng); query.size() < n_terms;)
+				query.insert("t" + std::to_string(term_distribution(rng)));
+			queries.push_back(std::move(query));
+		}
+	}
+
+	static void TearDownTestSuite()
+	{
+		worker.reset();
+		global_lexicon.reset();
+		global_lexicon_mem.reset();
+		metadata_mem.reset();
+		std::filesystem::remove_all(dir);
+	}
+
+	/** The BM25 scores of all the documents matching the query, by scanning the exact postings */
+	static std::map<sindex::docid_t, sindex::score_t> scan(const std::set<std::string>& query, bool conj)
+	{
+		sindex::QueryBM25Scorer scorer;
+		sindex::doclen_t doc_len_sum = 0;
+		for(const auto len : doc_lens)
+			doc_len_sum += len;
+		const double avgdl = (double)doc_len_sum / N_DOCS;
+
+		std::map<sindex::docid_t, sindex::score_t> scores;
+		std::map<sindex::docid_t, size_t> matched_terms;
+		for(const auto& term : query)
+		{
+			const auto& term_postings = postings.at(term);
+			const auto idf = sindex::QueryTFIDFScorer::idf(N_DOCS, term_postings.size());
+			for(const auto& [docid, tf] : term_postings)
+			{
+				scores[docid] += scorer.score(tf, idf, scorer.doc_norm(doc_lens[docid], avgdl));
+				matched_terms[docid] += 1;
+			}
+		}
+
+		if(conj)
+			std::erase_if(scores, [&](const auto& score) {return matched_terms[score.first] < query.size();});
+
+		return scores;
+	}
+
+	/**
+	 * Checks that the results are a top-k of the exact scores: the same k-th best scores, each result with its exact
+	 * score. Ties may be broken in any order
+	 */
+	static void expect_top_k(const std::vector<sindex::docid_result_t>& results,
+							 const std::map<sindex::docid_t, sindex::score_t>& exact_scores, size_t q, size_t k = TOP_K)
+	{
+		std::vector<sindex::score_t> best;
+		for(const auto& [docid, score] : exact_scores)
+			best.push_back(score);
+		std::sort(best.begin(), best.end(), std::greater<>());
+		best.resize(std::min(best.size(), k));
+
+		ASSERT_EQ(results.size(), best.size()) << " query " << q;
+		for(size_t i = 0; i < results.size(); ++i)
+		{
+			ASSERT_TRUE(exact_scores.contains(results[i].docid)) << " query " << q;
+			EXPECT_NEAR(results[i].score, exact_scores.at(results[i].docid), 1e-9) << " query " << q;
+			EXPECT_NEAR(results[i].score, best[i], 1e-9) << " query " << q << " rank " << i;
+		}
+	}
+};
+
+TEST_F(QueryAlgorithms, lists_span_many_blocks)
+{
+	for(const auto& term : {"t0", "t3", "t6"})
+	{
+		auto lv_it = worker->index.get_local_lexicon().find(term);
+		ASSERT_NE(lv_it, worker->index.get_local_lexicon().end());
+		ASSERT_GT(lv_it->second.skip_pointers.size(), 1) << term;
+	}
+}
+
+TEST_F(QueryAlgorithms, daat)
+{
+	for(size_t q = 0; q < queries.size(); ++q)
+		expect_top_k(worker->index.query<sindex::QueryBM25Scorer>(queries[q], false, TOP_K), scan(queries[q], false), q);
+}
+
+TEST_F(QueryAlgorithms, daat_conjunctive)
+{
+	for(size_t q = 0; q < queries.size(); ++q)
+		expect_top_k(worker->index.query<sindex::QueryBM25Scorer>(queries[q], true, TOP_K), scan(queries[q], true), q);
+}
+
+TEST_F(QueryAlgorithms, daat_conjunctive_pair_cache)
+{
+	// Its own index, so that the cache doesn't change the other tests
+	index_worker_t<sindex::SigmaLexiconValue> cached(dir/"db_0", *metadata_mem, *global_lexicon, "lexicon");
+	cached.index.enable_pair_cache(1 << 24, 2);
+
+	// Cold, then materializing the admitted pairs, then reading them from the cache
+	for(size_t round = 0; round < 3; ++round)
+		for(size_t q = 0; q < queries.size(); ++q)
+		{
+			sindex::QueryStats stats;
+			sindex::QueryBudget budget;
+			expect_top_k(cached.index.query<sindex::QueryBM25Scorer>(queries[q], true, TOP_K, nullptr, &stats, &budget),
+						 scan(queries[q], true), q);
+			EXPECT_EQ(stats.postings_scored, budget.get_postings()) << " query " << q << " round " << round;
+		}
+}
+
+TEST_F(QueryAlgorithms, pair_cache_budget)
+{
+	index_worker_t<sindex::SigmaLexiconValue> cached(dir/"db_0", *metadata_mem, *global_lexicon, "lexicon");
+	cached.index.enable_pair_cache(1 << 24, 1);
+
+	// The budget runs out while the pair of the two longest lists is materialized, the partial one isn't cached
+	const std::set<std::string> query = {"t0", "t1"};
+	sindex::QueryStats stats;
+	sindex::QueryBudget budget(sindex::QueryBudget::clock::time_point::max(), 10);
+	cached.index.query<sindex::QueryBM25Scorer>(query, true, TOP_K, nullptr, &stats, &budget);
+	EXPECT_TRUE(budget.is_exhausted());
+	EXPECT_EQ(stats.postings_scored, budget.get_postings());
+
+	expect_top_k(cached.index.query<sindex::QueryBM25Scorer>(query, true, TOP_K), scan(query, true), 0);
+	expect_top_k(cached.index.query<sindex::QueryBM25Scorer>(query, true, TOP_K), scan(query, true), 0);
+}
+
+TEST_F(QueryAlgorithms, bmand)
+{
+	for(size_t q = 0; q < queries.size(); ++q)
+		expect_top_k(worker->index.query_bmand<sindex::QueryBM25Scorer>(queries[q], TOP_K), scan(queries[q], true), q);
+}
+
+TEST_F(QueryAlgorithms, bmm)
+{
+	for(size_t q = 0; q < queries.size(); ++q)
+		expect_top_k(worker->index.query_bmm<sindex::QueryBM25Scorer>(queries[q], TOP_K), scan(queries[q], false), q);
+}
+
+TEST_F(QueryAlgorithms, quantized_and_saat)
+{
+	// A copy of the index whose tfs are replaced by quantized BM25 impacts, with the impact-ordered lists too
+	const auto quantized_dir = dir/"quantized";
+	std::filesystem::create_directories(quantized_dir);
+	std::filesystem::copy_file(dir/"global_lexicon", quantized_dir/"global_lexicon");
+	std::filesystem::copy(dir/"db_0", quantized_dir/"db_0");
+
+	auto metadata = sindex::CollectionMetadata::read(*metadata_mem);
+	metadata.quantized = true;
+	std::ofstream metadata_teletype(quantized_dir/"metadata", std::ios::binary);
+	metadata.write(metadata_teletype);
+	metadata_teletype.close();
+
+	write_sigma_lexicon(quantized_dir/"db_0", true, true, SMALL_SKIP_BLOCK);
+
+	memory_mmap quantized_metadata_mem(quantized_dir/"metadata");
+	index_worker_t<sindex::SigmaLexiconValue> quantized(quantized_dir/"db_0", quantized_metadata_mem, *global_lexicon, "lexicon");
+	ASSERT_TRUE(quantized.index.has_impacts());
+
+	// Every posting's score is rounded to the nearest impact, a document's score is off by half a step per term
+	const double step = quantized.index.get_quantizer().dequantize(1);
+	for(size_t q = 0; q < queries.size(); ++q)
+	{
+		const double max_error = queries[q].size() * step / 2 + 1e-9;
+		const auto exact_scores = scan(queries[q], false);
+
+		std::vector<sindex::score_t> best;
+		for(const auto& [docid, score] : exact_scores)
+			best.push_back(score);
+		std::sort(best.begin(), best.end(), std::greater<>());
+		best.resize(std::min(best.size(), TOP_K));
+
+		for(const auto& results : {quantized.index.query<sindex::QueryBM25Scorer>(queries[q], false, TOP_K),
+								   quantized.index.query_saat(queries[q], TOP_K)})
+		{
+			// So is the i-th best score, the documents may differ where the exact scores are that close
+			ASSERT_EQ(results.size(), best.size()) << " query " << q;
+			for(size_t i = 0; i < results.size(); ++i)
+			{
+				ASSERT_TRUE(exact_scores.contains(results[i].docid)) << " query " << q;
+				EXPECT_NEAR(results[i].score, exact_scores.at(results[i].docid), max_error) << " query " << q;
+				EXPECT_NEAR(results[i].score, best[i], max_error) << " query " << q << " rank " << i;
+			}
+		}
+	}
+}
+
+TEST_F(QueryAlgorithms, tier0)
+{
+	// A tier 0 as the pruner writes it: each term keeps the postings scoring at least 0.7 times its 20th best score,
+	// its bound is the highest score of the dropped ones
+	constexpr size_t PRUNE_K = 20;
+	constexpr double PRUNE_EPSILON = 0.7;
+	const auto tier0_dir = dir/"tier0";
+	std::filesystem::create_directories(tier0_dir);
+	std::filesystem::copy_file(dir/"metadata", tier0_dir/"metadata");
+	std::filesystem::copy_file(dir/"global_lexicon", tier0_dir/"global_lexicon");
+
+	std::map<std::string, sindex::score_t> pruned_bounds;
+	sindex::IndexBuilder index_builder(N_DOCS, 1);
+	for(const auto& [term, term_postings] : postings)
+	{
+		const auto scores = scan({term}, false);
+		std::vector<sindex::score_t> best;
+		for(const auto& [docid, score] : scores)
+			best.push_back(score);
+		std::sort(best.begin(), best.end(), std::greater<>());
+		const sindex::score_t threshold = best.size() > PRUNE_K ? PRUNE_EPSILON * best[PRUNE_K - 1] : 0;
+
+		for(const auto& [docid, tf] : term_postings)
+		{
+			if(scores.at(docid) >= threshold)
+				index_builder.add_to_post(term, docid, tf);
+			else
+				pruned_bounds[term] = std::max(pruned_bounds[term], scores.at(docid));
+		}
+	}
+
+	for(sindex::docid_t docid = 1; docid <= N_DOCS; ++docid)
+		index_builder.add_to_doc(docid, {.docno = "D" + std::to_string(docid), .lenght = doc_lens[docid]});
+
+	write_chunk(index_builder, tier0_dir/"db_0", false);
+	write_sigma_lexicon(tier0_dir/"db_0", false, false, SMALL_SKIP_BLOCK);
+	ASSERT_FALSE(pruned_bounds.empty());
+
+	index_worker_t<sindex::SigmaLexiconValue> tier0(tier0_dir/"db_0", *metadata_mem, *global_lexicon, "lexicon");
+
+	// The served queries' top-k, rescored on the full index, is the full index's one. Any k is tried, the tier 0 can
+	// only tell apart the documents whose scores are far enough
+	size_t served = 0, rescored = 0;
+	for(size_t q = 0; q < queries.size(); ++q)
+	{
+		sindex::score_t pruned_bound = 0;
+		for(const auto& term : queries[q])
+			if(pruned_bounds.contains(term))
+				pruned_bound += pruned_bounds.at(term);
+
+		const auto exact_scores = scan(queries[q], false);
+		for(size_t k = 1; k <= TOP_K; ++k)
+		{
+			auto results = tier0.index.query<sindex::QueryBM25Scorer>(queries[q], false, k + 1);
+			if(not sindex::tier0_top_k_is_exact(results, k, pruned_bound))
+				continue;
+
+			served += 1;
+			results.resize(std::min(results.size(), k));
+			std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {return a.docid < b.docid;});
+
+			std::vector<sindex::docid_t> docids;
+			for(const auto& result : results)
+				docids.push_back(result.docid);
+
+			const auto scores = worker->index.score_documents<sindex::QueryBM25Scorer>(queries[q], docids);
+			for(size_t i = 0; i < results.size(); ++i)
+			{
+				// The document lost some postings
+				if(scores[i] > results[i].score)
+					rescored += 1;
+				results[i].score = scores[i];
+			}
+
+			std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {return a.score > b.score;});
+			expect_top_k(results, exact_scores, q, k);
+		}
+	}
+
+	EXPECT_GT(served, 0);
+	EXPECT_GT(rescored, 0);
+}
@@ -0,0 +1,33 @@
+#include "gtest/gtest.h"
+#include "index/query_budget.hpp"
+
+TEST(QueryBudget, unlimited)
+{
+	sindex::QueryBudget budget;
+	for(int i = 0; i < 10000; ++i)
+		ASSERT_FALSE(budget.charge(3));
+
+	ASSERT_FALSE(budget.is_exhausted());
+	ASSERT_EQ(budget.get_postings(), 30000);
+}
+
+TEST(QueryBudget, postings)
+{
+	sindex::QueryBudget budget(sindex::QueryBudget::clock::time_point::max(), 10);
+	ASSERT_FALSE(budget.charge(4));
+	ASSERT_FALSE(budget.charge(0));
+	ASSERT_FALSE(budget.charge(5));
+	ASSERT_TRUE(budget.charge(1));
+	ASSERT_TRUE(budget.is_exhausted());
+}
+
+TEST(QueryBudget, deadline)
+{
+	// Already expired, it's noticed when the clock is read
+	sindex::QueryBudget budget(sindex::QueryBudget::clock::now());
+	for(unsigned i = 1; i < sindex::QueryBudget::CLOCK_INTERVAL; ++i)
+		ASSERT_FALSE(budget.charge(1));
+
+	ASSERT_TRUE(budget.charge(1));
+	ASSERT_TRUE(budget.is_exhausted());
+}
@@ -0,0 +1,218 @@
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "index_worker.hpp"
+#include "indexBuilder/chunks.hpp"
+#include "indexBuilder/sigma_lexicon.hpp"
+
+/*
+ * The phrase and proximity operators checked against a brute-force scan of the documents' text, on an index built
+ * with positions. The vocabulary is small, so that phrases and repeated terms match often.
+ */
+
+static constexpr size_t N_DOCS = 1000;
+static constexpr size_t VOCABULARY = 6;
+static constexpr size_t TOP_K = 10;
+
+class QueryPhrase : public testing::Test
+{
+protected:
+	static inline std::filesystem::path dir;
+
+	// The documents' terms, in order
+	static inline std::vector<std::vector<std::string>> docs;
+	static inline std::map<std::string, size_t> n_docs_of_term;
+	static inline double avgdl;
+
+	static inline std::unique_ptr<memory_mmap> metadata_mem;
+	static inline std::unique_ptr<memory_mmap> global_lexicon_mem;
+	static inline std::unique_ptr<sindex::Index<sindex::SigmaLexiconValue>::global_lexicon_t> global_lexicon;
+	static inline std::unique_ptr<index_worker_t<sindex::SigmaLexiconValue>> worker;
+
+	static void SetUpTestSuite()
+	{
+		dir = std::filesystem::temp_directory_path()/("test_query_phrase_" + std::to_string(getpid()));
+		std::filesystem::remove_all(dir);
+		std::filesystem::create_directories(dir);
+
+		std::mt19937 rng(42);
+		std::uniform_int_distribution<size_t> len_distribution(1, 12), term_distribution(0, VOCABULARY - 1);
+
+		// Docid 0 is unused, as in the builder
+		docs.resize(N_DOCS + 1);
+		std::map<std::string, std::map<sindex::docid_t, std::vector<sindex::position_t>>> postings;
+		sindex::doclen_t doc_len_sum = 0;
+		for(sindex::docid_t docid = 1; docid <= N_DOCS; ++docid)
+		{
+			for(size_t len = len_distribution(rng); docs[docid].size() < len;)
+			{
+				auto term = "t" + std::to_string(term_distribution(rng));
+				postings[term][docid].push_back(docs[docid].size());
+				docs[docid].push_back(std::move(term));
+			}
+			doc_len_sum += docs[docid].size();
+		}
+		avgdl = (double)doc_len_sum / N_DOCS;
+
+		sindex::IndexBuilder index_builder(N_DOCS, 1);
+		for(const auto& [term, term_postings] : postings)
+		{
+			n_docs_of_term[term] = term_postings.size();
+			for(const auto& [docid, positions] : term_postings)
+				index_builder.add_to_post(term, docid, positions);
+		}
+
+		for(sindex::docid_t docid = 1; docid <= N_DOCS; ++docid)
+			index_builder.add_to_doc(docid, {.docno = "D" + std::to_string(docid), .lenght = (sindex::doclen_t)docs[docid].size()});
+
+		write_chunk(index_builder, dir/"db_0", true);
+		write_global_lexicon(dir, {dir/"db_0"});
+
+		const sindex::CollectionMetadata metadata = {
+			.doc_len_sum = doc_len_sum,
+			.n_docs = N_DOCS,
+			.impact_upper_bound = sindex::QueryTFIDFScorer::idf(N_DOCS, 1),
+			.quantized = false
+		};
+		std::ofstream metadata_teletype(dir/"metadata", std::ios::binary);
+		metadata.write(metadata_teletype);
+		metadata_teletype.close();
+
+		write_sigma_lexicon(dir/"db_0", false, false);
+
+		metadata_mem = std::make_unique<memory_mmap>(dir/"metadata");
+		global_lexicon_mem = std::make_unique<memory_mmap>(dir/"global_lexicon");
+		global_lexicon = std::make_unique<sindex::Index<sindex::SigmaLexiconValue>::global_lexicon_t>(*global_lexicon_mem);
+		worker = std::make_unique<index_worker_t<sindex::SigmaLexiconValue>>(dir/"db_0", *metadata_mem, *global_lexicon, "lexicon");
+	}
+
+	static void TearDownTestSuite()
+	{
+		worker.reset();
+		global_lexicon.reset();
+		global_lexicon_mem.reset();
+		metadata_mem.reset();
+		std::filesystem::remove_all(dir);
+	}
+
+	/** True if the document's text satisfies the operator */
+	static bool matches(const std::vector<std::string>& doc, const sindex::phrase_t& phrase)
+	{
+		const size_t window = phrase.terms.size() + (phrase.proximity ? phrase.slop : 0);
+		for(size_t start = 0; start < doc.size(); ++start)
+		{
+			if(not phrase.proximity)
+			{
+				if(start + phrase.terms.size() <= doc.size() and
+				   std::equal(phrase.terms.begin(), phrase.terms.end(), doc.begin() + start))
+					return true;
+				continue;
+			}
+
+			// Each term of the operator takes a distinct position of the window
+			std::multiset<std::string> missing(phrase.terms.begin(), phrase.terms.end());
+			for(size_t p = start; p < std::min(doc.size(), start + window); ++p)
+				if(auto it = missing.find(doc[p]); it != missing.end())
+					missing.erase(it);
+
+			if(missing.empty())
+				return true;
+		}
+
+		return false;
+	}
+
+	/** The BM25 scores of the documents that satisfy the operators, with all the query's terms if conj */
+	static std::map<sindex::docid_t, sindex::score_t> scan(const std::set<std::string>& query,
+														   const std::vector<sindex::phrase_t>& phrases, bool conj)
+	{
+		const sindex::QueryBM25Scorer scorer;
+		std::map<sindex::docid_t, sindex::score_t> scores;
+		for(sindex::docid_t docid = 1; docid <= N_DOCS; ++docid)
+		{
+			const auto& doc = docs[docid];
+			if(not std::all_of(phrases.begin(), phrases.end(), [&](const auto& phrase) {return matches(doc, phrase);}))
+				continue;
+
+			sindex::score_t score = 0;
+			bool all_terms = true;
+			for(const auto& term : query)
+			{
+				const auto tf = (sindex::freq_t)std::count(doc.begin(), doc.end(), term);
+				all_terms = all_terms and tf > 0;
+				if(tf)
+					score += scorer.score(tf, sindex::QueryTFIDFScorer::idf(N_DOCS, n_docs_of_term.at(term)),
+										  scorer.doc_norm(doc.size(), avgdl));
+			}
+
+			if(all_terms or not conj)
+				scores[docid] = score;
+		}
+
+		return scores;
+	}
+
+	/** Checks that the results are a top-k of the exact scores, ties may be broken in any order */
+	static void expect_top_k(const std::vector<sindex::docid_result_t>& results,
+							 const std::map<sindex::docid_t, sindex::score_t>& exact_scores, size_t q)
+	{
+		std::vector<sindex::score_t> best;
+		for(const auto& [docid, score] : exact_scores)
+			best.push_back(score);
+		std::sort(best.begin(), best.end(), std::greater<>());
+		best.resize(std::min(best.size(), TOP_K));
+
+		ASSERT_EQ(results.size(), best.size()) << " query " << q;
+		for(size_t i = 0; i < results.size(); ++i)
+		{
+			ASSERT_TRUE(exact_scores.contains(results[i].docid)) << " query " << q;
+			EXPECT_NEAR(results[i].score, exact_scores.at(results[i].docid), 1e-9) << " query " << q;
+			EXPECT_NEAR(results[i].score, best[i], 1e-9) << " query " << q << " rank " << i;
+		}
+	}
+
+	/** Random operators of 2 or 3 terms, repeated ones included, and a further optional term */
+	static void check_random_queries(bool proximity, bool conj)
+	{
+		std::mt19937 rng(proximity * 2 + conj);
+		std::uniform_int_distribution<size_t> n_terms_distribution(2, 3), term_distribution(0, VOCABULARY - 1), slop_distribution(0, 3);
+		for(size_t q = 0; q < 200; ++q)
+		{
+			sindex::phrase_t phrase = {.terms = {}, .proximity = proximity, .slop = proximity ? (unsigned)slop_distribution(rng) : 0};
+			for(size_t n_terms = n_terms_distribution(rng); phrase.terms.size() < n_terms;)
+				phrase.terms.push_back("t" + std::to_string(term_distribution(rng)));
+
+			std::set<std::string> query(phrase.terms.begin(), phrase.terms.end());
+			query.insert("t" + std::to_string(term_distribution(rng)));
+
+			expect_top_k(worker->index.query_phrase<sindex::QueryBM25Scorer>(query, {phrase}, conj, TOP_K),
+						 scan(query, {phrase}, conj), q);
+		}
+	}
+};
+
+TEST_F(QueryPhrase, repeated_term)
+{
+	const sindex::phrase_t exact = {.terms = {"t0", "t0"}}, near = {.terms = {"t0", "t0"}, .proximity = true};
+	expect_top_k(worker->index.query_phrase<sindex::QueryBM25Scorer>({"t0"}, {exact}, false, TOP_K), scan({"t0"}, {exact}, false), 0);
+	expect_top_k(worker->index.query_phrase<sindex::QueryBM25Scorer>({"t0"}, {near}, false, TOP_K), scan({"t0"}, {near}, false), 0);
+
+	// A single occurrence doesn't match
+	for(const auto& result : worker->index.query_phrase<sindex::QueryBM25Scorer>({"t0"}, {near}, false, N_DOCS))
+		EXPECT_GE(std::count(docs[result.docid].begin(), docs[result.docid].end(), "t0"), 2) << result.docid;
+}
+
+TEST_F(QueryPhrase, exact)
+{
+	check_random_queries(false, false);
+	check_random_queries(false, true);
+}
+
+TEST_F(QueryPhrase, proximity)
+{
+	check_random_queries(true, false);
+	check_random_queries(true, true);
+}
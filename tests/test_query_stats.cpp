@@ -0,0 +1,32 @@
+#include "gtest/gtest.h"
+#include "index/query_stats.hpp"
+
+TEST(QueryStats, chunks_add_up)
+{
+	sindex::QueryStats a, b;
+	a.terms["cat"] = {.postings_decoded = 10, .blocks_skipped = 1};
+	a.lexicon_probes = 2;
+	a.postings_scored = 7;
+	a.heap_pushes = 3;
+
+	b.terms["cat"] = {.postings_decoded = 5, .blocks_skipped = 2};
+	b.terms["dog"] = {.postings_decoded = 4, .blocks_skipped = 0};
+	b.lexicon_probes = 4;
+	b.heap_pushes = 2;
+	b.heap_evictions = 1;
+	b.pivot_moves = 1;
+
+	sindex::QueryStats sum;
+	sum += a;
+	sum += b;
+
+	ASSERT_EQ(sum.terms.size(), 2);
+	ASSERT_EQ(sum.terms["cat"].postings_decoded, 15);
+	ASSERT_EQ(sum.terms["cat"].blocks_skipped, 3);
+	ASSERT_EQ(sum.terms["dog"].postings_decoded, 4);
+	ASSERT_EQ(sum.lexicon_probes, 6);
+	ASSERT_EQ(sum.postings_scored, 7);
+	ASSERT_EQ(sum.heap_pushes, 5);
+	ASSERT_EQ(sum.heap_evictions, 1);
+	ASSERT_EQ(sum.pivot_moves, 1);
+}
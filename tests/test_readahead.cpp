@@ -0,0 +1,50 @@
+#include <chrono>
+#include <thread>
+#include <sys/mman.h>
+#include "gtest/gtest.h"
+#include "util/readahead.hpp"
+
+TEST(Readahead, issues_all)
+{
+	constexpr size_t length = 1 << 20;
+	auto *buff = (uint8_t *)mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(buff, MAP_FAILED);
+
+	{
+		readahead_queue queue;
+
+		// Unaligned ranges too
+		for(size_t off = 0; off < length; off += 10'000)
+			queue.add(buff + off, std::min<size_t>(5'000, length - off));
+		queue.add(buff, 0);
+
+		for(int i = 0; i < 1000 and queue.issued() < (length + 9'999) / 10'000; ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		ASSERT_EQ(queue.issued(), (length + 9'999) / 10'000);
+		ASSERT_EQ(queue.dropped(), 0);
+	}
+
+	munmap(buff, length);
+}
+
+TEST(Readahead, drops_when_full)
+{
+	constexpr size_t length = 1 << 16;
+	auto *buff = (uint8_t *)mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(buff, MAP_FAILED);
+
+	{
+		readahead_queue queue(1);
+		for(int i = 0; i < 1000; ++i)
+			queue.add(buff, length);
+
+		// Every range is either dropped or issued, at most one is pending at any time
+		for(int i = 0; i < 1000 and queue.issued() + queue.dropped() < 1000; ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		ASSERT_EQ(queue.issued() + queue.dropped(), 1000);
+	}
+
+	munmap(buff, length);
+}
@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include "gtest/gtest.h"
+#include "indexBuilder/reorder.hpp"
+
+TEST(Reorder, bp_permutation)
+{
+	std::vector<std::vector<uint32_t>> docs;
+	for(uint32_t i = 0; i < 1000; ++i)
+		docs.push_back({i % 17, 17 + i % 5, 22 + i % 31});
+
+	auto order = sindex::bp_order(docs, 53);
+	ASSERT_EQ(order.size(), docs.size());
+
+	std::sort(order.begin(), order.end());
+	for(uint32_t i = 0; i < order.size(); ++i)
+		ASSERT_EQ(order[i], i);
+}
+
+TEST(Reorder, bp_clusters)
+{
+	// Two topics, randomly mixed
+	std::mt19937 gen(42);
+	std::vector<std::vector<uint32_t>> docs;
+	for(uint32_t i = 0; i < 256; ++i)
+		docs.push_back(gen() % 2 ? std::vector<uint32_t>{0, 1, 2, 3} : std::vector<uint32_t>{4, 5, 6, 7});
+
+	const auto order = sindex::bp_order(docs, 8);
+
+	// Documents of the same topic end up next to each other
+	size_t switches = 0;
+	for(size_t i = 1; i < order.size(); ++i)
+		switches += docs[order[i]] != docs[order[i - 1]];
+
+	ASSERT_LE(switches, 4);
+}
@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+#include "util/result_cache.hpp"
+
+static std::vector<sindex::result_t> make_results(size_t n)
+{
+	std::vector<sindex::result_t> results;
+	for(size_t i = 0; i < n; ++i)
+	{
+		std::string docno = "D";
+		docno += std::to_string(i);
+		results.push_back({docno, (double)(n - i)});
+	}
+
+	return results;
+}
+
+TEST(ResultCache, hit_miss)
+{
+	result_cache cache(1 << 20);
+
+	ASSERT_FALSE(cache.get("a b"));
+	cache.put("a b", make_results(10));
+
+	auto results = cache.get("a b");
+	ASSERT_TRUE(results);
+	ASSERT_EQ(results->size(), 10);
+	ASSERT_EQ(results->front().docno, "D0");
+
+	ASSERT_FALSE(cache.get("a c"));
+	ASSERT_EQ(cache.hits(), 1);
+	ASSERT_EQ(cache.misses(), 2);
+
+	// Replace
+	cache.put("a b", make_results(3));
+	ASSERT_EQ(cache.get("a b")->size(), 3);
+}
+
+TEST(ResultCache, eviction)
+{
+	const auto results = make_results(10);
+	const size_t entry_size = result_cache::entry_size("q00", results);
+
+	// One shard, room for two entries
+	result_cache cache(entry_size * 2, 1);
+
+	cache.put("q00", results);
+	cache.put("q01", results);
+
+	// q00 becomes the most recently used, q01 is evicted
+	ASSERT_TRUE(cache.get("q00"));
+	cache.put("q02", results);
+
+	ASSERT_TRUE(cache.get("q00"));
+	ASSERT_FALSE(cache.get("q01"));
+	ASSERT_TRUE(cache.get("q02"));
+
+	// Too big to fit
+	cache.put("q03", make_results(100));
+	ASSERT_FALSE(cache.get("q03"));
+}
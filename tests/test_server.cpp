@@ -0,0 +1,70 @@
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "util/server.hpp"
+
+TEST(QueryServer, concurrent_clients)
+{
+	const std::string address = "/tmp/test_server_" + std::to_string(getpid()) + ".sock";
+
+	query_server server;
+	ASSERT_TRUE(server.listen(address));
+	std::thread server_thread([&] {
+		server.serve([](const std::string& request) {return "echo " + request;});
+	});
+
+	std::vector<std::thread> clients;
+	std::atomic<size_t> n_ok = 0;
+	for(int c = 0; c < 4; ++c)
+		clients.emplace_back([&, c] {
+			const int fd = connect_to(address);
+			if(fd == -1)
+				return;
+
+			// Many requests on one connection, the empty one too
+			std::string response;
+			for(int i = 0; i < 50; ++i)
+			{
+				const auto request = i == 0 ? std::string() : std::to_string(c) + ':' + std::to_string(i);
+				if(send_message(fd, request) and recv_message(fd, response) and response == "echo " + request)
+					n_ok += 1;
+			}
+
+			close(fd);
+		});
+
+	for(auto& client : clients)
+		client.join();
+
+	ASSERT_EQ(n_ok, 200);
+	ASSERT_EQ(server.requests_served(), 200);
+	ASSERT_EQ(server.connections_served(), 4);
+
+	// A connection left open doesn't keep the server running
+	const int idle_fd = connect_to(address);
+	ASSERT_NE(idle_fd, -1);
+
+	server.stop();
+	server_thread.join();
+	close(idle_fd);
+}
+
+TEST(QueryServer, messages)
+{
+	int fds[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+	std::string message;
+	ASSERT_TRUE(send_message(fds[0], "ok"));
+	ASSERT_TRUE(send_message(fds[0], std::string(100, 'x')));
+	ASSERT_TRUE(recv_message(fds[1], message));
+	ASSERT_EQ(message, "ok");
+
+	// Refused, the server drops the connection
+	ASSERT_FALSE(recv_message(fds[1], message, 10));
+
+	close(fds[0]);
+	ASSERT_FALSE(recv_message(fds[1], message));
+	close(fds[1]);
+}
@@ -0,0 +1,141 @@
+#include <thread>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "util/server.hpp"
+#include "util/shard_client.hpp"
+
+TEST(ShardClient, requests)
+{
+	std::string query;
+	double threshold;
+
+	ASSERT_EQ(query_request("foo bar"), "foo bar");
+	ASSERT_TRUE(parse_query_request("foo bar", query, threshold));
+	ASSERT_EQ(query, "foo bar");
+	ASSERT_EQ(threshold, 0);
+
+	// The threshold is read back exactly
+	const double sent = 1.0 / 3;
+	ASSERT_TRUE(parse_query_request(query_request("foo bar", sent), query, threshold));
+	ASSERT_EQ(query, "foo bar");
+	ASSERT_EQ(threshold, sent);
+
+	ASSERT_FALSE(parse_query_request("foo\nbar", query, threshold));
+}
+
+TEST(ShardClient, merge)
+{
+	std::vector<sindex::result_t> results;
+	bool approximate, partial;
+	ASSERT_TRUE(shard_client::parse_response("ok\na\t3\nb\t1.5\n", results, approximate, partial));
+	ASSERT_FALSE(approximate);
+	ASSERT_FALSE(partial);
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_EQ(results[1].docno, "b");
+	ASSERT_EQ(results[1].score, 1.5);
+	ASSERT_FALSE(shard_client::parse_response("ok\na 3\n", results, approximate, partial));
+	ASSERT_FALSE(shard_client::parse_response("a\t3\n", results, approximate, partial));
+
+	// The scores are read back exactly, an error response is refused
+	const std::vector<sindex::result_t> sent = {{"a", 1.0 / 3}, {"b", 0.1}};
+	ASSERT_TRUE(shard_client::parse_response(query_response(sent), results, approximate, partial));
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_EQ(results[0].score, sent[0].score);
+	ASSERT_EQ(results[1].score, sent[1].score);
+	ASSERT_TRUE(shard_client::parse_response(query_response({}), results, approximate, partial));
+	ASSERT_TRUE(results.empty());
+
+	// The status line's flags
+	ASSERT_TRUE(shard_client::parse_response(query_response(sent, true), results, approximate, partial));
+	ASSERT_TRUE(approximate);
+	ASSERT_FALSE(partial);
+	ASSERT_TRUE(shard_client::parse_response(query_response(sent, false, true), results, approximate, partial));
+	ASSERT_FALSE(approximate);
+	ASSERT_TRUE(partial);
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_FALSE(shard_client::parse_response(error_response("malformed threshold line"), results, approximate, partial));
+
+	const std::vector<std::vector<sindex::result_t>> shard_results = {
+			{{"a", 3}, {"b", 1}},
+			{},
+			{{"c", 4}, {"d", 1}, {"e", 0.5}}
+	};
+
+	const auto merged = shard_client::merge(shard_results, 3);
+	ASSERT_EQ(merged.size(), 3);
+	ASSERT_EQ(merged[0].docno, "c");
+	ASSERT_EQ(merged[1].docno, "a");
+	// Ties go to the lowest shard
+	ASSERT_EQ(merged[2].docno, "b");
+}
+
+TEST(ShardClient, probes_and_failures)
+{
+	const std::string prefix = "/tmp/test_shard_client_" + std::to_string(getpid());
+
+	// Each fake shard returns its results above the request's threshold, and records it. The second one says they're
+	// approximate
+	struct fake_shard_t
+	{
+		std::vector<sindex::result_t> results;
+		bool approximate = false;
+		double last_threshold = -1;
+		query_server server;
+		std::thread thread;
+	};
+
+	std::vector<std::unique_ptr<fake_shard_t>> shards;
+	std::vector<std::string> addresses;
+	for(const auto& results : std::vector<std::vector<sindex::result_t>>{{{"a", 5}, {"b", 2}}, {{"c", 3}, {"d", 1}}})
+	{
+		auto& shard = *shards.emplace_back(std::make_unique<fake_shard_t>());
+		shard.results = results;
+		shard.approximate = shards.size() == 2;
+		addresses.push_back(prefix + "_" + std::to_string(shards.size()) + ".sock");
+		ASSERT_TRUE(shard.server.listen(addresses.back()));
+
+		shard.thread = std::thread([&shard] {
+			shard.server.serve([&shard](const std::string& request) {
+				std::string query;
+				parse_query_request(request, query, shard.last_threshold);
+
+				std::vector<sindex::result_t> results;
+				for(const auto& result : shard.results)
+					if(result.score > shard.last_threshold)
+						results.push_back(result);
+				return query_response(results, shard.approximate);
+			});
+		});
+	}
+
+	// Nobody listens on the last one
+	addresses.push_back(prefix + "_dead.sock");
+
+	shard_client client(addresses, 1);
+	bool partial = false, approximate = false;
+	const auto results = client.search("q", 2, &partial, 0, &approximate);
+
+	// The first shard is the probe, the others only need to beat its 2nd result
+	ASSERT_EQ(shards[0]->last_threshold, 0);
+	ASSERT_EQ(shards[1]->last_threshold, 2);
+	ASSERT_EQ(results.size(), 2);
+	ASSERT_EQ(results[0].docno, "a");
+	ASSERT_EQ(results[1].docno, "c");
+
+	// The dead shard is left out, the others still answer
+	ASSERT_TRUE(partial);
+	ASSERT_TRUE(approximate);
+	ASSERT_EQ(client.failures(), 1);
+
+	// Without the dead shard the results are whole, still approximate
+	shard_client live_client(std::vector<std::string>(addresses.begin(), addresses.end() - 1), 1);
+	live_client.search("q", 2, &partial, 0, &approximate);
+	ASSERT_FALSE(partial);
+	ASSERT_TRUE(approximate);
+
+	for(auto& shard : shards)
+	{
+		shard->server.stop();
+		shard->thread.join();
+	}
+}
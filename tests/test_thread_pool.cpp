@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <random>
+#include <set>
 #include "gtest/gtest.h"
 #include "util/thread_pool.hpp"
 
@@ -72,3 +73,32 @@ TEST(ThreadPool, test_wait)
 
 	ASSERT_EQ(n, cycles);
 }
+
+TEST(ThreadPool, test_worker_jobs)
+{
+	constexpr size_t n_workers = 4;
+	constexpr size_t cycles = 400;
+
+	std::mutex ids_mutex;
+	std::vector<std::set<std::thread::id>> ids(n_workers);
+
+	{
+		thread_pool pool(n_workers);
+		for(size_t i = 0; i < cycles; i++)
+			pool.add_job(i % n_workers, [&, worker = i % n_workers] {
+				std::lock_guard guard(ids_mutex);
+				ids[worker].insert(std::this_thread::get_id());
+			});
+
+		pool.wait_all_jobs();
+	}
+
+	// Each worker's jobs always ran on the same thread, a different one for each worker
+	std::set<std::thread::id> all_ids;
+	for(const auto& worker_ids : ids)
+	{
+		ASSERT_EQ(worker_ids.size(), 1);
+		all_ids.insert(*worker_ids.begin());
+	}
+	ASSERT_EQ(all_ids.size(), n_workers);
+}
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <random>
+#include "gtest/gtest.h"
+#include "index/top_k_merge.hpp"
+
+TEST(TopKMerge, merges_sorted_chunks)
+{
+	const std::vector<std::vector<sindex::docid_result_t>> chunks = {
+			{{1, 9.0}, {4, 5.0}, {2, 1.0}},
+			{},
+			{{10, 7.0}, {12, 5.0}},
+	};
+
+	const auto merged = sindex::merge_top_k(chunks, 4);
+	ASSERT_EQ(merged.size(), 4);
+
+	ASSERT_EQ(merged[0].docid, 1);
+	ASSERT_EQ(merged[0].shard, 0);
+	ASSERT_EQ(merged[1].docid, 10);
+	ASSERT_EQ(merged[1].shard, 2);
+
+	// Ties go to the lowest chunk
+	ASSERT_EQ(merged[2].docid, 4);
+	ASSERT_EQ(merged[3].docid, 12);
+	ASSERT_EQ(merged[3].score, 5.0);
+
+	// Fewer results than k
+	ASSERT_EQ(sindex::merge_top_k(chunks, 100).size(), 5);
+	ASSERT_TRUE(sindex::merge_top_k({}, 10).empty());
+}
+
+TEST(TopKMerge, same_as_sorting)
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> score(0, 100);
+
+	std::vector<std::vector<sindex::docid_result_t>> chunks(16);
+	std::vector<double> all;
+	for(size_t shard = 0; shard < chunks.size(); ++shard)
+	{
+		for(size_t i = 0; i < 50 + shard; ++i)
+		{
+			chunks[shard].push_back({shard * 1000 + i, score(rng)});
+			all.push_back(chunks[shard].back().score);
+		}
+
+		std::sort(chunks[shard].begin(), chunks[shard].end(), std::greater<>());
+	}
+
+	std::sort(all.begin(), all.end(), std::greater<>());
+
+	const auto merged = sindex::merge_top_k(chunks, 100);
+	ASSERT_EQ(merged.size(), 100);
+	for(size_t i = 0; i < merged.size(); ++i)
+	{
+		ASSERT_EQ(merged[i].score, all[i]);
+		ASSERT_EQ(merged[i].docid / 1000, merged[i].shard);
+	}
+}
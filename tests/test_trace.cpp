@@ -0,0 +1,59 @@
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "util/trace.hpp"
+
+#ifdef SEARCHENGINECPP_TRACE
+static size_t count_occurrences(const std::string& str, const std::string& what)
+{
+	size_t n = 0;
+	for(auto pos = str.find(what); pos != std::string::npos; pos = str.find(what, pos + 1))
+		++n;
+	return n;
+}
+#endif
+
+TEST(Trace, spans)
+{
+	const std::string path = "/tmp/test_trace_" + std::to_string(getpid()) + ".json";
+
+	// Not recorded, tracing is not started yet
+	{
+		TRACE_SPAN("before", "test");
+	}
+
+#ifdef SEARCHENGINECPP_TRACE
+	ASSERT_TRUE(trace::start(path));
+	ASSERT_TRUE(trace::enabled());
+
+	auto work = [] {
+		for(int i = 0; i < 10; ++i)
+		{
+			TRACE_SPAN("outer", "test");
+			TRACE_SPAN("inner \"quoted\"", "test");
+		}
+	};
+	std::thread other(work);
+	work();
+	other.join();
+
+	trace::stop();
+	ASSERT_FALSE(trace::enabled());
+
+	std::ifstream in(path);
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	const auto trace = buffer.str();
+
+	ASSERT_EQ(trace.find("\"before\""), std::string::npos);
+	ASSERT_EQ(count_occurrences(trace, "\"name\": \"outer\""), 20);
+	ASSERT_EQ(count_occurrences(trace, "\"name\": \"inner \\\"quoted\\\"\""), 20);
+	ASSERT_EQ(count_occurrences(trace, "\"ph\": \"X\""), 40);
+	std::remove(path.c_str());
+#else
+	ASSERT_FALSE(trace::start(path));
+	ASSERT_FALSE(trace::enabled());
+#endif
+}